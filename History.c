@@ -63,6 +63,7 @@
 #include "replace.h"
 #include "globals.h"
 #include "utils.h"
+#include "slab.h"
 #include "message.h"
 #include "utf8.h"
 #include "message_view.h"
@@ -213,6 +214,7 @@ static const char *ref_node = "node";
 static const char *ref_selection = "selection";
 static const char *ref_history = "history";
 static const char *ref_copy = "copy";
+static const char *ref_row = "row";
 #endif /* DEBUG_MESSAGE */
 
 /* Allocates a translation queue item */
@@ -256,8 +258,59 @@ struct node {
 
     /* The node's youngest elder sibling */
     node_t sibling;
+
+    /* The next node in the same node_table bucket by Message-Id */
+    node_t id_next;
+
+    /* The next node in the same node_table bucket by message */
+    node_t message_next;
+
+    /* The width of the message (see message_view_measure) */
+    long width;
+};
+
+/* A row of the history display.  Only the rows in or near the
+ * visible region have message_views; the rest just remember enough
+ * to make one and how wide it will be. */
+struct history_row {
+    /* The row's message */
+    message_t message;
+
+    /* The row's indentation */
+    long indent;
+
+    /* The width of the message (see message_view_measure) */
+    long width;
+
+    /* The row's message_view, or NULL if it hasn't been made yet */
+    message_view_t view;
 };
 
+/* A hash table of the nodes in the tree, indexed both by Message-Id
+ * and by message, so that a message's parent can be found without
+ * traversing the tree. */
+struct node_table {
+    /* The number of buckets in each of the arrays */
+    unsigned int size;
+
+    /* The buckets of nodes indexed by Message-Id */
+    node_t *ids;
+
+    /* The buckets of nodes indexed by message */
+    node_t *messages;
+};
+
+/* The slab from which nodes are allocated */
+static slab_t node_slab;
+
+/* The number of rows either side of the visible region which get to
+ * keep their message_views */
+#define VIEW_MARGIN 16
+
+/* Returns the bucket a message belongs in */
+#define MESSAGE_BUCKET(table, message) \
+    (((unsigned long)(message) >> 4) % (table)->size)
+
 /* Allocates and returns a new node */
 static node_t
 node_alloc(message_t message)
@@ -265,7 +318,14 @@ node_alloc(message_t message)
     node_t self;
 
     /* Allocate memory for the node */
-    self = malloc(sizeof(struct node));
+    if (node_slab == NULL) {
+        node_slab = slab_alloc("node", sizeof(struct node), 0);
+        if (node_slab == NULL) {
+            return NULL;
+        }
+    }
+
+    self = slab_get(node_slab);
     if (self == NULL) {
         return NULL;
     }
@@ -290,7 +350,7 @@ node_free(node_t self)
     }
 
     DPRINTF((5, "node_free(): %p\n", self));
-    free(self);
+    slab_put(node_slab, self);
 }
 
 /* Returns the id of the node's message */
@@ -300,6 +360,131 @@ node_get_id(node_t self)
     return message_get_id(self->message);
 }
 
+/* Allocates a node table big enough for about count nodes */
+static node_table_t
+node_table_alloc(unsigned int count)
+{
+    node_table_t self;
+
+    /* Allocate memory for the table */
+    self = malloc(sizeof(struct node_table));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    /* Keep the tables no more than half full */
+    self->size = count * 2 + 1;
+
+    /* Allocate the buckets */
+    self->ids = calloc(self->size, sizeof(node_t));
+    if (self->ids == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->messages = calloc(self->size, sizeof(node_t));
+    if (self->messages == NULL) {
+        free(self->ids);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+/* Frees a node table (but not the nodes in it) */
+static void
+node_table_free(node_table_t self)
+{
+    free(self->ids);
+    free(self->messages);
+    free(self);
+}
+
+/* Adds a node to the table */
+static void
+node_table_add(node_table_t self, node_t node)
+{
+    const char *id;
+    unsigned long bucket;
+
+    /* Index it by message */
+    bucket = MESSAGE_BUCKET(self, node->message);
+    node->message_next = self->messages[bucket];
+    self->messages[bucket] = node;
+
+    /* Index it by Message-Id if it has one */
+    id = node_get_id(node);
+    if (id != NULL) {
+        bucket = string_hash(id) % self->size;
+        node->id_next = self->ids[bucket];
+        self->ids[bucket] = node;
+    }
+}
+
+/* Removes a node from the table */
+static void
+node_table_remove(node_table_t self, node_t node)
+{
+    const char *id;
+    node_t *probe;
+
+    /* Unlink it from its message bucket */
+    probe = &self->messages[MESSAGE_BUCKET(self, node->message)];
+    while (*probe != node) {
+        ASSERT(*probe != NULL);
+        probe = &(*probe)->message_next;
+    }
+    *probe = node->message_next;
+
+    /* Unlink it from its Message-Id bucket */
+    id = node_get_id(node);
+    if (id != NULL) {
+        probe = &self->ids[string_hash(id) % self->size];
+        while (*probe != node) {
+            ASSERT(*probe != NULL);
+            probe = &(*probe)->id_next;
+        }
+        *probe = node->id_next;
+    }
+}
+
+/* Returns the most recently added node with the given Message-Id, or
+ * NULL if there isn't one */
+static node_t
+node_table_find_id(node_table_t self, const char *id)
+{
+    node_t node;
+
+    for (node = self->ids[string_hash(id) % self->size];
+         node != NULL;
+         node = node->id_next) {
+        if (strcmp(node_get_id(node), id) == 0) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns the node which wraps the message, or NULL if there isn't
+ * one */
+static node_t
+node_table_find_message(node_table_t self, message_t message)
+{
+    node_t node;
+
+    for (node = self->messages[MESSAGE_BUCKET(self, message)];
+         node != NULL;
+         node = node->message_next) {
+        if (node->message == message) {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
 /* Add a node to the tree.  WARNING: this is not a friendly function.
  * To avoid having to traverse the tree more than once when adding a
  * node, this function both finds a parent and adds a child to it and
@@ -309,8 +494,11 @@ node_get_id(node_t self)
  *    The pointer to the root node of the tree.  This will be updated,
  *    so it should really be the official pointer to the tree.
  *
- * parent_id
- *    The Message-Id of the parent of the node to add.
+ * table
+ *    The node table, from which discarded nodes are removed.
+ *
+ * parent
+ *    The parent of the node to add, or NULL if it has none.
  *
  * child
  *    The child node to be added.  This will be set to NULL, so don't
@@ -332,7 +520,8 @@ node_get_id(node_t self)
  */
 static void
 node_add1(node_t *self,
-          const char *parent_id,
+          node_table_t table,
+          node_t parent,
           node_t *child,
           int *index,
           int *index_out,
@@ -341,12 +530,8 @@ node_add1(node_t *self,
 {
     /* Traverse all of our siblings */
     while (*self != NULL) {
-        const char *id;
-
         /* If no match yet, then check for one here */
-        if (parent_id && *child != NULL &&
-            (id = node_get_id(*self)) != NULL &&
-            strcmp(id, parent_id) == 0) {
+        if (*child != NULL && *self == parent) {
             /* Match!  Add the child to this node */
             (*child)->sibling = (*self)->child;
             (*self)->child = *child;
@@ -372,7 +557,7 @@ node_add1(node_t *self,
         /* Check with the descendents */
         if ((*self)->child != NULL) {
             node_add1(&(*self)->child,
-                      parent_id, child,
+                      table, parent, child,
                       index, index_out,
                       depth + 1, depth_out);
         }
@@ -392,6 +577,7 @@ node_add1(node_t *self,
             ASSERT((*self)->sibling == NULL);
 
             /* Free the node */
+            node_table_remove(table, *self);
             node_free(*self);
             *self = NULL;
             return;
@@ -409,6 +595,10 @@ node_add1(node_t *self,
  *    The pointer to the variable holding the root of the tree.  This
  *    will commonly be modified, so use the actual pointer.
  *
+ * table
+ *    The node table, which is used to find the child's parent and to
+ *    which the child is added.
+ *
  * parent_id
  *    The Message-Id of the parent node; the In-Reply-To field.
  *
@@ -427,20 +617,28 @@ node_add1(node_t *self,
  */
 static void
 node_add(node_t *self,
+         node_table_t table,
          const char *parent_id,
          node_t child,
          int count,
          int *index_out,
          int *depth_out)
 {
+    node_t parent;
     int index;
 
     /* The last index will be count - 1 */
     index = count - 1;
 
+    /* Look up the parent */
+    parent = parent_id == NULL ? NULL : node_table_find_id(table, parent_id);
+
+    /* Index the child */
+    node_table_add(table, child);
+
     /* Trim the older nodes in the tree, and add the node if its
      * parent is in the tree. */
-    node_add1(self, parent_id, &child, &index, index_out, 0, depth_out);
+    node_add1(self, table, parent, &child, &index, index_out, 0, depth_out);
 
     /* Add the child now if it didn't get added already */
     if (child != NULL) {
@@ -452,35 +650,6 @@ node_add(node_t *self,
     }
 }
 
-/* Finds the node which wraps message */
-node_t
-node_find(node_t self, message_t message)
-{
-    node_t result;
-
-    /* Traverse the siblings until an answer is found */
-    while (self != NULL) {
-        /* Is it this node? */
-        if (self->message == message) {
-            return self;
-        }
-
-        /* Is it one of our children? */
-        if (self->child) {
-            result = node_find(self->child, message);
-            if (result != NULL) {
-                return result;
-            }
-        }
-
-        /* Try the next sibling */
-        self = self->sibling;
-    }
-
-    /* Not here */
-    return NULL;
-}
-
 /* Kills a node and its children */
 void
 node_kill(node_t self)
@@ -532,11 +701,26 @@ node_dump(node_t self, int depth)
 #endif
 
 
-/* Populate an array with message views */
+/* Fills in a row of the rows array.  The rows move about within the
+ * array, so their references are held on its behalf. */
+static void
+row_set(history_row_t self,
+        history_row_t rows,
+        message_t message,
+        long indent,
+        long width)
+{
+    self->message = message;
+    MESSAGE_ALLOC_REF(message, ref_row, rows);
+    self->indent = indent;
+    self->width = width;
+    self->view = NULL;
+}
+
+/* Populate an array with rows */
 static void
 node_populate(node_t self,
-              utf8_renderer_t renderer,
-              message_view_t *array,
+              history_row_t array,
               int depth,
               int *index,
               message_t selection,
@@ -546,7 +730,7 @@ node_populate(node_t self,
     while (self != NULL) {
         /* Add the children first */
         if (self->child) {
-            node_populate(self->child, renderer, array, depth + 1,
+            node_populate(self->child, array, depth + 1,
                           index, selection, selection_index_out);
         }
 
@@ -560,10 +744,9 @@ node_populate(node_t self,
             *selection_index_out = *index;
         }
 
-        /* Wrap the message in a message view */
-        /* FIX THIS: use a real conversion descriptor */
-        array[(*index)--] = message_view_alloc(self->message, depth,
-                                               renderer);
+        /* Give the message a row */
+        row_set(&array[*index], array, self->message, depth, self->width);
+        (*index)--;
 
         /* Move on to the next node */
         self = self->sibling;
@@ -576,6 +759,11 @@ node_populate(node_t self,
  *
  */
 
+static void
+flush_inserts(HistoryWidget self);
+static void
+redraw_all(Widget widget);
+
 /* Copy one region of the screen to another.  This uses XCopyArea to
  * perform the actual copying, and records information in the
  * translation queue so that GraphicsExpose events can be translated
@@ -713,6 +901,184 @@ compensate_bbox(HistoryWidget self,
     bbox->height = bottom - top;
 }
 
+/* Returns the slot in the circular rows array which holds the row at
+ * the given display index */
+static history_row_t
+row_slot(HistoryWidget self, unsigned int index)
+{
+    ASSERT(index < self->history.message_capacity);
+    return &self->history.rows[
+        (self->history.row_index + index) % self->history.message_capacity];
+}
+
+/* Returns the message_view of the row at the given display index,
+ * making one if necessary */
+static message_view_t
+row_view(HistoryWidget self, unsigned int index)
+{
+    history_row_t row = row_slot(self, index);
+
+    if (row->view == NULL) {
+        /* FIX THIS: use a real conversion descriptor! */
+        row->view = message_view_alloc(row->message, row->indent,
+                                       self->history.renderer);
+        if (row->view != NULL) {
+            self->history.view_count++;
+        }
+    }
+
+    return row->view;
+}
+
+/* Frees a row's message_view, if it has one */
+static void
+row_drop_view(HistoryWidget self, history_row_t row)
+{
+    if (row->view != NULL) {
+        message_view_free(row->view);
+        row->view = NULL;
+        self->history.view_count--;
+    }
+}
+
+/* Empties a row */
+static void
+row_clear(HistoryWidget self, history_row_t row)
+{
+    row_drop_view(self, row);
+    MESSAGE_FREE_REF(row->message, ref_row, self->history.rows);
+    row->message = NULL;
+}
+
+/* Frees the message_views of the rows which are well outside the
+ * given range of display indices */
+static void
+trim_views(HistoryWidget self, unsigned int first, unsigned int last)
+{
+    unsigned int i;
+
+    /* Don't bother until there are plenty of views to free */
+    if (self->history.view_count <= (last - first + VIEW_MARGIN * 2) * 2) {
+        return;
+    }
+
+    /* Widen the range by the margin */
+    first = first < VIEW_MARGIN ? 0 : first - VIEW_MARGIN;
+    last = last + VIEW_MARGIN;
+
+    /* Free the views outside of it */
+    for (i = 0; i < self->history.message_count; i++) {
+        if (i < first || last <= i) {
+            row_drop_view(self, row_slot(self, i));
+        }
+    }
+}
+
+/* Answers True if the row at the given display index is in or near
+ * the visible region, and so will be given a message_view as soon as
+ * it's painted */
+static Bool
+index_is_near_view(HistoryWidget self, unsigned int index)
+{
+    long first = (self->history.y - self->history.margin_height) /
+        self->history.line_height;
+    long last = (self->history.y + self->core.height) /
+        self->history.line_height + 1;
+
+    return first - VIEW_MARGIN <= (long)index &&
+        (long)index < last + VIEW_MARGIN;
+}
+
+/* Forget the widths of all rows */
+static void
+width_clear(HistoryWidget self)
+{
+    if (self->history.width_counts != NULL) {
+        memset(self->history.width_counts, 0,
+               self->history.width_counts_size * sizeof(unsigned int));
+    }
+
+    self->history.max_width = 0;
+}
+
+/* Returns the width of a row, not counting its timestamp */
+static unsigned long
+row_width(HistoryWidget self, history_row_t row)
+{
+    return (unsigned long)MAX(
+        row->indent * self->history.indent_width + row->width, 0);
+}
+
+/* Record the width of a row which is being added */
+static void
+width_add(HistoryWidget self, history_row_t row)
+{
+    unsigned long width;
+    unsigned long size;
+    unsigned int *counts;
+
+    /* Measure the row */
+    width = row_width(self, row);
+
+    /* Make sure the histogram is big enough to hold it */
+    if (self->history.width_counts_size <= width) {
+        size = MAX(width + 1, self->history.width_counts_size * 2);
+        counts = realloc(self->history.width_counts,
+                         size * sizeof(unsigned int));
+        if (counts == NULL) {
+            perror("realloc() failed");
+            exit(1);
+        }
+
+        /* Zero out the new entries */
+        memset(counts + self->history.width_counts_size, 0,
+               (size - self->history.width_counts_size) *
+               sizeof(unsigned int));
+        self->history.width_counts = counts;
+        self->history.width_counts_size = size;
+    }
+
+    /* Count it */
+    self->history.width_counts[width]++;
+    self->history.max_width = MAX(self->history.max_width, width);
+}
+
+/* Forget the width of a row which is being discarded */
+static void
+width_remove(HistoryWidget self, history_row_t row)
+{
+    unsigned long width;
+
+    /* Measure the row */
+    width = row_width(self, row);
+    ASSERT(width < self->history.width_counts_size);
+    ASSERT(self->history.width_counts[width] != 0);
+
+    /* Uncount it */
+    self->history.width_counts[width]--;
+
+    /* If that was the last of the widest rows then look for the
+     * next widest one */
+    if (width == self->history.max_width) {
+        while (self->history.max_width != 0 &&
+               self->history.width_counts[self->history.max_width] == 0) {
+            self->history.max_width--;
+        }
+    }
+}
+
+/* Updates the widget's dimensions to fit its rows */
+static void
+update_dimensions(HistoryWidget self)
+{
+    self->history.width = self->history.max_width +
+        (self->history.show_timestamps ? self->history.timestamp_width : 0) +
+        (long)self->history.margin_width * 2;
+    self->history.height =
+        (long)self->history.message_count * self->history.line_height +
+        (long)self->history.margin_height * 2;
+}
+
 /* Sets the origin of the visible portion of the widget */
 static void
 set_origin(HistoryWidget self, long x, long y, int update_scrollbars)
@@ -725,6 +1091,9 @@ set_origin(HistoryWidget self, long x, long y, int update_scrollbars)
     DPRINTF((5, "History.set_origin(x=%ld, y=%ld, update_scrollbars=%d)\n",
 	     x, y, update_scrollbars));
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Skip this part if we're not visible */
     if (gc != None) {
         /* Remove our clip mask */
@@ -826,6 +1195,17 @@ init(Widget request, Widget widget, ArgList args, Cardinal *num_args)
     self->history.width = (long)self->history.margin_width * 2;
     self->history.height = (long)self->history.margin_height * 2;
 
+    /* We haven't measured any rows yet */
+    self->history.width_counts = NULL;
+    self->history.width_counts_size = 0;
+    self->history.max_width = 0;
+
+    /* Measure the parts of a row which every message shares */
+    self->history.timestamp_width =
+        message_view_get_timestamp_width(self->history.renderer);
+    self->history.indent_width =
+        message_view_get_indent_width(self->history.renderer);
+
     /* Compute the line height */
     self->history.line_height = (long)self->history.font->ascent +
         (long)self->history.font->descent + 1;
@@ -848,12 +1228,22 @@ init(Widget request, Widget widget, ArgList args, Cardinal *num_args)
 
     /* Allocate enough room for all of our message views */
     self->history.message_capacity = MAX(self->history.message_capacity, 1);
+    self->history.node_table =
+        node_table_alloc(self->history.message_capacity);
+    if (self->history.node_table == NULL) {
+        perror("node_table_alloc() failed");
+        exit(1);
+    }
     self->history.messages = calloc(self->history.message_capacity,
                                     sizeof(message_t));
+    self->history.message_widths = calloc(self->history.message_capacity,
+                                          sizeof(long));
     self->history.message_count = 0;
     self->history.message_index = 0;
-    self->history.message_views = calloc(self->history.message_capacity,
-                                         sizeof(message_view_t));
+    self->history.rows = calloc(self->history.message_capacity,
+                                sizeof(struct history_row));
+    self->history.row_index = 0;
+    self->history.view_count = 0;
 
     /* Nothing is selected yet */
     self->history.selection = NULL;
@@ -862,6 +1252,10 @@ init(Widget request, Widget widget, ArgList args, Cardinal *num_args)
     self->history.drag_direction = DRAG_NONE;
     self->history.show_timestamps = False;
 
+    /* No insertions are waiting to be painted */
+    self->history.flush_timer = None;
+    self->history.pending_count = 0;
+
     /* Nothing has been copied yet. */
     self->history.copy_message = NULL;
     self->history.copy_part = MSGPART_NONE;
@@ -1075,11 +1469,15 @@ paint(HistoryWidget self, XRectangle *bbox)
     long xmargin = (long)self->history.margin_width;
     long ymargin = (long)self->history.margin_height;
     int show_timestamps = self->history.show_timestamps;
+    history_row_t row;
     message_view_t view;
     XGCValues values;
-    unsigned int index;
+    unsigned int first, index;
     long x, y;
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Set that as our bounding box */
     XSetClipRectangles(display, gc, 0, 0, bbox, 1, YXSorted);
 
@@ -1098,16 +1496,18 @@ paint(HistoryWidget self, XRectangle *bbox)
         y = (ymargin - self->history.y) % self->history.line_height;
     }
 
-    /* Draw all visible message views */
+    /* Draw all visible rows, making their message views as needed */
+    first = index;
     while (index < self->history.message_count) {
         /* Stop if we run out of message views. */
-        view = self->history.message_views[index++];
+        row = row_slot(self, index);
+        view = row_view(self, index++);
         if (view == NULL) {
-            return;
+            break;
         }
 
         /* Is this the selected message? */
-        if (message_view_get_message(view) == self->history.selection) {
+        if (row->message == self->history.selection) {
             /* Yes, draw a background for it */
             values.foreground = self->history.selection_pixel;
             XChangeGC(display, gc, GCForeground, &values);
@@ -1133,9 +1533,12 @@ paint(HistoryWidget self, XRectangle *bbox)
 
         /* Bail out if the next line is past the end of the screen */
         if (y >= self->core.height) {
-            return;
+            break;
         }
     }
+
+    /* Free the views of rows which have scrolled well out of sight */
+    trim_views(self, first, index);
 }
 
 /* Redisplay the given region */
@@ -1152,6 +1555,9 @@ redisplay(Widget widget, XEvent *event, Region region)
         return;
     }
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Find the smallest rectangle which contains the region */
     XClipBox(region, &bbox);
 
@@ -1201,14 +1607,14 @@ motion_cb(Widget widget, XtPointer closure, XEvent *event,
     HistoryWidget self = (HistoryWidget)widget;
     XMotionEvent *mevent;
     unsigned int index;
-    message_view_t view;
+    message_t message;
 
     /* Sanity check */
     ASSERT(event->type == MotionNotify);
     mevent = (XMotionEvent *)event;
 
     /* Assume that nothing is under the pointer */
-    view = NULL;
+    message = NULL;
 
     /* Make sure the pointer is within the bounds of the widget */
     if (0 <= mevent->y && mevent->y < self->core.height) {
@@ -1216,13 +1622,12 @@ motion_cb(Widget widget, XtPointer closure, XEvent *event,
 
         /* Make sure it's over a message */
         if (index < self->history.message_count) {
-            view = self->history.message_views[index];
+            message = row_slot(self, index)->message;
         }
     }
 
     /* Call the callbacks */
-    XtCallCallbackList(widget, self->history.motion_callbacks,
-                       view ? message_view_get_message(view) : NULL);
+    XtCallCallbackList(widget, self->history.motion_callbacks, message);
 }
 
 /* Repaint the bits of the widget that didn't get copied */
@@ -1231,6 +1636,9 @@ gexpose(HistoryWidget self, XGraphicsExposeEvent *event)
 {
     XRectangle bbox;
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Get the bounding box of the event. */
     bbox.x = event->x;
     bbox.y = event->y;
@@ -1316,26 +1724,17 @@ process_events(Widget widget, XtPointer closure, XEvent *event,
 static void
 recompute_dimensions(HistoryWidget self)
 {
-    int show_timestamps = self->history.show_timestamps;
-    long width = 0;
-    long height = 0;
     unsigned int i;
     long x, y;
 
-    /* Measure each message */
+    /* Count the width of each row */
+    width_clear(self);
     for (i = 0; i < self->history.message_count; i++) {
-        struct string_sizes sizes;
-
-        message_view_get_sizes(self->history.message_views[i],
-                               show_timestamps,
-                               &sizes);
-        width = MAX(width, sizes.width);
-        height += self->history.line_height;
+        width_add(self, row_slot(self, i));
     }
 
     /* Update our dimensions */
-    self->history.width = width + (long)self->history.margin_width * 2;
-    self->history.height = height + (long)self->history.margin_height * 2;
+    update_dimensions(self);
 
     /* And update the scrollbars */
     update_scrollbars((Widget)self, &x, &y);
@@ -1371,190 +1770,223 @@ realize(Widget widget,
     XtAddEventHandler(widget, PointerMotionMask, False, motion_cb, NULL);
 }
 
-/* Insert a message before the given index */
+/* Paints the insertions made since the last repaint: one XCopyArea
+ * to move the older rows to their new places, one update of
+ * the scrollbars and a repaint of the new rows */
 static void
-insert_message(HistoryWidget self,
-               unsigned int index,
-               unsigned int indent,
-               message_t message)
+flush_inserts(HistoryWidget self)
 {
     Display *display = XtDisplay((Widget)self);
     Window window = XtWindow((Widget)self);
-    message_view_t view;
-    struct string_sizes sizes;
-    long y = 0;
-    long delta_y;
-    long width = 0;
-    long height = 0;
+    GC gc = self->history.gc;
+    XGCValues values;
     XRectangle bbox;
+    long old_x = self->history.x;
+    long old_y = self->history.y;
+    long delta_y;
+    long x, y;
+    long top, bottom;
+
+    /* Bail if there's nothing to do */
+    if (self->history.pending_count == 0) {
+        return;
+    }
+
+    /* Don't come back here until there are more insertions */
+    self->history.pending_count = 0;
+    if (self->history.flush_timer != None) {
+        XtRemoveTimeOut(self->history.flush_timer);
+        self->history.flush_timer = None;
+    }
+
+    /* Scroll down to keep the new messages in view */
+    if (self->core.height < self->history.height) {
+        delta_y = MAX(0, (long)self->history.height -
+                      MAX((long)self->history.pending_height,
+                          (long)self->core.height));
+    } else {
+        delta_y = 0;
+    }
+
+    /* Update the scrollbars */
+    update_scrollbars((Widget)self, &x, &y);
+    y += delta_y;
+    if (old_y != y) {
+        XtVaSetValues(self->history.vscrollbar, XmNvalue, (int)y, NULL);
+    }
+
+    self->history.x = x;
+    self->history.y = y;
+
+    /* Bail if we're not visible */
+    if (gc == None) {
+        return;
+    }
+
+    /* Repaint everything if the older rows moved unevenly */
+    if (self->history.pending_redraw) {
+        redraw_all((Widget)self);
+        return;
+    }
+
+    /* Remove our clip mask */
+    values.clip_mask = None;
+    values.foreground = self->core.background_pixel;
+    XChangeGC(display, gc, GCClipMask | GCForeground, &values);
+
+    /* Move the older rows to their new places.  Anything
+     * which was out of sight will be repainted when the
+     * GraphicsExpose events arrive. */
+    if (x != old_x || y - old_y != self->history.pending_shift) {
+        copy_area(self, display, window, gc,
+                  x - old_x, y - old_y - self->history.pending_shift,
+                  self->core.width, self->core.height,
+                  0, 0);
+    }
+
+    /* Find the new rows */
+    top = self->history.margin_height - y +
+        (long)self->history.pending_index * self->history.line_height;
+    bottom = self->history.margin_height - y +
+        (long)self->history.message_count * self->history.line_height;
+    top = MAX(top, 0);
+    bottom = MIN(bottom, (long)self->core.height);
+
+    /* Erase and repaint them */
+    if (top < bottom) {
+        bbox.x = 0;
+        bbox.y = top;
+        bbox.width = self->core.width;
+        bbox.height = bottom - top;
+
+        XFillRectangle(display, window, gc,
+                       bbox.x, bbox.y, bbox.width, bbox.height);
+        paint(self, &bbox);
+    }
+
+    /* Repaint the selection so that the right edge is drawn properly */
+    if (self->history.width != self->history.pending_width) {
+        redisplay_index(self, self->history.selection_index);
+    }
+}
+
+/* Paints the insertions made during the last pass through the event
+ * loop */
+static void
+flush_timer_cb(XtPointer closure, XtIntervalId *id)
+{
+    HistoryWidget self = (HistoryWidget)closure;
+
+    ASSERT(self->history.flush_timer == *id);
+    self->history.flush_timer = None;
+    flush_inserts(self);
+}
+
+/* Insert a message before the given index, with its message_view if
+ * one has already been made.  The rows are updated immediately, but
+ * the painting is put off until the end of this pass through the
+ * event loop so that a burst of messages is painted all at once. */
+static void
+insert_message(HistoryWidget self,
+               unsigned int index,
+               unsigned int indent,
+               message_t message,
+               long width,
+               message_view_t view)
+{
+    history_row_t row;
     unsigned int i;
-    XGCValues values;
-    GC gc = self->history.gc;
-    int show_timestamps = self->history.show_timestamps;
-    long xpos, ypos;
 
     /* Sanity check */
     ASSERT(index <= self->history.message_count);
 
-    /* Cancel our clip mask */
-    if (gc != None) {
-        values.clip_mask = None;
-        values.foreground = self->core.background_pixel;
-        XChangeGC(display, gc, GCClipMask | GCForeground, &values);
+    /* Start a new batch if necessary */
+    if (self->history.pending_count == 0) {
+        self->history.pending_index = self->history.message_count;
+        self->history.pending_shift = 0;
+        self->history.pending_redraw = False;
+        self->history.pending_width = self->history.width;
+        self->history.pending_height = self->history.height;
     }
 
     /* If there's still room then we'll have to move stuff down */
     if (self->history.message_count < self->history.message_capacity) {
-        /* Measure the nodes before the index */
-        for (i = 0; i < index; i++) {
-            view = self->history.message_views[i];
-
-            /* Measure the view */
-            message_view_get_sizes(view, show_timestamps, &sizes);
-            width = MAX(width, sizes.width);
-            y += self->history.line_height;
-            height += self->history.line_height;
-        }
-
-        /* Measure the nodes after the index, moving them down to make
-         * room for the new message. */
+        /* Move the nodes after the index down to make room for the
+         * new message. */
         for (i = self->history.message_count; i > index; i--) {
-            view = self->history.message_views[i - 1];
-
-            /* Measure the view */
-            message_view_get_sizes(view, show_timestamps, &sizes);
-            width = MAX(width, sizes.width);
-            height += self->history.line_height;
-
-            /* Move it */
-            self->history.message_views[i] = view;
+            *row_slot(self, i) = *row_slot(self, i - 1);
             if (self->history.selection_index == i - 1) {
                 self->history.selection_index = i;
             }
         }
 
-        /* Move stuff down to make room */
-        if (gc != None) {
-            copy_area(self, display, window, gc,
-                      0, self->history.margin_height - self->history.y + y,
-                      self->core.width, height - y,
-                      0, self->history.margin_height -
-                      self->history.y + y + self->history.line_height);
+        /* If older rows moved down then we'll have to
+         * repaint them */
+        if (index < self->history.pending_index) {
+            self->history.pending_redraw = True;
         }
 
         /* We've got another node */
         self->history.message_count++;
     } else {
-        /* Discard the first message view */
-        message_view_free(self->history.message_views[0]);
+        /* Discard the first row */
+        row = row_slot(self, 0);
+        width_remove(self, row);
+        row_clear(self, row);
+
+        /* Rotate the circular array so that the nodes before the
+         * index move up to make room for the new message */
+        self->history.row_index = (self->history.row_index + 1) %
+            self->history.message_capacity;
         if (self->history.selection_index == 0) {
             self->history.selection_index = (unsigned int)-1;
+        } else if (self->history.selection_index != (unsigned int)-1) {
+            self->history.selection_index--;
         }
 
-        /* Measure the nodes before the index, moving them up to make
-         * room for the new message. */
-        for (i = 0; i < index; i++) {
-            view = self->history.message_views[i + 1];
-
-            /* Measure the view */
-            message_view_get_sizes(view, show_timestamps, &sizes);
-            width = MAX(width, sizes.width);
-            y += self->history.line_height;
-            height += self->history.line_height;
-
-            /* Move it up */
-            self->history.message_views[i] = view;
-
-            /* Update the selection index */
-            if (self->history.selection_index == i + 1) {
+        /* Move the nodes after the index back down to where they
+         * were.  This never happens when the history is unthreaded,
+         * since new messages always go at the end. */
+        for (i = self->history.message_count - 1; i > index; i--) {
+            *row_slot(self, i) = *row_slot(self, i - 1);
+            if (self->history.selection_index == i - 1) {
                 self->history.selection_index = i;
             }
         }
 
-        /* Measure the nodes after the index */
-        for (i = index + 1; i < self->history.message_count; i++) {
-            view = self->history.message_views[i];
-
-            /* Measure the view */
-            message_view_get_sizes(view, show_timestamps, &sizes);
-            width = MAX(width, sizes.width);
-            height += self->history.line_height;
+        /* Everything before the index moved up a line */
+        self->history.pending_shift -= self->history.line_height;
+        if (self->history.pending_index != 0) {
+            self->history.pending_index--;
         }
 
-        /* Move stuff up to make room */
-        if (gc != None) {
-            copy_area(self, display, window, gc,
-                      0, self->history.margin_height -
-                      self->history.y + self->history.line_height,
-                      self->core.width, y,
-                      0, self->history.margin_height - self->history.y);
+        /* The older rows after it didn't */
+        if (index + 1 < self->history.pending_index) {
+            self->history.pending_redraw = True;
         }
     }
 
-    /* Create a new message view */
-    /* FIX THIS: use a real conversion descriptor! */
-    view = message_view_alloc(message, indent, self->history.renderer);
-    self->history.message_views[index] = view;
-
-    /* Measure it */
-    message_view_get_sizes(view, show_timestamps, &sizes);
-    width = MAX(width, sizes.width);
-    height += self->history.line_height;
-
-    /* Paint it */
-    if (gc != None) {
-        /* Remove any remains of the previous message */
-        XFillRectangle(display, window, gc,
-                       0, self->history.margin_height -
-                       self->history.y + y,
-                       self->core.width, self->history.line_height);
-
-        /* Make a bounding box */
-        bbox.x = 0;
-        bbox.y = self->history.margin_height - self->history.y + y;
-        bbox.width = self->core.width;
-        bbox.height = self->history.line_height;
-
-        /* Use it to draw the new message */
-        message_view_paint(view, display, window, gc,
-                           self->history.show_timestamps,
-                           self->history.timestamp_pixel,
-                           self->history.group_pixel,
-                           self->history.user_pixel,
-                           self->history.string_pixel,
-                           self->history.separator_pixel,
-                           self->history.margin_width - self->history.x,
-                           self->history.margin_height - self->history.y +
-                           y + self->history.font->ascent,
-                           &bbox);
-    }
-
-    /* Add the margins to our height and width */
-    width += (long)self->history.margin_width * 2;
-    height += (long)self->history.margin_height * 2;
-
-    /* Has the width changed? */
-    if (self->history.width != width) {
-        self->history.width = width;
-
-        /* Repaint the selection so that the right edge is drawn properly */
-        redisplay_index(self, self->history.selection_index);
-    }
-
-    /* Update our height */
-    if (self->core.height < height) {
-        delta_y =
-            MAX(0, height -
-                MAX((long)self->history.height, (long)self->core.height));
-    } else {
-        delta_y = 0;
+    /* Give the message a row.  Unless we were given a view, one is
+     * made when it's painted. */
+    row = row_slot(self, index);
+    row_set(row, self->history.rows, message, indent, width);
+    if (view != NULL) {
+        row->view = view;
+        self->history.view_count++;
     }
+    self->history.pending_index = MIN(self->history.pending_index, index);
 
-    self->history.height = height;
+    /* Count its width */
+    width_add(self, row);
+    update_dimensions(self);
 
-    /* Update the scrollbars */
-    update_scrollbars((Widget)self, &xpos, &ypos);
-    set_origin(self, xpos, ypos + delta_y, True);
+    /* Paint it later */
+    self->history.pending_count++;
+    if (self->history.flush_timer == None) {
+        self->history.flush_timer =
+            XtAppAddTimeOut(XtWidgetToApplicationContext((Widget)self),
+                            0, flush_timer_cb, self);
+    }
 }
 
 /* Make sure the given index is visible */
@@ -1596,6 +2028,9 @@ set_selection(HistoryWidget self, unsigned int index, message_t message)
     XRectangle bbox;
     long y;
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Is this the same selection as before? */
     if (self->history.selection == message) {
         /* Just make sure it's visible */
@@ -1639,7 +2074,7 @@ set_selection(HistoryWidget self, unsigned int index, message_t message)
 
             /* And then draw it again */
             message_view_paint(
-                self->history.message_views[self->history.selection_index],
+                row_view(self, self->history.selection_index),
                 display, window, gc,
                 self->history.show_timestamps,
                 self->history.timestamp_pixel,
@@ -1685,7 +2120,7 @@ set_selection(HistoryWidget self, unsigned int index, message_t message)
 
             /* And then draw the message view on top of it */
             message_view_paint(
-                self->history.message_views[self->history.selection_index],
+                row_view(self, self->history.selection_index),
                 display, window, gc,
                 self->history.show_timestamps,
                 self->history.timestamp_pixel,
@@ -1708,25 +2143,41 @@ set_selection(HistoryWidget self, unsigned int index, message_t message)
 static void
 set_selection_index(HistoryWidget self, unsigned int index)
 {
-    message_view_t view;
+    message_t message;
 
-    /* Locate the message view at that index */
+    /* Locate the message at that index */
     if (index < self->history.message_count) {
-        view = self->history.message_views[index];
+        message = row_slot(self, index)->message;
     } else {
         index = (unsigned int)-1;
-        view = NULL;
+        message = NULL;
     }
 
     /* Select it */
-    set_selection(self, index, view ? message_view_get_message(view) : NULL);
+    set_selection(self, index, message);
 }
 
 /* Destroy the widget */
 static void
-destroy(Widget self)
+destroy(Widget widget)
 {
+    HistoryWidget self = (HistoryWidget)widget;
+
     DPRINTF((3, "History.destroy()\n"));
+
+    /* Forget about any pending insertions */
+    if (self->history.flush_timer != None) {
+        XtRemoveTimeOut(self->history.flush_timer);
+        self->history.flush_timer = None;
+    }
+
+    /* Free the width histogram */
+    free(self->history.width_counts);
+    self->history.width_counts = NULL;
+
+    /* Free the node table */
+    node_table_free(self->history.node_table);
+    self->history.node_table = NULL;
 }
 
 /* Resize the widget */
@@ -1740,6 +2191,9 @@ resize(Widget widget)
     DPRINTF((3, "History.resize(w=%d, h=%d)\n",
              self->core.width, self->core.height));
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Update the page increment of the horizontal scrollbar */
     page_inc = self->core.height;
     XtVaSetValues(self->history.hscrollbar,
@@ -2226,6 +2680,9 @@ redraw_all(Widget widget)
         return;
     }
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Set up the graphics context */
     values.clip_mask = None;
     values.foreground = self->core.background_pixel;
@@ -2281,15 +2738,23 @@ HistorySetThreaded(Widget widget, Boolean is_threaded)
         return;
     }
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Change threaded status */
     self->history.is_threaded = is_threaded;
 
-    /* Get rid of all of the old message views */
+    /* Get rid of all of the old rows */
     for (i = 0; i < self->history.message_count; i++) {
-        message_view_free(self->history.message_views[i]);
+        row_clear(self, row_slot(self, i));
     }
 
-    /* Create a bunch of new message views accordingly */
+    /* The new rows will start at the beginning of the array */
+    self->history.row_index = 0;
+
+    /* Fill in a bunch of new rows accordingly.  Their widths were
+     * measured when the messages arrived, and their message views
+     * won't be made until they're painted. */
     if (is_threaded) {
         index = self->history.message_count - 1;
 
@@ -2298,8 +2763,7 @@ HistorySetThreaded(Widget widget, Boolean is_threaded)
 
         /* Traverse the history tree */
         node_populate(self->history.nodes,
-                      self->history.renderer,
-                      self->history.message_views,
+                      self->history.rows,
                       0, &index,
                       self->history.selection,
                       &self->history.selection_index);
@@ -2310,9 +2774,9 @@ HistorySetThreaded(Widget widget, Boolean is_threaded)
             /* Look up the message */
             message = self->history.messages[index];
 
-            /* Wrap it in a message view */
-            self->history.message_views[i] =
-                message_view_alloc(message, 0, self->history.renderer);
+            /* Give it a row */
+            row_set(&self->history.rows[i], self->history.rows, message, 0,
+                    self->history.message_widths[index]);
 
             /* Update the selection index */
             if (self->history.selection == message) {
@@ -2345,6 +2809,9 @@ HistorySetShowTimestamps(Widget widget, Boolean show_timestamps)
 {
     HistoryWidget self = (HistoryWidget)widget;
 
+    /* Catch up on any pending insertions first */
+    flush_inserts(self);
+
     /* Update the flag */
     self->history.show_timestamps = show_timestamps;
 
@@ -2369,7 +2836,10 @@ void
 HistoryAddMessage(Widget widget, message_t message)
 {
     HistoryWidget self = (HistoryWidget)widget;
+    struct string_sizes sizes;
+    message_view_t view = NULL;
     node_t node;
+    long width;
     int index;
     int depth;
 
@@ -2381,6 +2851,7 @@ HistoryAddMessage(Widget widget, message_t message)
 
     /* Add the node to the threaded history tree */
     node_add(&self->history.nodes,
+             self->history.node_table,
              message_get_reply_id(message),
              node,
              MIN(self->history.message_count + 1,
@@ -2388,10 +2859,36 @@ HistoryAddMessage(Widget widget, message_t message)
              &index,
              &depth);
 
+    /* Work out where its row goes according to our threadedness */
+    if (!HistoryIsThreaded(widget)) {
+        index = self->history.message_count <
+            self->history.message_capacity ?
+            self->history.message_count : self->history.message_capacity - 1;
+        depth = 0;
+    }
+
+    /* If the row will be painted straight away then make its message
+     * view now and measure that, so that its strings are only
+     * transcoded once.  Otherwise just measure it, since it may never
+     * be painted. */
+    if (index_is_near_view(self, (unsigned int)index)) {
+        view = message_view_alloc(message, depth, self->history.renderer);
+    }
+
+    if (view != NULL) {
+        message_view_get_sizes(view, False, &sizes);
+        width = sizes.width - depth * self->history.indent_width;
+    } else {
+        width = message_view_measure(message, self->history.renderer);
+    }
+
+    node->width = width;
+
     /* If we're not at capacity then just add a reference to the end
      * of the array of messages */
     if (self->history.message_count < self->history.message_capacity) {
         self->history.messages[self->history.message_count] = message;
+        self->history.message_widths[self->history.message_count] = width;
         MESSAGE_ALLOC_REF(message, ref_history, self);
     } else {
         /* Free the old message */
@@ -2400,23 +2897,15 @@ HistoryAddMessage(Widget widget, message_t message)
 
         /* Replace it with this message */
         self->history.messages[self->history.message_index] = message;
+        self->history.message_widths[self->history.message_index] = width;
         MESSAGE_ALLOC_REF(message, ref_history, self);
 
         self->history.message_index = (self->history.message_index + 1) %
             self->history.message_capacity;
     }
 
-    /* Add the node according to our threadedness */
-    if (HistoryIsThreaded(widget)) {
-        insert_message(self, index, depth, message);
-    } else {
-        insert_message(
-            self,
-            self->history.message_count < self->history.message_capacity ?
-            self->history.message_count : self->history.message_capacity - 1,
-            0,
-            message);
-    }
+    /* Give it a row */
+    insert_message(self, index, depth, message, width, view);
 }
 
 /* Kills the thread of the given message */
@@ -2432,7 +2921,7 @@ HistoryKillThread(Widget widget, message_t message)
     }
 
     /* Look for the node which wraps the message */
-    node = node_find(self->history.nodes, message);
+    node = node_table_find_message(self->history.node_table, message);
     if (node == NULL) {
         /* The message is killed now */
         message_set_killed(message, True);
@@ -2453,8 +2942,7 @@ HistorySelect(Widget widget, message_t message)
     if (message != NULL) {
         /* Find the index of the message */
         for (i = 0; i < self->history.message_count; i++) {
-            if (message_view_get_message(self->history.message_views[i]) ==
-                message) {
+            if (row_slot(self, i)->message == message) {
                 set_selection(self, i, message);
                 return;
             }
@@ -2473,25 +2961,41 @@ HistorySelectId(Widget widget, const char *message_id)
     message_t message;
     unsigned int i;
     const char *string;
+    node_t node;
 
     /* Save the effort if there's no id */
     if (message_id != NULL) {
-        /* Find the index of the message */
-        for (i = self->history.message_count; i > 0; --i) {
-            message =
-                message_view_get_message(self->history.message_views[i - 1]);
-            if (message == NULL) {
-                continue;
-            }
-
-            string = message_get_id(message);
-            if (string == NULL) {
-                continue;
+        /* Look the message up in the node table */
+        node = node_table_find_id(self->history.node_table, message_id);
+        if (node != NULL) {
+            /* Find its index by comparing pointers rather than ids */
+            for (i = self->history.message_count; i > 0; --i) {
+                if (row_slot(self, i - 1)->message == node->message) {
+                    set_selection(self, i - 1, node->message);
+                    return;
+                }
             }
+        }
 
-            if (strcmp(string, message_id) == 0) {
-                set_selection(self, i - 1, message);
-                return;
+        /* The threaded view only shows messages in the node table,
+         * but the unthreaded view may still show a message whose
+         * node has been discarded, so look for it the hard way */
+        if (!self->history.is_threaded) {
+            for (i = self->history.message_count; i > 0; --i) {
+                message = row_slot(self, i - 1)->message;
+                if (message == NULL) {
+                    continue;
+                }
+
+                string = message_get_id(message);
+                if (string == NULL) {
+                    continue;
+                }
+
+                if (strcmp(string, message_id) == 0) {
+                    set_selection(self, i - 1, message);
+                    return;
+                }
             }
         }
     }
@@ -66,6 +66,12 @@ typedef struct translation_queue *translation_queue_t;
 /* The history is stored as nodes in a tree and list */
 typedef struct node *node_t;
 
+/* The nodes are also indexed by Message-Id and by message */
+typedef struct node_table *node_table_t;
+
+/* The messages are displayed as rows */
+typedef struct history_row *history_row_t;
+
 /* Which way are we dragging? */
 typedef enum {
     DRAG_NONE,
@@ -143,6 +149,21 @@ typedef struct {
     /* The height of all of the strings in the history widget */
     unsigned long height;
 
+    /* The number of rows of each width, indexed by width */
+    unsigned int *width_counts;
+
+    /* The number of entries in the width_counts array */
+    unsigned long width_counts_size;
+
+    /* The width of the widest row (excluding margins and timestamps) */
+    unsigned long max_width;
+
+    /* The extra width of a row when timestamps are shown */
+    long timestamp_width;
+
+    /* The width of one level of indentation */
+    long indent_width;
+
     /* The height of a line in the history widget */
     long line_height;
 
@@ -170,17 +191,29 @@ typedef struct {
     /* The history as both tree and list */
     node_t nodes;
 
+    /* The nodes indexed by Message-Id and by message */
+    node_table_t node_table;
+
     /* The messages in order of receipt */
     message_t *messages;
 
-    /* The number of message_views in the history */
+    /* The widths of the messages (see message_view_measure) */
+    long *message_widths;
+
+    /* The number of rows in the history */
     unsigned int message_count;
 
     /* The first index messages circular array */
     unsigned int message_index;
 
-    /* An array of message_views in display order */
-    message_view_t *message_views;
+    /* A circular array of rows in display order */
+    history_row_t rows;
+
+    /* The index of the first row in the circular array */
+    unsigned int row_index;
+
+    /* The number of rows which have a message_view */
+    unsigned int view_count;
 
     /* The currently selected message_t (NULL if none) */
     message_t selection;
@@ -194,6 +227,28 @@ typedef struct {
     /* The direction in which to drag */
     drag_direction_t drag_direction;
 
+    /* The timer which repaints after a burst of insertions */
+    XtIntervalId flush_timer;
+
+    /* The number of insertions which haven't been painted yet */
+    unsigned int pending_count;
+
+    /* The index of the first row inserted since the last
+     * repaint; every row after it is new too */
+    unsigned int pending_index;
+
+    /* The vertical distance the older rows have moved since
+     * the last repaint */
+    long pending_shift;
+
+    /* True if the older rows have moved unevenly and the
+     * whole widget must be repainted */
+    Boolean pending_redraw;
+
+    /* The width and height of the history at the last repaint */
+    unsigned long pending_width;
+    unsigned long pending_height;
+
     /* Non-zero if the timestamps should be displayed */
     int show_timestamps;
 
@@ -45,11 +45,23 @@
 # include <stdlib.h> /* calloc, free, malloc */
 #endif
 #ifdef HAVE_STRING_H
-# include <string.h> /* memset */
+# include <string.h> /* memset, strcmp */
 #endif
 #ifdef HAVE_ASSERT_H
 # include <assert.h> /* assert */
 #endif
+#ifdef HAVE_TIME_H
+# include <time.h> /* clock_gettime, time */
+#endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h> /* gettimeofday */
+#endif
+#ifdef HAVE_SYS_IPC_H
+# include <sys/ipc.h> /* IPC_PRIVATE, IPC_RMID */
+#endif
+#ifdef HAVE_SYS_SHM_H
+# include <sys/shm.h> /* shmat, shmctl, shmdt, shmget */
+#endif
 #include <X11/Xlib.h>
 #include <X11/IntrinsicP.h>
 #include <X11/StringDefs.h>
@@ -61,6 +73,7 @@
 #include "replace.h"
 #include "globals.h"
 #include "utils.h"
+#include "slab.h"
 #include "utf8.h"
 #include "message.h"
 #include "message_view.h"
@@ -140,12 +153,42 @@ static XtResource resources[] =
         offset(scroller.drag_delta), XtRImmediate, (XtPointer)3
     },
 
+    /* Dimension lane_count */
+    {
+        XtNlanes, XtCLanes, XtRDimension, sizeof(Dimension),
+        offset(scroller.lane_count), XtRImmediate, (XtPointer)1
+    },
+
+    /* Boolean group_lanes */
+    {
+        XtNgroupLanes, XtCGroupLanes, XtRBoolean, sizeof(Boolean),
+        offset(scroller.group_lanes), XtRImmediate, (XtPointer)False
+    },
+
+    /* Dimension overflow_factor (in widget widths) */
+    {
+        XtNoverflowFactor, XtCOverflowFactor, XtRDimension, sizeof(Dimension),
+        offset(scroller.overflow_factor), XtRImmediate, (XtPointer)0
+    },
+
     /* Boolean use_pixmap */
     {
         XtNusePixmap, XtCUsePixmap, XtRBoolean, sizeof(Boolean),
         offset(scroller.use_pixmap), XtRImmediate, (XtPointer)False
     },
 
+    /* Boolean use_glyph_pixmaps */
+    {
+        XtNuseGlyphPixmaps, XtCUseGlyphPixmaps, XtRBoolean, sizeof(Boolean),
+        offset(scroller.use_glyph_pixmaps), XtRImmediate, (XtPointer)False
+    },
+
+    /* Boolean use_shared_memory */
+    {
+        XtNuseSharedMemory, XtCUseSharedMemory, XtRBoolean, sizeof(Boolean),
+        offset(scroller.use_shared_memory), XtRImmediate, (XtPointer)False
+    },
+
     /* Dimension frequency (in Hz) */
     {
         XtNfrequency, XtCFrequency, XtRDimension, sizeof(Dimension),
@@ -169,6 +212,10 @@ scroll(ScrollerWidget self, int offset);
 
 static void
 redisplay(ScrollerWidget self, Region region);
+static Bool
+image_alloc(ScrollerWidget self);
+static void
+image_sync(ScrollerWidget self);
 static void
 gexpose(Widget widget, XtPointer rock, XEvent *event, Boolean *ignored);
 static void
@@ -184,6 +231,7 @@ static const char *ref_gap = "gap";
 static const char *ref_queue = "queue";
 static const char *ref_holder = "holder";
 static const char *ref_replace = "replace";
+static const char *ref_summary = "summary";
 #endif /* DEBUG */
 
 /* The structure of a glyph */
@@ -205,6 +253,9 @@ struct glyph {
     /* The widget which display's this glyph */
     ScrollerWidget widget;
 
+    /* The lane whose queue holds this glyph */
+    scroller_lane_t lane;
+
 #if defined(DEBUG_GLYPH)
     /* The references to this glyph. */
     explicit_ref_t refs;
@@ -228,15 +279,87 @@ struct glyph {
     /* Is this glyph expired? */
     Bool is_expired;
 
-    /* Our timeout's id or None */
-    XtIntervalId timeout;
+    /* The fade wheel tick at which the glyph should next fade */
+    unsigned long fade_time;
+
+    /* The fade wheel list containing this glyph, or NULL if none */
+    glyph_t *wheel_list;
+
+    /* The previous glyph in the same fade wheel list */
+    glyph_t wheel_previous;
+
+    /* The next glyph in the same fade wheel list */
+    glyph_t wheel_next;
+
+    /* True if the glyph has faded since it was last painted */
+    Bool is_faded;
+
+    /* The glyph rendered at pixmap_level, or None if not rendered */
+    Pixmap pixmap;
+
+    /* The fade level at which the pixmap was rendered */
+    int pixmap_level;
+
+    /* The next glyph in the same glyph_tags bucket */
+    glyph_t tag_next;
+
+    /* The number of messages the glyph stands for: 1 unless it
+     * summarizes a collapsed backlog, or 0 for the gap */
+    unsigned long message_count;
+
+    /* The newest message in a summary's backlog, or NULL */
+    message_t summary_of;
+
+    /* The width the glyph adds to its lane's backlog_width: its own
+     * width until it's first shown or expires, then 0 */
+    long backlog_width;
 };
 
+/* The slab from which glyphs are allocated */
+static slab_t glyph_slab;
+
+/* The initial number of buckets in the tag tables */
+#define TAGS_INITIAL_SIZE 64
+
+/* The fade wheel has WHEEL_LEVELS levels of WHEEL_SLOTS lists each.
+ * The lists in the first level each cover one tick of WHEEL_TICK
+ * milliseconds, and those in each subsequent level cover WHEEL_SLOTS
+ * times as many ticks as the one before it, so four levels of 64
+ * lists of 25ms ticks can hold glyphs due to fade up to 116 hours in
+ * the future. */
+#define WHEEL_TICK 25
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN (1UL << (WHEEL_BITS * WHEEL_LEVELS))
+
+/* The longest time in seconds which a single tick will scroll for,
+ * so that the text doesn't leap across the screen after a long
+ * stall */
+#define MAX_TICK_DELAY 0.25
+
+/* The most fade wheel ticks a single turn will advance.  If we fall
+ * further behind than this then the rest is made up on later turns
+ * rather than blocking the event loop */
+#define MAX_WHEEL_STEPS 256
+
+/* The widest glyph which is cached in a pixmap.  X limits pixmaps to
+ * 65535 pixels and copy offsets to 32767, so wider glyphs are drawn
+ * directly instead */
+#define MAX_GLYPH_PIXMAP_WIDTH 4096
+
 /* Forward declaration */
 static void
 glyph_free(glyph_t self);
 static void
 glyph_set_clock(glyph_t self, int level_count);
+static void
+tags_grow(ScrollerWidget self);
+static void
+wheel_remove(glyph_t glyph);
+static void
+fade_set_clock(ScrollerWidget self);
 
 #if defined(DEBUG_GLYPH)
 # define GLYPH_ALLOC_REF(glyph, type, rock)                     \
@@ -264,6 +387,17 @@ glyph_set_clock(glyph_t self, int level_count);
     } while (0)
 #endif /* DEBUG_GLYPH */
 
+/* Takes the glyph out of its lane's backlog once it's shown,
+ * expired or dequeued */
+static void
+glyph_leave_backlog(glyph_t self)
+{
+    if (self->backlog_width != 0) {
+        self->lane->backlog_width -= self->backlog_width;
+        self->backlog_width = 0;
+    }
+}
+
 /* Allocates and initializes a new glyph holder for the given message */
 static glyph_t
 glyph_alloc(ScrollerWidget widget, message_t message)
@@ -271,7 +405,14 @@ glyph_alloc(ScrollerWidget widget, message_t message)
     glyph_t self;
 
     /* Allocate memory for a new glyph */
-    self = malloc(sizeof(struct glyph));
+    if (glyph_slab == NULL) {
+        glyph_slab = slab_alloc("glyph", sizeof(struct glyph), 0);
+        if (glyph_slab == NULL) {
+            return NULL;
+        }
+    }
+
+    self = slab_get(glyph_slab);
     if (self == NULL) {
         return NULL;
     }
@@ -296,6 +437,8 @@ glyph_alloc(ScrollerWidget widget, message_t message)
         return NULL;
     }
 
+    self->message_count = 1;
+
     /* Figure out how big the glyph should be */
     message_view_get_sizes(self->message_view, False, &self->sizes);
 
@@ -304,7 +447,6 @@ glyph_alloc(ScrollerWidget widget, message_t message)
     self->sizes.width += widget->scroller.font->ascent;
 
     /* Start the clock */
-    self->timeout = None;
     glyph_set_clock(self, widget->scroller.fade_levels);
 
     return self;
@@ -336,25 +478,134 @@ glyph_free(glyph_t self)
         message_view_free(self->message_view);
     }
 
-    /* Cancel any pending timeout */
-    if (self->timeout != None) {
-        XtRemoveTimeOut(self->timeout);
+    /* Release a summary's message */
+    if (self->summary_of != NULL) {
+        MESSAGE_FREE_REF(self->summary_of, ref_summary, self);
+    }
+
+    /* Take it out of the fade wheel */
+    wheel_remove(self);
+
+    /* Release its pixmap */
+    if (self->pixmap != None) {
+        XFreePixmap(XtDisplay((Widget)self->widget), self->pixmap);
     }
 
     /* Free the glyph itself */
     DPRINTF((1, "freeing glyph %p with message %p\n", self, message));
-    free(self);
+    slab_put(glyph_slab, self);
+}
+
+/* Returns the time in seconds since some fixed point, preferring a
+ * clock which doesn't jump when the time of day is changed */
+static double
+get_time(void)
+{
+    struct timeval now;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+        return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+    }
+#endif /* HAVE_CLOCK_GETTIME && CLOCK_MONOTONIC */
+
+    if (gettimeofday(&now, NULL) < 0) {
+        perror("gettimeofday failed");
+        exit(1);
+    }
+
+    return (double)now.tv_sec + (double)now.tv_usec / 1000000.0;
+}
+
+/* Returns the current time in fade wheel ticks */
+static unsigned long
+wheel_time(ScrollerWidget self)
+{
+    double elapsed = get_time() - self->scroller.fade_epoch;
+
+    /* Never go back before the epoch, even if get_time() had to fall
+     * back on a clock which can */
+    if (elapsed < 0.0) {
+        return 0;
+    }
+
+    return (unsigned long)(elapsed * 1000.0) / WHEEL_TICK;
 }
 
-/* This is called each time the glyph should fade */
+/* Links a glyph into a fade wheel list */
 static void
-glyph_tick(XtPointer closure, XtIntervalId *id)
+wheel_link(glyph_t *list, glyph_t glyph)
 {
-    glyph_t self = (glyph_t)closure;
-    int level_count = self->widget->scroller.fade_levels;
+    glyph->wheel_list = list;
+    glyph->wheel_previous = NULL;
+    glyph->wheel_next = *list;
+    if (*list != NULL) {
+        (*list)->wheel_previous = glyph;
+    }
 
-    /* We don't have a timeout */
-    self->timeout = None;
+    *list = glyph;
+}
+
+/* Files a glyph in the fade wheel according to its fade_time */
+static void
+wheel_insert(ScrollerWidget self, glyph_t glyph)
+{
+    unsigned long delta;
+    int level;
+
+    /* Don't schedule anything in the wheel's past or beyond its reach */
+    if (glyph->fade_time < self->scroller.fade_now) {
+        glyph->fade_time = self->scroller.fade_now;
+    } else if (WHEEL_SPAN <= glyph->fade_time - self->scroller.fade_now) {
+        glyph->fade_time = self->scroller.fade_now + WHEEL_SPAN - 1;
+    }
+
+    /* Find the first level which covers the glyph's fade time */
+    delta = glyph->fade_time - self->scroller.fade_now;
+    for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+        if (delta < 1UL << (WHEEL_BITS * (level + 1))) {
+            break;
+        }
+    }
+
+    wheel_link(&self->scroller.fade_wheel[
+                   level * WHEEL_SLOTS +
+                   ((glyph->fade_time >> (WHEEL_BITS * level)) & WHEEL_MASK)],
+               glyph);
+}
+
+/* Removes a glyph from the fade wheel */
+static void
+wheel_remove(glyph_t glyph)
+{
+    /* Don't bother if it isn't there */
+    if (glyph->wheel_list == NULL) {
+        return;
+    }
+
+    if (glyph->wheel_previous != NULL) {
+        glyph->wheel_previous->wheel_next = glyph->wheel_next;
+    } else {
+        *glyph->wheel_list = glyph->wheel_next;
+    }
+
+    if (glyph->wheel_next != NULL) {
+        glyph->wheel_next->wheel_previous = glyph->wheel_previous;
+    }
+
+    glyph->wheel_list = NULL;
+    glyph->wheel_previous = NULL;
+    glyph->wheel_next = NULL;
+    glyph->widget->scroller.fade_count--;
+}
+
+/* This is called each time the glyph should fade.  Answers True if the
+ * glyph needs to be repainted. */
+static Bool
+glyph_tick(glyph_t self)
+{
+    int level_count = self->widget->scroller.fade_levels;
 
     /* Have we faded through all of the levels yet? */
     if (self->fade_level + 1 >= level_count) {
@@ -362,28 +613,28 @@ glyph_tick(XtPointer closure, XtIntervalId *id)
         if (!self->is_expired) {
             /* FIX THIS: we can do this ourselves */
             self->is_expired = True;
+            glyph_leave_backlog(self);
             ScGlyphExpired(self->widget, self);
         }
 
-        return;
+        return False;
     }
 
     /* Go to the next level */
     self->fade_level++;
     glyph_set_clock(self, level_count);
-
-    /* Redraw this glyph */
-    ScRepaintGlyph(self->widget, self);
+    return True;
 }
 
 /* Set the clock for the next time we need to fade this widget */
 static void
 glyph_set_clock(glyph_t self, int level_count)
 {
-    int duration;
+    ScrollerWidget widget = self->widget;
+    unsigned long duration;
 
     /* Sanity check */
-    ASSERT(self->timeout == None);
+    ASSERT(self->wheel_list == NULL);
 
     /* Has the glyph expired? */
     if (self->is_expired) {
@@ -395,9 +646,14 @@ glyph_set_clock(glyph_t self, int level_count)
         duration = 1000 * message_get_timeout(message) / level_count;
     }
 
-    self->timeout = XtAppAddTimeOut(
-        XtWidgetToApplicationContext((Widget)self->widget),
-        duration, glyph_tick, self);
+    /* Put the glyph into the fade wheel */
+    self->fade_time = wheel_time(widget) +
+        (duration + WHEEL_TICK - 1) / WHEEL_TICK;
+    wheel_insert(widget, self);
+    widget->scroller.fade_count++;
+
+    /* Make sure the wheel will turn */
+    fade_set_clock(widget);
 }
 
 /* Returns the glyph's message */
@@ -427,6 +683,65 @@ glyph_is_killed(glyph_t self)
     return message_is_killed(message);
 }
 
+/* Returns the total width of the glyph */
+static long
+glyph_get_width(glyph_t self)
+{
+    /* Sanity check */
+    ASSERT(self->message_view != NULL);
+    return MAX(self->sizes.rbearing, self->sizes.width) -
+           MIN(self->sizes.lbearing, 0);
+}
+
+/* Makes sure the glyph's pixmap holds it at its current fade level.
+ * Answers False if the glyph is empty or too wide to cache. */
+static Bool
+glyph_render(Display *display, glyph_t self)
+{
+    ScrollerWidget widget = self->widget;
+    unsigned int width = glyph_get_width(self);
+    XRectangle bbox;
+
+    /* Is the pixmap already up to date? */
+    if (self->pixmap != None) {
+        if (self->pixmap_level == self->fade_level) {
+            return True;
+        }
+    } else {
+        /* Don't bother with empty glyphs or ones too wide to cache */
+        if (width == 0 || MAX_GLYPH_PIXMAP_WIDTH < width) {
+            return False;
+        }
+
+        self->pixmap = XCreatePixmap(display, XtWindow((Widget)widget),
+                                     width, widget->scroller.line_height,
+                                     widget->core.depth);
+    }
+
+    /* Clear it to the background color */
+    XFillRectangle(display, self->pixmap, widget->scroller.backgroundGC,
+                   0, 0, width, widget->scroller.line_height);
+
+    /* And draw the glyph into it */
+    bbox.x = 0;
+    bbox.y = 0;
+    bbox.width = width;
+    bbox.height = widget->scroller.line_height;
+    message_view_paint(
+        self->message_view,
+        display, self->pixmap, widget->scroller.glyph_gc,
+        False, 0,
+        widget->scroller.group_pixels[self->fade_level],
+        widget->scroller.user_pixels[self->fade_level],
+        widget->scroller.string_pixels[self->fade_level],
+        widget->scroller.separator_pixels[self->fade_level],
+        0 - MIN(self->sizes.lbearing, 0), widget->scroller.font->ascent,
+        &bbox);
+
+    self->pixmap_level = self->fade_level;
+    return True;
+}
+
 /* Draw the glyph */
 static void
 glyph_paint(Display *display,
@@ -442,6 +757,45 @@ glyph_paint(Display *display,
         return;
     }
 
+    /* Render straight into the shared image if we have one */
+    if (self->widget->scroller.image != NULL) {
+        image_sync(self->widget);
+        message_view_render(
+            self->message_view,
+            display, XtWindow((Widget)self->widget),
+            self->widget->scroller.image,
+            self->widget->scroller.group_pixels[self->fade_level],
+            self->widget->scroller.user_pixels[self->fade_level],
+            self->widget->scroller.string_pixels[self->fade_level],
+            self->widget->scroller.separator_pixels[self->fade_level],
+            x - MIN(self->sizes.lbearing, 0), y,
+            bbox);
+        return;
+    }
+
+    /* Copy the glyph from its pixmap if we can */
+    if (self->widget->scroller.use_glyph_pixmaps &&
+        glyph_get_width(self) <= MAX_GLYPH_PIXMAP_WIDTH) {
+        int left = MAX(x, bbox->x);
+        int right = MIN(x + (int)glyph_get_width(self),
+                        bbox->x + bbox->width);
+
+        /* Only copy the part within the bounding box */
+        if (right <= left) {
+            return;
+        }
+
+        if (glyph_render(display, self)) {
+            XCopyArea(display, self->pixmap, drawable,
+                      self->widget->scroller.glyph_gc,
+                      left - x, 0, right - left,
+                      self->widget->scroller.line_height,
+                      left, y - self->widget->scroller.font->ascent);
+        }
+
+        return;
+    }
+
     /* Delegate to the message_view */
     message_view_paint(
         self->message_view,
@@ -455,16 +809,6 @@ glyph_paint(Display *display,
         bbox);
 }
 
-/* Returns the total width of the glyph */
-static long
-glyph_get_width(glyph_t self)
-{
-    /* Sanity check */
-    ASSERT(self->message_view != NULL);
-    return MAX(self->sizes.rbearing, self->sizes.width) -
-           MIN(self->sizes.lbearing, 0);
-}
-
 /* Returns the glyph which supersedes this one */
 static glyph_t
 glyph_get_successor(glyph_t self)
@@ -524,6 +868,7 @@ glyph_delete(glyph_t self)
     /* Mark the glyph as expired so that it won't get considered as a
      * replacement for glyph. */
     self->is_expired = True;
+    glyph_leave_backlog(self);
 }
 
 /* Expires the glyph */
@@ -537,18 +882,67 @@ glyph_expire(glyph_t self, ScrollerWidget widget)
 
     /* Otherwise get gone */
     self->is_expired = True;
+    glyph_leave_backlog(self);
     ScRepaintGlyph(widget, self);
 
     /* Restart the timer so that we can quickly fade */
-    if (self->timeout != None) {
-        XtRemoveTimeOut(self->timeout);
-        self->timeout = None;
-    }
-
+    wheel_remove(self);
     glyph_set_clock(self, widget->scroller.fade_levels);
     ScGlyphExpired(widget, self);
 }
 
+/* Returns the glyph's tag, or NULL if it has none */
+static const char *
+glyph_get_tag(glyph_t self)
+{
+    message_t message = glyph_get_message(self);
+    return message == NULL ? NULL : message_get_tag(message);
+}
+
+/* Adds a queued glyph to the tag table */
+static void
+glyph_tags_add(glyph_t glyph)
+{
+    ScrollerWidget self = glyph->widget;
+    const char *tag = glyph_get_tag(glyph);
+    unsigned int bucket;
+
+    /* Only glyphs with tags can be replaced */
+    if (tag == NULL) {
+        return;
+    }
+
+    bucket = string_hash(tag) % self->scroller.tags_size;
+    glyph->tag_next = self->scroller.glyph_tags[bucket];
+    self->scroller.glyph_tags[bucket] = glyph;
+    self->scroller.tags_count++;
+}
+
+/* Removes a dequeued glyph from the tag table */
+static void
+glyph_tags_remove(glyph_t glyph)
+{
+    ScrollerWidget self = glyph->widget;
+    const char *tag = glyph_get_tag(glyph);
+    glyph_t *probe;
+
+    if (tag == NULL) {
+        return;
+    }
+
+    /* Unlink it from its bucket */
+    probe = &self->scroller.glyph_tags[string_hash(tag) %
+                                       self->scroller.tags_size];
+    while (*probe != glyph) {
+        ASSERT(*probe != NULL);
+        probe = &(*probe)->tag_next;
+    }
+
+    *probe = glyph->tag_next;
+    glyph->tag_next = NULL;
+    self->scroller.tags_count--;
+}
+
 /* Returns true if the queue contains no unexpired messages */
 static int
 queue_is_empty(glyph_t head)
@@ -570,6 +964,9 @@ queue_is_empty(glyph_t head)
 static void
 queue_add(glyph_t tail, glyph_t glyph)
 {
+    ScrollerWidget self = glyph->widget;
+
+    glyph->lane = tail->lane;
     glyph->previous = tail;
     glyph->next = tail->next;
 
@@ -577,35 +974,37 @@ queue_add(glyph_t tail, glyph_t glyph)
     tail->next = glyph;
 
     GLYPH_ALLOC_REF(glyph, ref_queue, NULL);
+
+    /* It's waiting to be shown */
+    if (!glyph->is_expired && glyph->visible_count == 0) {
+        glyph->backlog_width = glyph_get_width(glyph);
+        glyph->lane->backlog_width += glyph->backlog_width;
+    }
+
+    /* Index it by tag, making room if the table is getting crowded */
+    glyph_tags_add(glyph);
+    if (self->scroller.tags_size < self->scroller.tags_count) {
+        tags_grow(self);
+    }
 }
 
 /* Locates the item in the queue with the given tag */
 static glyph_t
-queue_find(glyph_t head, const char *tag)
+queue_find(ScrollerWidget self, const char *tag)
 {
     glyph_t probe;
+    const char *probe_tag;
 
     /* Bail out now if there is no tag */
     if (tag == NULL) {
         return NULL;
     }
 
-    /* Look for the tag in the queue */
-    for (probe = head->next; probe != head; probe = probe->next) {
-        message_t message;
-        const char *probe_tag;
-
-        /* Check for a match */
-        message = glyph_get_message(probe);
-        if (message == NULL) {
-            continue;
-        }
-
-        probe_tag = message_get_tag(message);
-        if (probe_tag == NULL) {
-            continue;
-        }
-
+    /* Look for the tag in the tag table */
+    probe = self->scroller.glyph_tags[string_hash(tag) %
+                                      self->scroller.tags_size];
+    for (; probe != NULL; probe = probe->tag_next) {
+        probe_tag = glyph_get_tag(probe);
         if (strcmp(tag, probe_tag) == 0) {
             return probe;
         }
@@ -619,7 +1018,12 @@ queue_find(glyph_t head, const char *tag)
 static void
 queue_replace(glyph_t old_glyph, glyph_t new_glyph)
 {
+    /* Swap the tag table entries */
+    glyph_tags_remove(old_glyph);
+    glyph_tags_add(new_glyph);
+
     /* Swap the message into place */
+    new_glyph->lane = old_glyph->lane;
     new_glyph->previous = old_glyph->previous;
     old_glyph->previous->next = new_glyph;
     old_glyph->previous = NULL;
@@ -628,6 +1032,11 @@ queue_replace(glyph_t old_glyph, glyph_t new_glyph)
     old_glyph->next->previous = new_glyph;
     old_glyph->next = NULL;
 
+    /* The new glyph takes the old one's place in the backlog */
+    glyph_leave_backlog(old_glyph);
+    new_glyph->backlog_width = glyph_get_width(new_glyph);
+    new_glyph->lane->backlog_width += new_glyph->backlog_width;
+
     /* The queue now has a reference to the new glyph and no longer
      * has one to the old one. */
     GLYPH_ALLOC_REF(new_glyph, ref_queue, NULL);
@@ -644,9 +1053,11 @@ queue_remove(glyph_t glyph)
         return;
     }
 
-    /* Remove it from the list */
+    /* Remove it from the list and the tag table */
     glyph->previous->next = glyph->next;
     glyph->next->previous = glyph->previous;
+    glyph_tags_remove(glyph);
+    glyph_leave_backlog(glyph);
 
     glyph->previous = NULL;
     glyph->next = NULL;
@@ -655,6 +1066,244 @@ queue_remove(glyph_t glyph)
     GLYPH_FREE_REF(glyph, ref_queue, NULL);
 }
 
+/* Answers True if the glyph is waiting in the queue to be shown for
+ * the first time and may be collapsed into a summary.  Tagged glyphs
+ * are left alone since their replacements already keep them in
+ * check. */
+static Bool
+glyph_is_collapsible(glyph_t self)
+{
+    return self->backlog_width != 0 && glyph_get_tag(self) == NULL;
+}
+
+/* The number of buckets in the table of groups built by
+ * queue_overflow() */
+#define OVERFLOW_BUCKETS 61
+
+/* A group's share of a lane's backlog */
+struct group_backlog {
+    /* The group's (interned) name */
+    const char *group;
+
+    /* The next group in the same bucket */
+    struct group_backlog *next;
+
+    /* The group's earliest waiting glyph */
+    glyph_t first;
+
+    /* The group's newest waiting message */
+    message_t latest;
+
+    /* The number of messages the group's waiting glyphs stand for */
+    unsigned long count;
+
+    /* The number of waiting glyphs */
+    unsigned int glyph_count;
+
+    /* Their share of the lane's backlog_width */
+    long width;
+
+    /* The summary replacing them, or NULL if they're staying */
+    glyph_t summary;
+};
+
+/* Finds a group in the table, adding it if add is set */
+static struct group_backlog *
+group_backlog_find(struct group_backlog **buckets,
+                   struct group_backlog *groups,
+                   unsigned int *group_count,
+                   const char *group,
+                   Bool add)
+{
+    struct group_backlog **bucket;
+    struct group_backlog *probe;
+
+    /* Groups are interned, so their pointers will do */
+    bucket = &buckets[((unsigned long)group >> 3) % OVERFLOW_BUCKETS];
+    for (probe = *bucket; probe != NULL; probe = probe->next) {
+        if (probe->group == group) {
+            return probe;
+        }
+    }
+
+    if (!add) {
+        return NULL;
+    }
+
+    probe = &groups[(*group_count)++];
+    memset(probe, 0, sizeof(struct group_backlog));
+    probe->group = group;
+    probe->next = *bucket;
+    *bucket = probe;
+    return probe;
+}
+
+/* Creates the summary glyph for a group's backlog */
+static glyph_t
+group_backlog_summarize(ScrollerWidget self, struct group_backlog *entry)
+{
+    message_t message;
+    glyph_t summary;
+    char *buffer;
+    size_t length;
+
+    /* Construct a message for the summary */
+    length = strlen(entry->group) + 32;
+    buffer = malloc(length);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    snprintf(buffer, length, "+%lu from %s", entry->count, entry->group);
+    message = message_alloc(NULL, entry->group, "tickertape", buffer,
+                            message_get_timeout(entry->latest), NULL, 0,
+                            NULL, NULL, NULL, NULL);
+    free(buffer);
+    if (message == NULL) {
+        return NULL;
+    }
+
+    /* And a glyph to display it */
+    MESSAGE_ALLOC_REF(message, ref_summary, self);
+    summary = glyph_alloc(self, message);
+    MESSAGE_FREE_REF(message, ref_summary, self);
+    if (summary == NULL) {
+        return NULL;
+    }
+
+    /* Remember the newest message so that it can be found in the
+     * history */
+    summary->message_count = entry->count;
+    summary->summary_of = entry->latest;
+    MESSAGE_ALLOC_REF(entry->latest, ref_summary, summary);
+    return summary;
+}
+
+/* Collapses the waiting glyphs of the groups with the newest messages
+ * in a lane into one summary glyph per group until the lane's backlog
+ * fits within overflowFactor widget widths.  Each summary goes where
+ * its group's earliest waiting glyph was. */
+static void
+queue_overflow(ScrollerWidget self, scroller_lane_t lane)
+{
+    long limit = (long)self->scroller.overflow_factor * self->core.width;
+    struct group_backlog *buckets[OVERFLOW_BUCKETS];
+    struct group_backlog *groups;
+    struct group_backlog *entry;
+    unsigned int group_count = 0;
+    unsigned int glyph_count = 0;
+    unsigned int i;
+    glyph_t gap = lane->gap;
+    glyph_t glyph, previous;
+    long width;
+
+    if (lane->backlog_width <= limit) {
+        return;
+    }
+
+    /* There can't be more groups than waiting glyphs */
+    for (glyph = gap->next; glyph != gap; glyph = glyph->next) {
+        glyph_count++;
+    }
+
+    groups = malloc(glyph_count * sizeof(struct group_backlog));
+    if (groups == NULL) {
+        return;
+    }
+
+    memset(buckets, 0, sizeof(buckets));
+
+    /* Gather each group's waiting glyphs from the newest back, so
+     * that the groups end up in order of their newest message */
+    for (glyph = gap->previous; glyph != gap; glyph = glyph->previous) {
+        if (!glyph_is_collapsible(glyph)) {
+            continue;
+        }
+
+        entry = group_backlog_find(
+            buckets, groups, &group_count,
+            message_get_group(glyph_get_message(glyph)), True);
+        if (entry->latest == NULL) {
+            entry->latest = glyph->summary_of != NULL ?
+                glyph->summary_of : glyph_get_message(glyph);
+        }
+
+        entry->first = glyph;
+        entry->count += glyph->message_count;
+        entry->glyph_count++;
+        entry->width += glyph->backlog_width;
+    }
+
+    /* Summarize groups until enough width has been saved */
+    width = lane->backlog_width;
+    for (i = 0; i < group_count && limit < width; i++) {
+        entry = &groups[i];
+
+        /* Don't bother unless there's more than one glyph */
+        if (entry->glyph_count < 2) {
+            continue;
+        }
+
+        entry->summary = group_backlog_summarize(self, entry);
+        if (entry->summary == NULL) {
+            continue;
+        }
+
+        /* Put it in the queue ahead of the group's glyphs */
+        queue_add(entry->first->previous, entry->summary);
+        width += entry->summary->backlog_width - entry->width;
+    }
+
+    /* Discard the glyphs which have been summarized */
+    for (glyph = gap->previous; glyph != gap; glyph = previous) {
+        previous = glyph->previous;
+        if (!glyph_is_collapsible(glyph)) {
+            continue;
+        }
+
+        entry = group_backlog_find(
+            buckets, groups, &group_count,
+            message_get_group(glyph_get_message(glyph)), False);
+        if (entry != NULL && entry->summary != NULL &&
+            entry->summary != glyph) {
+            queue_remove(glyph);
+        }
+    }
+
+    DPRINTF((1, "backlog collapsed to %ld pixels\n", lane->backlog_width));
+    free(groups);
+}
+
+/* Chooses the lane for a new message: the lane for its group if
+ * groupLanes is set, otherwise the one with the least waiting to be
+ * shown */
+static scroller_lane_t
+choose_lane(ScrollerWidget self, message_t message)
+{
+    scroller_lane_t lane = self->scroller.lanes;
+    scroller_lane_t best = lane;
+
+    /* Don't bother measuring if there's only one lane */
+    if (self->scroller.lane_count == 1) {
+        return best;
+    }
+
+    /* Keep each group to its own lane if asked */
+    if (self->scroller.group_lanes) {
+        return &self->scroller.lanes[string_hash(message_get_group(message)) %
+                                     self->scroller.lane_count];
+    }
+
+    for (lane++; lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        if (lane->backlog_width < best->backlog_width) {
+            best = lane;
+        }
+    }
+
+    return best;
+}
+
 /* The glyph_holders are used to maintain a doubly-linked list of the
  * glyphs which are currently visible in the scroller window.  The
  * width is also recorded because under certain circumstances a single
@@ -672,16 +1321,131 @@ struct glyph_holder {
 
     /* This holder's glyph */
     glyph_t glyph;
+
+    /* The next glyph_holder in the same holder_tags bucket */
+    glyph_holder_t tag_next;
 };
 
-/* Allocates and initializes a new glyph_holder */
+/* The slab from which glyph_holders are allocated */
+static slab_t glyph_holder_slab;
+
+/* Adds a glyph_holder to the tag table.  Holders only ever join a
+ * lane at one of its ends, so adding those on the right to the end of
+ * their bucket and those on the left to the front keeps each lane's
+ * holders in left-to-right order within the bucket. */
+static void
+holder_tags_add(glyph_holder_t holder, Bool at_right)
+{
+    ScrollerWidget self = holder->glyph->widget;
+    const char *tag = glyph_get_tag(holder->glyph);
+    glyph_holder_t *probe;
+
+    if (tag == NULL) {
+        return;
+    }
+
+    probe = &self->scroller.holder_tags[string_hash(tag) %
+                                        self->scroller.tags_size];
+    if (at_right) {
+        while (*probe != NULL) {
+            probe = &(*probe)->tag_next;
+        }
+    }
+
+    holder->tag_next = *probe;
+    *probe = holder;
+}
+
+/* Removes a glyph_holder from the tag table */
+static void
+holder_tags_remove(glyph_holder_t holder)
+{
+    ScrollerWidget self = holder->glyph->widget;
+    const char *tag = glyph_get_tag(holder->glyph);
+    glyph_holder_t *probe;
+
+    if (tag == NULL) {
+        return;
+    }
+
+    /* Unlink it from its bucket */
+    probe = &self->scroller.holder_tags[string_hash(tag) %
+                                        self->scroller.tags_size];
+    while (*probe != holder) {
+        ASSERT(*probe != NULL);
+        probe = &(*probe)->tag_next;
+    }
+
+    *probe = holder->tag_next;
+    holder->tag_next = NULL;
+}
+
+/* Allocates the tag tables */
+static void
+tags_alloc(ScrollerWidget self, unsigned int size)
+{
+    self->scroller.tags_size = size;
+    self->scroller.tags_count = 0;
+    self->scroller.glyph_tags = calloc(size, sizeof(glyph_t));
+    self->scroller.holder_tags = calloc(size, sizeof(glyph_holder_t));
+    if (self->scroller.glyph_tags == NULL ||
+        self->scroller.holder_tags == NULL) {
+        perror("calloc() failed");
+        exit(1);
+    }
+}
+
+/* Doubles the size of the tag tables and reindexes the queued glyphs
+ * and visible holders */
+static void
+tags_grow(ScrollerWidget self)
+{
+    scroller_lane_t lane;
+    glyph_t glyph;
+    glyph_holder_t holder;
+
+    DPRINTF((1, "growing tag tables to %u buckets\n",
+             self->scroller.tags_size * 2));
+
+    /* Replace the tables */
+    free(self->scroller.glyph_tags);
+    free(self->scroller.holder_tags);
+    tags_alloc(self, self->scroller.tags_size * 2);
+
+    /* Reindex everything */
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        for (glyph = lane->gap->next; glyph != lane->gap;
+             glyph = glyph->next) {
+            glyph_tags_add(glyph);
+        }
+
+        for (holder = lane->left_holder;
+             holder != NULL;
+             holder = holder->next) {
+            holder_tags_add(holder, True);
+        }
+    }
+}
+
+/* Allocates and initializes a new glyph_holder which is about to be
+ * added to the right (or left) end of its lane */
 static glyph_holder_t
-glyph_holder_alloc(glyph_t glyph, int width)
+glyph_holder_alloc(glyph_t glyph, int width, Bool at_right)
 {
     glyph_holder_t self;
 
     /* Allocate memory for the receiver */
-    self = malloc(sizeof(struct glyph_holder));
+    if (glyph_holder_slab == NULL) {
+        glyph_holder_slab = slab_alloc("glyph_holder",
+                                       sizeof(struct glyph_holder), 0);
+        if (glyph_holder_slab == NULL) {
+            return NULL;
+        }
+    }
+
+    self = slab_get(glyph_holder_slab);
     if (self == NULL) {
         return NULL;
     }
@@ -690,11 +1454,16 @@ glyph_holder_alloc(glyph_t glyph, int width)
     self->previous = NULL;
     self->next = NULL;
     self->width = width;
+    self->tag_next = NULL;
 
     /* Record the glyph and tell it that it's visible */
     self->glyph = glyph;
     GLYPH_ALLOC_REF(glyph, ref_holder, self);
     glyph->visible_count++;
+    glyph_leave_backlog(glyph);
+
+    /* Index it by tag */
+    holder_tags_add(self, at_right);
     return self;
 }
 
@@ -704,6 +1473,9 @@ glyph_holder_free(glyph_holder_t self)
 {
     glyph_t glyph = self->glyph;
 
+    /* Remove it from the tag table */
+    holder_tags_remove(self);
+
     /* Dequeue the glyph if it's expired and invisible */
     if (--glyph->visible_count == 0 && glyph->is_expired) {
         queue_remove(glyph);
@@ -711,15 +1483,14 @@ glyph_holder_free(glyph_holder_t self)
 
     /* Lose our reference to the glyph */
     GLYPH_FREE_REF(glyph, ref_holder, self);
-    free(self);
+    slab_put(glyph_holder_slab, self);
 }
 
 /* Returns the glyph holder's tag, or NULL if it has none. */
 static const char *
 glyph_holder_get_tag(glyph_holder_t self)
 {
-    message_t message = glyph_get_message(self->glyph);
-    return message == NULL ? NULL : message_get_tag(message);
+    return glyph_get_tag(self->glyph);
 }
 
 /* Paints the holder's glyph */
@@ -756,6 +1527,10 @@ static void
 set_clock(ScrollerWidget self);
 static void
 tick(XtPointer widget, XtIntervalId *interval);
+static void
+wheel_turn(ScrollerWidget self);
+static void
+fade_tick(XtPointer widget, XtIntervalId *interval);
 
 
 /* Answers a GC with the right background color and font */
@@ -772,6 +1547,14 @@ create_gc(ScrollerWidget self)
             self), GCFont | GCBackground | GCForeground, &values);
     self->scroller.gc = XCreateGC(
         XtDisplay(self), XtWindow(self), GCFont | GCBackground, &values);
+
+    /* Glyphs are copied from pixmaps, which never need exposing */
+    if (self->scroller.use_glyph_pixmaps) {
+        values.graphics_exposures = False;
+        self->scroller.glyph_gc = XCreateGC(
+            XtDisplay(self), XtWindow(self),
+            GCFont | GCBackground | GCGraphicsExposures, &values);
+    }
 }
 
 /* Answers an array of colors fading from first to last */
@@ -809,6 +1592,12 @@ enable_clock(ScrollerWidget self)
 {
     if (self->scroller.timer == 0 && self->scroller.step != 0) {
         DPRINTF((1, "clock enabled\n"));
+
+        /* Start counting from now so that we don't try to make up
+         * for the time we spent stopped */
+        self->scroller.last_tick = get_time();
+        self->scroller.next_tick = self->scroller.last_tick;
+        self->scroller.step_remainder = 0.0;
         set_clock(self);
     }
 }
@@ -822,44 +1611,293 @@ disable_clock(ScrollerWidget self)
         XtRemoveTimeOut(self->scroller.timer);
         self->scroller.timer = None;
     }
+
+    /* Keep the glyphs fading while we're not scrolling */
+    fade_set_clock(self);
 }
 
-/* Sets the timer if the clock isn't stopped */
+/* Sets the timer if the clock isn't stopped.  Ticks are due every
+ * 1/frequency seconds; any which we've missed are skipped rather
+ * than run late, since each tick scrolls according to the time which
+ * has actually passed. */
 static void
 set_clock(ScrollerWidget self)
 {
+    double period = 1.0 / self->scroller.frequency;
+    double now;
+    long missed;
+
     if (self->scroller.timer == None) {
+        now = get_time();
+
+        /* Find the next tick which is still in the future */
+        self->scroller.next_tick += period;
+        if (self->scroller.next_tick < now) {
+            missed = (long)((now - self->scroller.next_tick) / period) + 1;
+            self->scroller.next_tick += missed * period;
+        }
+
         self->scroller.timer = XtAppAddTimeOut(
             XtWidgetToApplicationContext((Widget)self),
-            1000L / self->scroller.frequency,
+            (unsigned long)((self->scroller.next_tick - now) * 1000.0 + 0.5),
             tick, self);
     }
 }
 
+/* Records the interval between two ticks in the histogram */
+static void
+record_frame_time(ScrollerWidget self, double elapsed)
+{
+    unsigned long bucket;
+
+    bucket = (unsigned long)(elapsed * 1000.0) / FRAME_TIME_WIDTH;
+    self->scroller.frame_times[MIN(bucket, FRAME_TIME_BUCKETS - 1)]++;
+}
+
 /* One interval has passed */
 static void
 tick(XtPointer widget, XtIntervalId *interval)
 {
     ScrollerWidget self = (ScrollerWidget)widget;
+    double now, elapsed, distance;
+    int pixels;
 
     /* Clear the timer so that set_clock() can set it again */
     ASSERT(*interval == self->scroller.timer);
     self->scroller.timer = 0;
 
+    /* Find out how long it's really been since the last tick */
+    now = get_time();
+    elapsed = now - self->scroller.last_tick;
+    self->scroller.last_tick = now;
+    record_frame_time(self, elapsed);
+
     /* Set the clock now so that we get consistent scrolling speed */
     set_clock(self);
 
-    /* Don't scroll if we're in the midst of a drag or if the scroller
-     * is stopped */
-    ASSERT(self->scroller.step != 0);
-    scroll(self, self->scroller.step);
+    /* Fade any glyphs whose time has come */
+    wheel_turn(self);
+
+    /* Don't scroll if we're in the midst of a drag or if the scroller
+     * is stopped */
+    ASSERT(self->scroller.step != 0);
+
+    /* Scroll as far as we should have gone in that time, carrying
+     * any fraction of a pixel over to the next tick.  Don't leap
+     * too far if we've been held up for ages. */
+    elapsed = MIN(elapsed, MAX_TICK_DELAY);
+    distance = self->scroller.step_remainder +
+        elapsed * self->scroller.step * self->scroller.frequency;
+    pixels = (int)distance;
+    self->scroller.step_remainder = distance - pixels;
+    if (pixels != 0) {
+        scroll(self, pixels);
+    }
+}
+
+/* Moves the glyphs in one of the fade wheel's lists to lower levels */
+static void
+wheel_cascade(ScrollerWidget self, int level, unsigned int index)
+{
+    glyph_t *list = &self->scroller.fade_wheel[level * WHEEL_SLOTS + index];
+    glyph_t glyph = *list;
+
+    *list = NULL;
+    while (glyph != NULL) {
+        glyph_t next = glyph->wheel_next;
+
+        wheel_insert(self, glyph);
+        glyph = next;
+    }
+}
+
+/* Repaints the visible glyphs which have faded */
+static void
+fade_repaint(ScrollerWidget self)
+{
+    Display *display = XtDisplay((Widget)self);
+    scroller_lane_t lane;
+    glyph_holder_t holder;
+    int offset;
+    Bool is_dirty = False;
+    XGCValues values;
+    XRectangle bbox;
+
+    /* Construct a clipping rectangle */
+    bbox.x = 0;
+    bbox.y = 0;
+    bbox.width = self->core.width;
+    bbox.height = self->core.height;
+
+    /* Go through the visible glyphs looking for ones to paint */
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        offset = 0 - lane->left_offset;
+        for (holder = lane->left_holder;
+             holder != NULL;
+             holder = holder->next) {
+            if (holder->glyph->is_faded) {
+                /* No clip mask for the scroller */
+                if (!is_dirty) {
+                    values.clip_mask = None;
+                    XChangeGC(display, self->scroller.gc, GCClipMask,
+                              &values);
+                    self->scroller.clip_width = 0;
+                    is_dirty = True;
+                }
+
+                glyph_holder_paint(
+                    display,
+                    self->scroller.use_pixmap ?
+                    self->scroller.pixmap : XtWindow((Widget)self),
+                    self->scroller.gc, holder, offset,
+                    lane->y + self->scroller.font->ascent, &bbox);
+            }
+
+            offset += holder->width;
+        }
+    }
+
+    /* Clear the marks now that each glyph has been painted everywhere
+     * it appears */
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        for (holder = lane->left_holder;
+             holder != NULL;
+             holder = holder->next) {
+            holder->glyph->is_faded = False;
+        }
+    }
+
+    /* Copy the pixmap to the window just once */
+    if (is_dirty && self->scroller.use_pixmap) {
+        redisplay(self, NULL);
+    }
+}
+
+/* Advances the fade wheel to the current time, fading each glyph
+ * whose time has come and then repainting the visible ones at once */
+static void
+wheel_turn(ScrollerWidget self)
+{
+    unsigned long now = wheel_time(self);
+    Bool is_faded = False;
+
+    /* If there's nothing in the wheel then just catch up */
+    if (self->scroller.fade_count == 0) {
+        if (self->scroller.fade_now <= now) {
+            self->scroller.fade_now = now + 1;
+        }
+
+        return;
+    }
+
+    /* Don't try to catch up all at once */
+    if (self->scroller.fade_now + MAX_WHEEL_STEPS <= now) {
+        now = self->scroller.fade_now + MAX_WHEEL_STEPS - 1;
+    }
+
+    while (self->scroller.fade_now <= now) {
+        unsigned long tick = self->scroller.fade_now;
+        unsigned int index = tick & WHEEL_MASK;
+        glyph_t *list;
+        int level;
+
+        /* Bring down glyphs from the higher levels as their turn comes */
+        for (level = 1; index == 0 && level < WHEEL_LEVELS; level++) {
+            index = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            wheel_cascade(self, level, index);
+        }
+
+        /* Move the glyphs due in this tick onto the pending list */
+        list = &self->scroller.fade_wheel[tick & WHEEL_MASK];
+        self->scroller.fade_pending = *list;
+        *list = NULL;
+        if (self->scroller.fade_pending != NULL) {
+            glyph_t glyph;
+
+            for (glyph = self->scroller.fade_pending;
+                 glyph != NULL;
+                 glyph = glyph->wheel_next) {
+                glyph->wheel_list = &self->scroller.fade_pending;
+            }
+        }
+
+        /* Advance the wheel before firing so that re-added glyphs land
+         * in the future */
+        self->scroller.fade_now++;
+
+        /* Fade the pending glyphs one at a time since handling one may
+         * free or remove others */
+        while (self->scroller.fade_pending != NULL) {
+            glyph_t glyph = self->scroller.fade_pending;
+
+            wheel_remove(glyph);
+            if (glyph_tick(glyph) && glyph->visible_count != 0) {
+                glyph->is_faded = True;
+                is_faded = True;
+            }
+        }
+    }
+
+    /* Repaint everything that faded in one go */
+    if (is_faded) {
+        fade_repaint(self);
+    }
+}
+
+/* Arms the fade timer if the wheel has glyphs in it but the scroll
+ * timer isn't around to turn it */
+static void
+fade_set_clock(ScrollerWidget self)
+{
+    unsigned long now, next;
+
+    if (self->scroller.fade_count == 0 ||
+        self->scroller.timer != None ||
+        self->scroller.fade_timer != None) {
+        return;
+    }
+
+    /* Wake up at the first occupied tick or at the next cascade */
+    now = wheel_time(self);
+    next = self->scroller.fade_now;
+    do {
+        if (self->scroller.fade_wheel[next & WHEEL_MASK] != NULL) {
+            break;
+        }
+
+        next++;
+    } while ((next & WHEEL_MASK) != 0);
+
+    self->scroller.fade_timer = XtAppAddTimeOut(
+        XtWidgetToApplicationContext((Widget)self),
+        next <= now ? 0 : (next - now) * WHEEL_TICK,
+        fade_tick, self);
+}
+
+/* The fade timer has gone off while we weren't scrolling */
+static void
+fade_tick(XtPointer widget, XtIntervalId *interval)
+{
+    ScrollerWidget self = (ScrollerWidget)widget;
+
+    /* Clear the timer so that fade_set_clock() can set it again */
+    ASSERT(*interval == self->scroller.fade_timer);
+    self->scroller.fade_timer = None;
+
+    /* Fade whatever is due and then wait for the next batch */
+    wheel_turn(self);
+    fade_set_clock(self);
 }
 
-/* Returns the tail of the queue */
+/* Returns the tail of a lane's queue */
 static glyph_t
-get_tail(ScrollerWidget self)
+get_tail(scroller_lane_t lane)
 {
-    glyph_t glyph = self->scroller.gap->previous;
+    glyph_t glyph = lane->gap->previous;
 
     /* Skip the left and right markers */
     while (glyph->is_expired) {
@@ -887,8 +1925,9 @@ void
 ScRepaintGlyph(ScrollerWidget self, glyph_t glyph)
 {
     Display *display = XtDisplay((Widget)self);
-    glyph_holder_t holder = self->scroller.left_holder;
-    int offset = 0 - self->scroller.left_offset;
+    scroller_lane_t lane = glyph->lane;
+    glyph_holder_t holder = lane->left_holder;
+    int offset = 0 - lane->left_offset;
     XGCValues values;
     XRectangle bbox;
 
@@ -909,12 +1948,14 @@ ScRepaintGlyph(ScrollerWidget self, glyph_t glyph)
             if (self->scroller.use_pixmap) {
                 glyph_holder_paint(
                     display, self->scroller.pixmap, self->scroller.gc,
-                    holder, offset, self->scroller.font->ascent, &bbox);
+                    holder, offset, lane->y + self->scroller.font->ascent,
+                    &bbox);
                 redisplay(self, NULL);
             } else {
                 glyph_holder_paint(
                     display, XtWindow((Widget)self), self->scroller.gc,
-                    holder, offset, self->scroller.font->ascent, &bbox);
+                    holder, offset, lane->y + self->scroller.font->ascent,
+                    &bbox);
             }
         }
 
@@ -973,7 +2014,9 @@ static void
 initialize(Widget request, Widget widget, ArgList args, Cardinal *num_args)
 {
     ScrollerWidget self = (ScrollerWidget)widget;
+    scroller_lane_t lane;
     glyph_holder_t holder;
+    int i;
 
     /* Try to allocate a conversion descriptor */
     self->scroller.renderer = utf8_renderer_alloc(XtDisplay(widget),
@@ -985,9 +2028,16 @@ initialize(Widget request, Widget widget, ArgList args, Cardinal *num_args)
         exit(1);
     }
 
+    /* Avoid pathological numbers of lanes */
+    if (self->scroller.lane_count < 1) {
+        self->scroller.lane_count = 1;
+    }
+
     /* Record the height and width for future reference */
-    self->scroller.height = self->scroller.font->ascent +
-                            self->scroller.font->descent;
+    self->scroller.line_height = self->scroller.font->ascent +
+                                 self->scroller.font->descent;
+    self->scroller.height =
+        self->scroller.line_height * self->scroller.lane_count;
 
     /* Set the default dimensions of the widget.  These will be
      * overridden later when the widget is realized. */
@@ -1002,29 +2052,70 @@ initialize(Widget request, Widget widget, ArgList args, Cardinal *num_args)
         self->core.height = self->scroller.height;
     }
 
-    /* Allocate a glyph to represent the gap */
-    self->scroller.gap = glyph_alloc(self, NULL);
-    GLYPH_ALLOC_REF(self->scroller.gap, ref_gap, self);
-    self->scroller.gap->next = self->scroller.gap;
-    self->scroller.gap->previous = self->scroller.gap;
+    /* Start with empty tag tables */
+    tags_alloc(self, TAGS_INITIAL_SIZE);
+
+    /* Start with an empty fade wheel */
+    self->scroller.fade_wheel =
+        calloc(WHEEL_LEVELS * WHEEL_SLOTS, sizeof(glyph_t));
+    if (self->scroller.fade_wheel == NULL) {
+        perror("calloc() failed");
+        exit(1);
+    }
+
+    self->scroller.fade_pending = NULL;
+    self->scroller.fade_epoch = get_time();
+    self->scroller.fade_now = 0;
+    self->scroller.fade_count = 0;
+    self->scroller.fade_timer = None;
+
+    /* Allocate the lanes */
+    self->scroller.lanes = calloc(self->scroller.lane_count,
+                                  sizeof(struct scroller_lane));
+    if (self->scroller.lanes == NULL) {
+        perror("calloc() failed");
+        exit(1);
+    }
 
-    /* Allocate a glyph holder to wrap the gap */
-    holder = glyph_holder_alloc(self->scroller.gap, self->core.width);
+    for (i = 0; i < self->scroller.lane_count; i++) {
+        lane = &self->scroller.lanes[i];
+
+        /* Allocate a glyph to represent the lane's gap */
+        lane->gap = glyph_alloc(self, NULL);
+        GLYPH_ALLOC_REF(lane->gap, ref_gap, self);
+        lane->gap->lane = lane;
+        lane->gap->next = lane->gap;
+        lane->gap->previous = lane->gap;
+
+        /* Allocate a glyph holder to wrap the gap */
+        holder = glyph_holder_alloc(lane->gap, self->core.width, True);
+
+        /* Initialize the queue to only contain the gap with 0 offsets */
+        lane->left_holder = holder;
+        lane->right_holder = holder;
+        lane->left_offset = 0;
+        lane->right_offset = 0;
+        lane->y = i * self->scroller.line_height;
+        lane->backlog_width = 0;
+    }
 
-    /* Initialize the queue to only contain the gap with 0 offsets */
     self->scroller.timer = 0;
+    self->scroller.last_tick = 0.0;
+    self->scroller.next_tick = 0.0;
+    self->scroller.step_remainder = 0.0;
+    memset(self->scroller.frame_times, 0,
+           sizeof(self->scroller.frame_times));
     self->scroller.is_stopped = True;
     self->scroller.is_visible = False;
     self->scroller.is_dragging = False;
-    self->scroller.left_holder = holder;
-    self->scroller.right_holder = holder;
-    self->scroller.left_offset = 0;
-    self->scroller.right_offset = 0;
     self->scroller.last_width = 0;
     self->scroller.start_drag_x = 0;
     self->scroller.last_x = 0;
     self->scroller.clip_width = 0;
-    self->scroller.request_id = 0;
+    self->scroller.image = NULL;
+    self->scroller.image_request = 0;
+    self->scroller.copy_first = 0;
+    self->scroller.copy_count = 0;
     self->scroller.local_delta = 0;
     self->scroller.target_delta = 0;
 
@@ -1056,7 +2147,23 @@ realize(Widget widget,
                    attributes);
     create_gc(self);
 
-    if (self->scroller.use_pixmap) {
+    /* Try to render into an image shared with the X server */
+    if (self->scroller.use_shared_memory) {
+        if (image_alloc(self)) {
+            self->scroller.pixmap = None;
+        } else {
+            fprintf(stderr, "%s: warning: unable to share memory with the "
+                    "X server; using a pixmap instead\n", progname);
+        }
+
+        /* Either way we paint offscreen and copy to the window */
+        self->scroller.use_pixmap = True;
+    }
+
+    if (self->scroller.image != NULL) {
+        /* Clear the image to the background color */
+        paint(self, 0, 0, self->core.width, self->core.height);
+    } else if (self->scroller.use_pixmap) {
         /* Create an offscreen pixmap */
         self->scroller.pixmap = XCreatePixmap(
             XtDisplay(self), XtWindow(self),
@@ -1087,36 +2194,36 @@ realize(Widget widget,
         display, colormap, &colors[3], &colors[0], self->scroller.fade_levels);
 }
 
-/* Add a glyph_holder to the left edge of the Scroller */
+/* Add a glyph_holder to the left edge of a lane */
 static void
-add_left_holder(ScrollerWidget self)
+add_left_holder(ScrollerWidget self, scroller_lane_t lane)
 {
     glyph_t glyph;
     glyph_holder_t holder;
     int width;
 
     /* Find the first unexpired glyph to the left of the scroller */
-    glyph = glyph_get_successor(self->scroller.left_holder->glyph)->previous;
+    glyph = glyph_get_successor(lane->left_holder->glyph)->previous;
     while (glyph->is_expired) {
         glyph = glyph->previous;
     }
 
     /* We need to do magic for the gap */
-    if (glyph == self->scroller.gap) {
-        glyph_holder_t left = self->scroller.left_holder;
-        glyph_t tail = get_tail(self);
+    if (glyph == lane->gap) {
+        glyph_holder_t left = lane->left_holder;
+        glyph_t tail = get_tail(lane);
 
         /* Determine the width of the tail glyph */
-        if (tail == self->scroller.gap) {
+        if (tail == lane->gap) {
             width = gap_width(self, left->width);
         } else {
             width = gap_width(self, glyph_get_width(tail));
         }
 
         /* If the next glyph is also the gap then just expand it */
-        if (left->glyph == self->scroller.gap) {
+        if (left->glyph == lane->gap) {
             left->width += width;
-            self->scroller.left_offset += width;
+            lane->left_offset += width;
             return;
         }
     } else {
@@ -1124,37 +2231,37 @@ add_left_holder(ScrollerWidget self)
     }
 
     /* Create a glyph holder and add it to the list */
-    holder = glyph_holder_alloc(glyph, width);
-    self->scroller.left_holder->previous = holder;
-    holder->next = self->scroller.left_holder;
-    self->scroller.left_holder = holder;
+    holder = glyph_holder_alloc(glyph, width, False);
+    lane->left_holder->previous = holder;
+    holder->next = lane->left_holder;
+    lane->left_holder = holder;
 
-    self->scroller.left_offset += width;
+    lane->left_offset += width;
 }
 
-/* Add a glyph_holder to the right edge */
+/* Add a glyph_holder to the right edge of a lane */
 static void
-add_right_holder(ScrollerWidget self)
+add_right_holder(ScrollerWidget self, scroller_lane_t lane)
 {
     glyph_t glyph;
     glyph_holder_t holder;
     int width;
 
     /* Find the first unexpired glyph to the right of the scroller */
-    glyph = glyph_get_successor(self->scroller.right_holder->glyph)->next;
+    glyph = glyph_get_successor(lane->right_holder->glyph)->next;
     while (glyph->is_expired) {
         glyph = glyph->next;
     }
 
     /* We need to do some magic for the gap */
-    if (glyph == self->scroller.gap) {
-        glyph_holder_t right = self->scroller.right_holder;
+    if (glyph == lane->gap) {
+        glyph_holder_t right = lane->right_holder;
         width = gap_width(self, right->width);
 
         /* If the previous glyph is also the gap then just expand it */
-        if (right->glyph == self->scroller.gap) {
+        if (right->glyph == lane->gap) {
             right->width += width;
-            self->scroller.right_offset += width;
+            lane->right_offset += width;
             return;
         }
     } else {
@@ -1162,41 +2269,42 @@ add_right_holder(ScrollerWidget self)
     }
 
     /* Create a glyph_holder and add it to the list */
-    holder = glyph_holder_alloc(glyph, width);
-    self->scroller.right_holder->next = holder;
-    holder->previous = self->scroller.right_holder;
-    self->scroller.right_holder = holder;
+    holder = glyph_holder_alloc(glyph, width, True);
+    lane->right_holder->next = holder;
+    holder->previous = lane->right_holder;
+    lane->right_holder = holder;
 
-    self->scroller.right_offset += width;
+    lane->right_offset += width;
 }
 
-/* Remove the glyph_holder at the left edge of the scroller */
+/* Remove the glyph_holder at the left edge of a lane */
 static void
-remove_left_holder(ScrollerWidget self)
+remove_left_holder(scroller_lane_t lane)
 {
-    glyph_holder_t holder = self->scroller.left_holder;
+    glyph_holder_t holder = lane->left_holder;
 
     /* Clean up the linked list */
-    self->scroller.left_holder = holder->next;
-    self->scroller.left_holder->previous = NULL;
-    self->scroller.left_offset -= holder->width;
+    lane->left_holder = holder->next;
+    lane->left_holder->previous = NULL;
+    lane->left_offset -= holder->width;
     glyph_holder_free(holder);
 }
 
-/* Remove the glyph_holder at the right edge of the scroller */
+/* Remove the glyph_holder at the right edge of a lane */
 static void
-remove_right_holder(ScrollerWidget self)
+remove_right_holder(scroller_lane_t lane)
 {
-    glyph_holder_t holder = self->scroller.right_holder;
+    glyph_holder_t holder = lane->right_holder;
 
     /* Clean up the linked list */
-    self->scroller.right_holder = holder->previous;
-    self->scroller.right_holder->next = NULL;
-    self->scroller.right_offset -= holder->width;
+    lane->right_holder = holder->previous;
+    lane->right_holder->next = NULL;
+    lane->right_offset -= holder->width;
     glyph_holder_free(holder);
 }
 
-/* Find a holder whose glyph has the given tag. */
+/* Find a holder whose glyph has the given tag, preferring the
+ * leftmost one in its lane. */
 static glyph_holder_t
 find_holder(ScrollerWidget self, const char *tag)
 {
@@ -1206,11 +2314,12 @@ find_holder(ScrollerWidget self, const char *tag)
     /* This should never be called with a NULL tag. */
     ASSERT(tag != NULL);
 
-    /* Walk the list of glyph holders looking for a match. */
-    probe = self->scroller.left_holder;
-    for (; probe != NULL; probe = probe->next) {
+    /* Look for a match in the tag table. */
+    probe = self->scroller.holder_tags[string_hash(tag) %
+                                       self->scroller.tags_size];
+    for (; probe != NULL; probe = probe->tag_next) {
         probe_tag = glyph_holder_get_tag(probe);
-        if (probe_tag != NULL && strcmp(probe_tag, tag) == 0) {
+        if (strcmp(probe_tag, tag) == 0) {
             return probe;
         }
     }
@@ -1218,10 +2327,38 @@ find_holder(ScrollerWidget self, const char *tag)
     return NULL;
 }
 
-/* Updates the state of the scroller after a shift of zero or more
- * pixels to the left. */
+/* Answers True if a lane shows nothing but its gap and has nothing
+ * waiting to be shown */
+static Bool
+lane_is_idle(scroller_lane_t lane)
+{
+    return lane->left_holder == lane->right_holder &&
+        lane->left_holder->glyph == lane->gap &&
+        queue_is_empty(lane->gap);
+}
+
+/* Stops the clock if every lane is idle */
+static void
+check_stopped(ScrollerWidget self)
+{
+    scroller_lane_t lane;
+
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        if (!lane_is_idle(lane)) {
+            return;
+        }
+    }
+
+    self->scroller.is_stopped = True;
+    disable_clock(self);
+}
+
+/* Updates the state of a lane after a shift of zero or more pixels
+ * to the left. */
 static void
-adjust_left(ScrollerWidget self)
+adjust_left(ScrollerWidget self, scroller_lane_t lane)
 {
     int done = 0;
 
@@ -1230,37 +2367,34 @@ adjust_left(ScrollerWidget self)
         done = 1;
 
         /* Add glyphs to the right if there's room */
-        if (self->scroller.right_offset < 0) {
-            add_right_holder(self);
+        if (lane->right_offset < 0) {
+            add_right_holder(self, lane);
             done = 0;
         }
 
         /* Remove glyphs from the left if they're no longer visible */
-        if (self->scroller.left_offset >=
-            self->scroller.left_holder->width) {
-            remove_left_holder(self);
+        if (lane->left_offset >=
+            lane->left_holder->width) {
+            remove_left_holder(lane);
             done = 0;
         }
 
         /* Check for the magical stop condition */
-        if (self->scroller.left_holder == self->scroller.right_holder &&
-            self->scroller.left_holder->glyph == self->scroller.gap &&
-            queue_is_empty(self->scroller.gap)) {
-            /* Tidy up and stop */
-            self->scroller.left_offset = 0;
-            self->scroller.right_offset = 0;
-            self->scroller.left_holder->width = self->core.width;
-            self->scroller.is_stopped = True;
-            disable_clock(self);
+        if (lane_is_idle(lane)) {
+            /* Tidy up and stop if the other lanes are idle too */
+            lane->left_offset = 0;
+            lane->right_offset = 0;
+            lane->left_holder->width = self->core.width;
+            check_stopped(self);
             return;
         }
     }
 }
 
-/* Updates the state of the scroller after a shift of zero or more
- * pixels to the right */
+/* Updates the state of a lane after a shift of zero or more pixels
+ * to the right */
 static void
-adjust_right(ScrollerWidget self)
+adjust_right(ScrollerWidget self, scroller_lane_t lane)
 {
     int done = 0;
 
@@ -1269,47 +2403,318 @@ adjust_right(ScrollerWidget self)
         done = 1;
 
         /* Add glyphs to the left it needed */
-        if (self->scroller.left_offset < 0) {
-            add_left_holder(self);
+        if (lane->left_offset < 0) {
+            add_left_holder(self, lane);
             done = 0;
         }
 
         /* Remove glyphs from the right if they're no longer visible */
-        if (self->scroller.right_offset >=
-            self->scroller.right_holder->width) {
-            remove_right_holder(self);
+        if (lane->right_offset >=
+            lane->right_holder->width) {
+            remove_right_holder(lane);
             done = 0;
         }
 
         /* Check for the magical stop condition */
-        if (self->scroller.left_holder == self->scroller.right_holder &&
-            self->scroller.right_holder->glyph == self->scroller.gap &&
-            queue_is_empty(self->scroller.gap)) {
-            /* Tidy up and stop */
-            self->scroller.left_offset = 0;
-            self->scroller.right_offset = 0;
-            self->scroller.right_holder->width = self->core.width;
-            self->scroller.is_stopped = True;
-            disable_clock(self);
+        if (lane_is_idle(lane)) {
+            /* Tidy up and stop if the other lanes are idle too */
+            lane->left_offset = 0;
+            lane->right_offset = 0;
+            lane->right_holder->width = self->core.width;
+            check_stopped(self);
+            return;
+        }
+    }
+}
+
+/* Answers non-zero if request a was issued after request b */
+#define REQUEST_AFTER(a, b) ((long)((a) - (b)) > 0)
+
+/* Forgets the CopyArea requests up to and including the given one,
+ * whose exposures have all arrived */
+static void
+retire_copies(ScrollerWidget self, unsigned long request_id)
+{
+    struct pending_copy *copy;
+
+    while (self->scroller.copy_count != 0) {
+        copy = &self->scroller.copies[self->scroller.copy_first];
+        if (REQUEST_AFTER(copy->request_id, request_id)) {
             return;
         }
+
+        self->scroller.local_delta -= copy->delta;
+        self->scroller.copy_first =
+            (self->scroller.copy_first + 1) % MAX_PENDING_COPIES;
+        self->scroller.copy_count--;
+    }
+}
+
+/* Answers the distance moved by the pending CopyArea requests issued
+ * after the given one */
+static int
+copy_delta_after(ScrollerWidget self, unsigned long request_id)
+{
+    struct pending_copy *copy;
+    unsigned int i;
+    int delta = 0;
+
+    for (i = 0; i < self->scroller.copy_count; i++) {
+        copy = &self->scroller.copies[
+            (self->scroller.copy_first + i) % MAX_PENDING_COPIES];
+        if (REQUEST_AFTER(copy->request_id, request_id)) {
+            delta += copy->delta;
+        }
+    }
+
+    return delta;
+}
+
+#ifdef USE_SHM
+/* Set if an X error arrives while we're attaching to the segment */
+static Bool shm_failed;
+
+/* Notes that the X server couldn't attach to our segment */
+static int
+shm_error_handler(Display *display, XErrorEvent *event)
+{
+    shm_failed = True;
+    return 0;
+}
+#endif /* USE_SHM */
+
+/* Creates a shared memory image the size of the scroller to render
+ * into.  Answers False if the X server can't share memory with us
+ * (it's remote, or the extension is missing) or if its pixel format
+ * isn't one we can scroll a byte at a time */
+static Bool
+image_alloc(ScrollerWidget self)
+{
+#ifdef USE_SHM
+    Display *display = XtDisplay((Widget)self);
+    XShmSegmentInfo *info = &self->scroller.shm_info;
+    XErrorHandler handler;
+    XImage *image;
+
+    /* Make sure the extension is there and the visual is ours */
+    if (!XShmQueryExtension(display) ||
+        self->core.depth != DefaultDepthOfScreen(XtScreen(self))) {
+        return False;
+    }
+
+    /* Create an image with no pixels yet */
+    image = XShmCreateImage(display, DefaultVisualOfScreen(XtScreen(self)),
+                            self->core.depth, ZPixmap, NULL, info,
+                            self->core.width, self->scroller.height);
+    if (image == NULL) {
+        return False;
+    }
+
+    /* We only scroll whole bytes */
+    if (image->bits_per_pixel % 8 != 0) {
+        XDestroyImage(image);
+        return False;
+    }
+
+    /* Allocate a segment for the pixels */
+    info->shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height,
+                         IPC_CREAT | 0600);
+    if (info->shmid < 0) {
+        XDestroyImage(image);
+        return False;
+    }
+
+    info->shmaddr = shmat(info->shmid, NULL, 0);
+    if (info->shmaddr == (char *)-1) {
+        shmctl(info->shmid, IPC_RMID, NULL);
+        XDestroyImage(image);
+        return False;
+    }
+
+    image->data = info->shmaddr;
+    info->readOnly = False;
+
+    /* Attaching fails with an X error rather than a return value, so
+     * catch it synchronously */
+    XSync(display, False);
+    shm_failed = False;
+    handler = XSetErrorHandler(shm_error_handler);
+    XShmAttach(display, info);
+    XSync(display, False);
+    XSetErrorHandler(handler);
+
+    /* The segment goes away once we've both detached from it */
+    shmctl(info->shmid, IPC_RMID, NULL);
+
+    if (shm_failed) {
+        shmdt(info->shmaddr);
+        image->data = NULL;
+        XDestroyImage(image);
+        return False;
+    }
+
+    self->scroller.image = image;
+    self->scroller.image_request = 0;
+    return True;
+#else /* USE_SHM */
+    return False;
+#endif /* USE_SHM */
+}
+
+/* Releases the shared memory image */
+static void
+image_free(ScrollerWidget self)
+{
+#ifdef USE_SHM
+    XShmSegmentInfo *info = &self->scroller.shm_info;
+
+    /* The server keeps its own mapping until it processes the
+     * detach, so there's no need to wait for it */
+    XShmDetach(XtDisplay((Widget)self), info);
+    shmdt(info->shmaddr);
+    self->scroller.image->data = NULL;
+    XDestroyImage(self->scroller.image);
+    self->scroller.image = NULL;
+    self->scroller.image_request = 0;
+#endif /* USE_SHM */
+}
+
+/* Answers True if the X server may still be copying the image to
+ * the window.  We ask for a ShmCompletion event with each copy, and
+ * Xlib notes its sequence number when the event loop reads it, so
+ * this doesn't need a round trip. */
+static Bool
+image_is_busy(ScrollerWidget self)
+{
+    Display *display = XtDisplay((Widget)self);
+
+    if (self->scroller.image_request == 0) {
+        return False;
+    }
+
+    if (REQUEST_AFTER(LastKnownRequestProcessed(display),
+                      self->scroller.image_request - 1)) {
+        self->scroller.image_request = 0;
+        return False;
+    }
+
+    return True;
+}
+
+/* Waits for the X server to finish copying the image to the window
+ * so that we can safely change its pixels.  Scrolling waits for the
+ * ShmCompletion event instead, so this only blocks when something
+ * else needs to paint straight after a copy. */
+static void
+image_sync(ScrollerWidget self)
+{
+    if (image_is_busy(self)) {
+        XSync(XtDisplay((Widget)self), False);
+        self->scroller.image_request = 0;
+    }
+}
+
+/* Copies the image to the window */
+static void
+image_put(ScrollerWidget self)
+{
+#ifdef USE_SHM
+    Display *display = XtDisplay((Widget)self);
+
+    self->scroller.image_request = NextRequest(display);
+    XShmPutImage(display, XtWindow((Widget)self),
+                 self->scroller.backgroundGC, self->scroller.image,
+                 0, 0, 0, 0, self->core.width, self->scroller.height,
+                 True);
+#endif /* USE_SHM */
+}
+
+/* Resets part of the image to the background color */
+static void
+image_fill(ScrollerWidget self,
+           int x,
+           int y,
+           unsigned int width,
+           unsigned int height)
+{
+    XImage *image = self->scroller.image;
+    int bytes = image->bits_per_pixel / 8;
+    int left = MAX(x, 0);
+    int right = MIN(x + (int)width, image->width);
+    int top = MAX(y, 0);
+    int bottom = MIN(y + (int)height, image->height);
+    char *first;
+    int i;
+
+    if (right <= left || bottom <= top) {
+        return;
+    }
+
+    image_sync(self);
+
+    /* Paint the first row a pixel at a time... */
+    for (i = left; i < right; i++) {
+        XPutPixel(image, i, top, self->core.background_pixel);
+    }
+
+    /* ...and copy it to the rest */
+    first = image->data + top * image->bytes_per_line + left * bytes;
+    for (i = top + 1; i < bottom; i++) {
+        memcpy(first + (i - top) * image->bytes_per_line, first,
+               (right - left) * bytes);
+    }
+}
+
+/* Moves the image's pixels delta pixels to the right (or left if
+ * delta is negative) */
+static void
+image_scroll(ScrollerWidget self, int delta)
+{
+    XImage *image = self->scroller.image;
+    int bytes = image->bits_per_pixel / 8;
+    int count = image->width - (delta < 0 ? -delta : delta);
+    char *line;
+    int i;
+
+    /* If everything scrolled out of sight then there's nothing to
+     * keep */
+    if (count <= 0) {
+        return;
+    }
+
+    image_sync(self);
+    for (i = 0; i < image->height; i++) {
+        line = image->data + i * image->bytes_per_line;
+        if (delta < 0) {
+            memmove(line, line - delta * bytes, count * bytes);
+        } else {
+            memmove(line + delta * bytes, line, count * bytes);
+        }
     }
 }
 
 /* Try to scroll to the desired position as determined by
- * target_delta.  If the X server hasn't acknowledged our last
- * CopyArea request then we leave this pending */
+ * target_delta.  If there are already MAX_PENDING_COPIES CopyArea
+ * requests whose exposures haven't arrived then we leave this
+ * pending */
 static void
 scroll(ScrollerWidget self, int offset)
 {
     Display *display = XtDisplay(self);
+    struct pending_copy *copy;
+    scroller_lane_t lane;
     int delta;
 
     /* FIX THIS: offsets should be positive */
     self->scroller.target_delta -= offset;
 
-    /* Bail if we have an outstanding CopyArea request */
-    if (self->scroller.local_delta != 0) {
+    /* Bail if we have too many outstanding CopyArea requests */
+    if (self->scroller.copy_count == MAX_PENDING_COPIES) {
+        return;
+    }
+
+    /* Or if the X server is still copying the image to the window */
+    if (self->scroller.image != NULL && image_is_busy(self)) {
         return;
     }
 
@@ -1319,29 +2724,33 @@ scroll(ScrollerWidget self, int offset)
         return;
     }
 
-    /* Scroll left or right as appropriate */
-    self->scroller.left_offset -= delta;
-    self->scroller.right_offset += delta;
-    self->scroller.local_delta = delta;
+    /* Scroll each lane left or right as appropriate */
     self->scroller.target_delta = 0;
-
-    /* Update the view holders */
-    if (delta < 0) {
-        adjust_left(self);
-    } else {
-        adjust_right(self);
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        lane->left_offset -= delta;
+        lane->right_offset += delta;
+
+        /* Update the view holders */
+        if (delta < 0) {
+            adjust_left(self, lane);
+        } else {
+            adjust_right(self, lane);
+        }
     }
 
-    /* Pixmaps are easy */
+    /* Pixmaps and images are easy */
     if (self->scroller.use_pixmap) {
-        /* Scroll the pixmap */
-        XCopyArea(display, self->scroller.pixmap, self->scroller.pixmap,
-                  self->scroller.backgroundGC,
-                  0, 0, self->core.width, self->core.height,
-                  delta, 0);
-
-        /* We're always in sync with the X server */
-        self->scroller.local_delta = 0;
+        /* Scroll the image or pixmap */
+        if (self->scroller.image != NULL) {
+            image_scroll(self, delta);
+        } else {
+            XCopyArea(display, self->scroller.pixmap, self->scroller.pixmap,
+                      self->scroller.backgroundGC,
+                      0, 0, self->core.width, self->core.height,
+                      delta, 0);
+        }
 
         /* Repaint the missing bits */
         paint(self,
@@ -1355,12 +2764,16 @@ scroll(ScrollerWidget self, int offset)
 
     /* If the scroller is obscured then we're done */
     if (!self->scroller.is_visible) {
-        self->scroller.local_delta = 0;
         return;
     }
 
     /* Record the sequence number for the CopyArea request */
-    self->scroller.request_id = NextRequest(display);
+    copy = &self->scroller.copies[
+        (self->scroller.copy_first + self->scroller.copy_count) %
+        MAX_PENDING_COPIES];
+    copy->request_id = NextRequest(display);
+    copy->delta = delta;
+    self->scroller.copy_count++;
 
     /* Copy the window to itself */
     XCopyArea(display, XtWindow(self), XtWindow(self),
@@ -1368,7 +2781,7 @@ scroll(ScrollerWidget self, int offset)
               -delta, 0, self->core.width, self->scroller.height, 0, 0);
 
     /* Record that we're out of sync */
-    self->scroller.local_delta = delta;
+    self->scroller.local_delta += delta;
 }
 
 /* Repaints the view of each view_holder_t */
@@ -1381,8 +2794,9 @@ paint(ScrollerWidget self,
 {
     Widget widget = (Widget)self;
     Display *display = XtDisplay(widget);
-    glyph_holder_t holder = self->scroller.left_holder;
-    int offset = 0 - self->scroller.left_offset;
+    scroller_lane_t lane;
+    glyph_holder_t holder;
+    int offset;
     int end = self->core.width;
     XGCValues values;
     XRectangle bbox;
@@ -1414,37 +2828,60 @@ paint(ScrollerWidget self,
     bbox.x = x;
     bbox.y = y;
 
-    /* Are we using an offscreen pixmap? */
-    if (self->scroller.use_pixmap) {
+    /* Are we using an offscreen image or pixmap? */
+    if (self->scroller.image != NULL) {
+        /* Reset this portion of the image to the background color */
+        image_fill(self, x, y, width, height);
+    } else if (self->scroller.use_pixmap) {
         /* Reset this portion of the pixmap to the background color */
         XFillRectangle(display, self->scroller.pixmap,
                        self->scroller.backgroundGC, x, y, width, height);
     }
 
-    /* Draw each visible glyph */
-    while (offset < end) {
-        if (self->scroller.use_pixmap) {
-            glyph_holder_paint(display, self->scroller.pixmap,
-                               self->scroller.gc, holder, offset,
-                               self->scroller.font->ascent, &bbox);
-        } else {
-            glyph_holder_paint(display, XtWindow(self), self->scroller.gc,
-                               holder, offset, self->scroller.font->ascent,
-                               &bbox);
+    /* Draw each visible glyph in each lane */
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        /* Skip lanes outside the bounding box */
+        if (lane->y + self->scroller.line_height <= y ||
+            y + (int)height <= lane->y) {
+            continue;
         }
 
-        offset += holder->width;
-        holder = holder->next;
-    }
+        holder = lane->left_holder;
+        offset = 0 - lane->left_offset;
+        while (offset < end) {
+            if (self->scroller.use_pixmap) {
+                glyph_holder_paint(display, self->scroller.pixmap,
+                                   self->scroller.gc, holder, offset,
+                                   lane->y + self->scroller.font->ascent,
+                                   &bbox);
+            } else {
+                glyph_holder_paint(display, XtWindow(self),
+                                   self->scroller.gc, holder, offset,
+                                   lane->y + self->scroller.font->ascent,
+                                   &bbox);
+            }
 
-    /* Sanity check */
-    ASSERT(offset - self->core.width == self->scroller.right_offset);
+            offset += holder->width;
+            holder = holder->next;
+        }
+
+        /* Sanity check */
+        ASSERT(offset - self->core.width == lane->right_offset);
+    }
 }
 
 /* Repaints the scroller */
 static void
 redisplay(ScrollerWidget self, Region region)
 {
+    /* If we're using an image then just put it in the window */
+    if (self->scroller.image != NULL) {
+        image_put(self);
+        return;
+    }
+
     /* If we're using a pixmap then just copy it to the window */
     if (self->scroller.use_pixmap) {
         XCopyArea(XtDisplay((Widget)self), self->scroller.pixmap,
@@ -1491,13 +2928,9 @@ gexpose(Widget widget, XtPointer rock, XEvent *event, Boolean *ignored)
     for (;;) {
         XGraphicsExposeEvent *g_event;
 
-        /* See if the server has synced with our local state */
-        if (LastKnownRequestProcessed(display) >= self->scroller.request_id) {
-            self->scroller.local_delta = 0;
-        }
-
         /* Stop drawing stuff if the scroller is obscured */
         if (event->type == NoExpose) {
+            retire_copies(self, event->xnoexpose.serial);
             self->scroller.is_visible = False;
             return;
         }
@@ -1513,11 +2946,19 @@ gexpose(Widget widget, XtPointer rock, XEvent *event, Boolean *ignored)
         /* Coerce the event */
         g_event = (XGraphicsExposeEvent *)event;
 
-        /* Update this portion of the scroller */
-        paint(self, g_event->x, 0, g_event->width, self->scroller.height);
+        /* Update this portion of the scroller.  The event's
+         * coordinates already account for the CopyArea which caused
+         * it and those before it, but paint() compensates for all of
+         * the pending ones. */
+        paint(self,
+              g_event->x + copy_delta_after(self, g_event->serial) -
+              self->scroller.local_delta,
+              0, g_event->width, self->scroller.height);
 
-        /* Bail if this is the last GraphicsExpose event */
+        /* Bail if this is the last GraphicsExpose event for the
+         * CopyArea, which is then done with */
         if (g_event->count == 0) {
+            retire_copies(self, g_event->serial);
             return;
         }
 
@@ -1527,56 +2968,105 @@ gexpose(Widget widget, XtPointer rock, XEvent *event, Boolean *ignored)
     }
 }
 
-/* FIX THIS: should actually do something? */
+/* Releases the resources held by the widget */
 static void
 destroy(Widget widget)
-{
-    DPRINTF((2, "destroy %p\n", widget));
-}
-
-/* Find the empty view and update its width */
-static void
-resize(Widget widget)
 {
     ScrollerWidget self = (ScrollerWidget)widget;
+    Display *display = XtDisplay(widget);
+    Colormap colormap = XDefaultColormapOfScreen(XtScreen(widget));
+    scroller_lane_t lane;
+    glyph_holder_t holder, next;
 
-    /* If the widget isn't realized then just update the gap size */
-    if (!XtIsRealized(widget)) {
-        self->scroller.left_holder->width = self->core.width;
-        return;
+    DPRINTF((2, "destroy %p\n", widget));
+
+    /* Stop the clocks */
+    if (self->scroller.timer != None) {
+        XtRemoveTimeOut(self->scroller.timer);
+        self->scroller.timer = None;
     }
 
-    /* If we're using an offscreen pixmap then we'll need a new one */
-    if (self->scroller.use_pixmap) {
-        /* Otherwise we need a new offscreen pixmap */
-        XFreePixmap(XtDisplay(widget), self->scroller.pixmap);
-        self->scroller.pixmap = XCreatePixmap(
-            XtDisplay(widget), XtWindow(widget),
-            self->core.width, self->scroller.height,
-            self->core.depth);
+    if (self->scroller.fade_timer != None) {
+        XtRemoveTimeOut(self->scroller.fade_timer);
+        self->scroller.fade_timer = None;
     }
 
-    /* If the scroller is stalled, then we simply need to expand the gap */
-    if (self->scroller.is_stopped) {
-        self->scroller.left_holder->width = self->core.width;
-        if (self->scroller.use_pixmap) {
-            paint(self, 0, 0, self->core.width, self->scroller.height);
-            redisplay(self, NULL);
+    /* Release each lane's glyph holders and queued glyphs.  Freeing
+     * the glyphs also releases their pixmaps and takes them out of
+     * the fade wheel. */
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        for (holder = lane->left_holder; holder != NULL; holder = next) {
+            next = holder->next;
+            glyph_holder_free(holder);
+        }
+
+        while (lane->gap->next != lane->gap) {
+            queue_remove(lane->gap->next);
         }
 
+        GLYPH_FREE_REF(lane->gap, ref_gap, self);
+    }
+
+    free(self->scroller.lanes);
+    self->scroller.lanes = NULL;
+    free(self->scroller.fade_wheel);
+    self->scroller.fade_wheel = NULL;
+    free(self->scroller.glyph_tags);
+    self->scroller.glyph_tags = NULL;
+    free(self->scroller.holder_tags);
+    self->scroller.holder_tags = NULL;
+
+    /* Everything else was created when the widget was realized */
+    if (!XtIsRealized(widget)) {
         return;
     }
 
-    /* Adjust the glyph_holders and offsets to compensate */
+    /* Release the image (and the X server's attachment to it) or the
+     * offscreen pixmap */
+    if (self->scroller.image != NULL) {
+        image_free(self);
+    } else if (self->scroller.use_pixmap) {
+        XFreePixmap(display, self->scroller.pixmap);
+    }
+
+    /* Release the graphics contexts */
+    XFreeGC(display, self->scroller.backgroundGC);
+    XFreeGC(display, self->scroller.gc);
+    if (self->scroller.use_glyph_pixmaps) {
+        XFreeGC(display, self->scroller.glyph_gc);
+    }
+
+    /* And the faded colors */
+    XFreeColors(display, colormap, self->scroller.separator_pixels,
+                self->scroller.fade_levels, 0);
+    free(self->scroller.separator_pixels);
+    XFreeColors(display, colormap, self->scroller.group_pixels,
+                self->scroller.fade_levels, 0);
+    free(self->scroller.group_pixels);
+    XFreeColors(display, colormap, self->scroller.user_pixels,
+                self->scroller.fade_levels, 0);
+    free(self->scroller.user_pixels);
+    XFreeColors(display, colormap, self->scroller.string_pixels,
+                self->scroller.fade_levels, 0);
+    free(self->scroller.string_pixels);
+}
+
+/* Adjusts a lane's glyph_holders and offsets to compensate for a
+ * change in the widget's width */
+static void
+resize_lane(ScrollerWidget self, scroller_lane_t lane)
+{
     if (self->scroller.step < 0) {
-        glyph_holder_t holder = self->scroller.right_holder;
-        int offset = holder->width - self->scroller.right_offset;
+        glyph_holder_t holder = lane->right_holder;
+        int offset = holder->width - lane->right_offset;
 
         /* Look for a gap (but not the leading glyph) that we can adjust */
         holder = holder->previous;
         while (holder != NULL) {
             /* Did we find one? */
-            if (holder->glyph == self->scroller.gap) {
+            if (holder->glyph == lane->gap) {
                 /* Determine how wide the gap *should* be */
                 if (holder->previous != NULL) {
                     holder->width = gap_width(self, holder->previous->width);
@@ -1587,7 +3077,7 @@ resize(Widget widget)
                     }
 
                     /* Watch for the gap */
-                    if (glyph == self->scroller.gap) {
+                    if (glyph == lane->gap) {
                         holder->width = self->core.width;
                     } else {
                         holder->width =
@@ -1601,18 +3091,18 @@ resize(Widget widget)
         }
 
         /* Adjust the left offset and update the edges */
-        self->scroller.left_offset = offset - self->core.width;
-        adjust_left(self);
-        adjust_right(self);
+        lane->left_offset = offset - self->core.width;
+        adjust_left(self, lane);
+        adjust_right(self, lane);
     } else {
-        glyph_holder_t holder = self->scroller.left_holder;
-        int offset = holder->width - self->scroller.left_offset;
+        glyph_holder_t holder = lane->left_holder;
+        int offset = holder->width - lane->left_offset;
 
         /* Look for a gap (but not the leading glyph) that we can adjust */
         holder = holder->next;
         while (holder != NULL) {
             /* Adjust the width of the gap */
-            if (holder->glyph == self->scroller.gap) {
+            if (holder->glyph == lane->gap) {
                 holder->width = gap_width(self, holder->previous->width);
             }
 
@@ -1621,9 +3111,72 @@ resize(Widget widget)
         }
 
         /* Adjust the right offset and update the edges */
-        self->scroller.right_offset = offset - self->core.width;
-        adjust_right(self);
-        adjust_left(self);
+        lane->right_offset = offset - self->core.width;
+        adjust_right(self, lane);
+        adjust_left(self, lane);
+    }
+}
+
+/* Find the empty view and update its width */
+static void
+resize(Widget widget)
+{
+    ScrollerWidget self = (ScrollerWidget)widget;
+    scroller_lane_t lane;
+
+    /* If the widget isn't realized then just update the gap sizes */
+    if (!XtIsRealized(widget)) {
+        for (lane = self->scroller.lanes;
+             lane < self->scroller.lanes + self->scroller.lane_count;
+             lane++) {
+            lane->left_holder->width = self->core.width;
+        }
+
+        return;
+    }
+
+    /* If we're using an offscreen image then we'll need a new one */
+    if (self->scroller.image != NULL) {
+        image_sync(self);
+        image_free(self);
+
+        /* Fall back to a pixmap if we can't get another one */
+        if (!image_alloc(self)) {
+            self->scroller.pixmap = XCreatePixmap(
+                XtDisplay(widget), XtWindow(widget),
+                self->core.width, self->scroller.height,
+                self->core.depth);
+        }
+    } else if (self->scroller.use_pixmap) {
+        /* Otherwise we need a new offscreen pixmap */
+        XFreePixmap(XtDisplay(widget), self->scroller.pixmap);
+        self->scroller.pixmap = XCreatePixmap(
+            XtDisplay(widget), XtWindow(widget),
+            self->core.width, self->scroller.height,
+            self->core.depth);
+    }
+
+    /* If the scroller is stalled, then we simply need to expand the gaps */
+    if (self->scroller.is_stopped) {
+        for (lane = self->scroller.lanes;
+             lane < self->scroller.lanes + self->scroller.lane_count;
+             lane++) {
+            lane->left_holder->width = self->core.width;
+        }
+
+        if (self->scroller.use_pixmap) {
+            paint(self, 0, 0, self->core.width, self->scroller.height);
+            redisplay(self, NULL);
+        }
+
+        return;
+    }
+
+    /* Adjust the glyph_holders and offsets to compensate */
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        resize_lane(self, lane);
     }
 
     if (self->scroller.use_pixmap) {
@@ -1659,6 +3212,7 @@ query_geometry(Widget widget,
 static glyph_holder_t
 holder_at_point(ScrollerWidget self, int x, int y)
 {
+    scroller_lane_t lane;
     glyph_holder_t holder;
     int offset;
 
@@ -1668,9 +3222,13 @@ holder_at_point(ScrollerWidget self, int x, int y)
         return NULL;
     }
 
+    /* Find the lane containing the point */
+    lane = &self->scroller.lanes[
+        MIN(y / self->scroller.line_height, self->scroller.lane_count - 1)];
+
     /* Work from left-to-right looking for the glyph */
-    offset = -self->scroller.left_offset;
-    for (holder = self->scroller.left_holder;
+    offset = -lane->left_offset;
+    for (holder = lane->left_holder;
          holder != NULL;
          holder = holder->next) {
         offset += holder->width;
@@ -1717,9 +3275,9 @@ glyph_at_event(ScrollerWidget self, XEvent *event)
 {
     glyph_holder_t holder = holder_at_event(self, event);
 
-    /* If no holder found then return the gap */
+    /* If no holder found then return the first lane's gap */
     if (holder == NULL) {
-        return self->scroller.gap;
+        return self->scroller.lanes[0].gap;
     }
 
     return holder->glyph;
@@ -1792,10 +3350,12 @@ show_menu(Widget widget, XEvent *event, String *params, Cardinal *nparams)
 
     DPRINTF((1, "show-menu()\n"));
 
-    /* Pop up the menu and select the message that was clicked on */
+    /* Pop up the menu and select the message that was clicked on.
+     * For a summary that's the newest message it stands for. */
     glyph = glyph_at_event(self, event);
     XtCallCallbackList(widget, self->scroller.callbacks,
-                       glyph_get_message(glyph));
+                       glyph->summary_of != NULL ?
+                       glyph->summary_of : glyph_get_message(glyph));
 }
 
 /* Spawn metamail to decode the message's attachment */
@@ -1834,16 +3394,17 @@ expire(Widget widget, XEvent *event, String *params, Cardinal *nparams)
 static void
 delete_left_to_right(ScrollerWidget self, glyph_t glyph)
 {
-    glyph_holder_t holder = self->scroller.right_holder;
-    int offset = self->core.width + self->scroller.right_offset;
+    scroller_lane_t lane = glyph->lane;
+    glyph_holder_t holder = lane->right_holder;
+    int offset = self->core.width + lane->right_offset;
     int missing_width = 0;
 
     /* If we're deleting the leftmost glyph then we add another now.
      * We can then safely assume that the last glyph won't get deleted
      * out from under us. */
-    if (self->scroller.left_holder->glyph == glyph) {
-        add_left_holder(self);
-        ASSERT(self->scroller.left_holder->glyph != glyph);
+    if (lane->left_holder->glyph == glyph) {
+        add_left_holder(self, lane);
+        ASSERT(lane->left_holder->glyph != glyph);
     }
 
     /* Go through the glyphs and compensate */
@@ -1852,7 +3413,7 @@ delete_left_to_right(ScrollerWidget self, glyph_t glyph)
         glyph_holder_t previous = holder->previous;
 
         /* If we've found the gap then insert any lost width into it */
-        if (holder->glyph == self->scroller.gap) {
+        if (holder->glyph == lane->gap) {
             holder->width += missing_width;
             missing_width = 0;
         }
@@ -1867,14 +3428,14 @@ delete_left_to_right(ScrollerWidget self, glyph_t glyph)
 
             /* Remove the holder from the list */
             if (holder->next == NULL) {
-                self->scroller.right_holder = previous;
+                lane->right_holder = previous;
             } else {
                 holder->next->previous = previous;
 
                 /* If the glyph was surrounded by gaps then join the
                  * gaps into one */
-                if (previous->glyph == self->scroller.gap &&
-                    holder->next->glyph == self->scroller.gap) {
+                if (previous->glyph == lane->gap &&
+                    holder->next->glyph == lane->gap) {
                     glyph_holder_t right_gap = holder->next;
                     glyph_holder_t left_gap = previous;
 
@@ -1885,7 +3446,7 @@ delete_left_to_right(ScrollerWidget self, glyph_t glyph)
                     /* Remove the left gap from the list */
                     right_gap->previous = left_gap->previous;
                     if (left_gap->previous == NULL) {
-                        self->scroller.left_holder = right_gap;
+                        lane->left_holder = right_gap;
                     } else {
                         left_gap->previous->next = right_gap;
                     }
@@ -1905,8 +3466,8 @@ delete_left_to_right(ScrollerWidget self, glyph_t glyph)
         holder = previous;
     }
 
-    self->scroller.left_offset = -offset;
-    adjust_right(self);
+    lane->left_offset = -offset;
+    adjust_right(self, lane);
 }
 
 #if 1
@@ -1914,16 +3475,17 @@ delete_left_to_right(ScrollerWidget self, glyph_t glyph)
 static void
 delete_right_to_left(ScrollerWidget self, glyph_t glyph)
 {
-    glyph_holder_t holder = self->scroller.left_holder;
-    int offset = -self->scroller.left_offset;
+    scroller_lane_t lane = glyph->lane;
+    glyph_holder_t holder = lane->left_holder;
+    int offset = -lane->left_offset;
     int missing_width = 0;
 
     /* If we're deleting the rightmost glyph then we add another now.
      * We can then safely assume that the last glyph won't get deleted
      * out from under us. */
-    if (self->scroller.right_holder->glyph == glyph) {
-        add_right_holder(self);
-        ASSERT(self->scroller.right_holder->glyph != glyph);
+    if (lane->right_holder->glyph == glyph) {
+        add_right_holder(self, lane);
+        ASSERT(lane->right_holder->glyph != glyph);
     }
 
     /* Go through the glyphs and compensate */
@@ -1931,7 +3493,7 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
         glyph_holder_t next = holder->next;
 
         /* If we've found the gap then insert any lost width into it */
-        if (holder->glyph == self->scroller.gap) {
+        if (holder->glyph == lane->gap) {
             holder->width += missing_width;
             missing_width = 0;
         }
@@ -1947,14 +3509,14 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
 
             /* Remove the holder from the list */
             if (holder->previous == NULL) {
-                self->scroller.left_holder = next;
+                lane->left_holder = next;
             } else {
                 holder->previous->next = next;
 
                 /* If the glyph was surrounded by gaps, then join the
                  * gaps into one */
-                if (next->glyph == self->scroller.gap &&
-                    holder->previous->glyph == self->scroller.gap) {
+                if (next->glyph == lane->gap &&
+                    holder->previous->glyph == lane->gap) {
                     glyph_holder_t left_gap = holder->previous;
                     glyph_holder_t right_gap = next;
 
@@ -1966,7 +3528,7 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
                     /* Remove the right gap from the list */
                     left_gap->next = right_gap->next;
                     if (right_gap->next == NULL) {
-                        self->scroller.right_holder = left_gap;
+                        lane->right_holder = left_gap;
                     } else {
                         right_gap->next->previous = left_gap;
                     }
@@ -1986,23 +3548,24 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
         holder = next;
     }
 
-    self->scroller.right_offset = offset - self->core.width;
-    adjust_left(self);
+    lane->right_offset = offset - self->core.width;
+    adjust_left(self, lane);
 }
 #else
 /* Deletes a message when scrolling right to left */
 static void
 delete_right_to_left(ScrollerWidget self, glyph_t glyph)
 {
-    glyph_holder_t holder = self->scroller.right_holder;
+    scroller_lane_t lane = glyph->lane;
+    glyph_holder_t holder = lane->right_holder;
     int left_of_leading = 0;
 
     /* If we're deleting the rightmost glyph then we add another now
      * so that we don't lose our place in the circular queue if we
      * delete the entire contents of the scroller */
-    if (self->scroller.right_holder->glyph == glyph) {
-        add_right_holder(self);
-        ASSERT(self->scroller.right_holder->glyph != glyph);
+    if (lane->right_holder->glyph == glyph) {
+        add_right_holder(self, lane);
+        ASSERT(lane->right_holder->glyph != glyph);
     }
 
     /* Go through the visible glyphs and remove the deleted one */
@@ -2010,7 +3573,7 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
         glyph_holder_t previous = holder->previous;
 
         /* If this is the gap then we've seen the leading edge */
-        if (holder->glyph == self->scroller.gap) {
+        if (holder->glyph == lane->gap) {
             left_of_leading = 1;
         } else {
             /* Does the holder point to the glyph we're deleting? */
@@ -2018,9 +3581,9 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
                 /* If we've seen the leading edge then pull things in
                  * from the left */
                 if (left_of_leading) {
-                    self->scroller.left_offset -= holder->width;
+                    lane->left_offset -= holder->width;
                 } else {
-                    self->scroller.right_offset -= holder->width;
+                    lane->right_offset -= holder->width;
                 }
 
                 /* Remove the holder from the list */
@@ -2028,7 +3591,7 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
                 holder->next->previous = previous;
 
                 if (previous == NULL) {
-                    self->scroller.left_holder = holder->next;
+                    lane->left_holder = holder->next;
                 } else {
                     glyph_holder_t next = holder->next;
 
@@ -2037,12 +3600,12 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
 
                     /* If the glyph was surrounded by gaps then join
                      * them into a single big one */
-                    if (next->glyph == self->scroller.gap) &&
-                        (previous->glyph == self->scroller.gap) {
+                    if (next->glyph == lane->gap) &&
+                        (previous->glyph == lane->gap) {
                         /* Remove the right gap from the list */
                         previous->next = next->next;
                         if (next->next == NULL) {
-                            self->scroller.right_holder = previous;
+                            lane->right_holder = previous;
                         } else {
                             next->next->previous = previous;
                         }
@@ -2063,8 +3626,8 @@ delete_right_to_left(ScrollerWidget self, glyph_t glyph)
         holder = previous;
     }
 
-    adjust_left(self);
-    adjust_right(self);
+    adjust_left(self, lane);
+    adjust_right(self, lane);
 }
 #endif
 
@@ -2073,8 +3636,8 @@ static void
 delete_glyph(ScrollerWidget self, glyph_t glyph)
 {
     /* Refuse to delete the gap */
-    ASSERT(glyph != self->scroller.gap);
-    if (glyph == self->scroller.gap) {
+    ASSERT(glyph != glyph->lane->gap);
+    if (glyph == glyph->lane->gap) {
         return;
     }
 
@@ -2124,7 +3687,7 @@ delete(Widget widget, XEvent *event, String *params, Cardinal *nparams)
     glyph = glyph_at_event(self, event);
 
     /* Ignore attempts to delete the gap */
-    if (glyph == self->scroller.gap) {
+    if (glyph == glyph->lane->gap) {
         return;
     }
 
@@ -2336,6 +3899,7 @@ void
 ScAddMessage(Widget widget, message_t message)
 {
     ScrollerWidget self = (ScrollerWidget)widget;
+    scroller_lane_t lane;
     const char *tag;
     glyph_t glyph;
     glyph_t probe;
@@ -2349,15 +3913,17 @@ ScAddMessage(Widget widget, message_t message)
 
     /* See if the new message replaces another. */
     tag = message_get_tag(message);
-    probe = (tag == NULL) ? NULL : queue_find(self->scroller.gap, tag);
+    probe = (tag == NULL) ? NULL : queue_find(self, tag);
     if (probe == NULL) {
         /* The message doesn't match an existing one, so just append
-         * it to the end. */
-        queue_add(self->scroller.gap->previous, glyph);
+         * it to the end of a lane. */
+        lane = choose_lane(self, message);
+        queue_add(lane->gap->previous, glyph);
     } else {
         /* The message replaces another.  Update the glyph queue to
          * refer to our new glyph instead of the replaced one. */
         queue_replace(probe, glyph);
+        lane = glyph->lane;
 
         /* If the replaced glyph is still visible then record our new
            glyph as its successor. */
@@ -2368,21 +3934,27 @@ ScAddMessage(Widget widget, message_t message)
     }
 
     /* Adjust the gap width if possible and appropriate */
-    holder = self->scroller.left_holder;
-    if (self->scroller.step < 0 && holder->glyph == self->scroller.gap) {
+    holder = lane->left_holder;
+    if (self->scroller.step < 0 && holder->glyph == lane->gap) {
         int width = gap_width(self, glyph_get_width(glyph));
 
         /* If the effect is invisible, then just do it */
-        if (holder->width - self->scroller.left_offset < width) {
-            self->scroller.left_offset -= holder->width - width;
+        if (holder->width - lane->left_offset < width) {
+            lane->left_offset -= holder->width - width;
             holder->width = width;
         } else {
             /* We have to compromise */
-            holder->width -= self->scroller.left_offset;
-            self->scroller.left_offset = 0;
+            holder->width -= lane->left_offset;
+            lane->left_offset = 0;
         }
     }
 
+    /* Collapse the backlog if it's grown too long.  This may free
+     * the new glyph. */
+    if (self->scroller.overflow_factor != 0) {
+        queue_overflow(self, lane);
+    }
+
     /* Make sure the clock is running */
     if (self->scroller.is_stopped) {
         self->scroller.is_stopped = False;
@@ -2395,19 +3967,54 @@ void
 ScPurgeKilled(Widget widget)
 {
     ScrollerWidget self = (ScrollerWidget)widget;
+    scroller_lane_t lane;
     glyph_t glyph, next;
 
     /* Go through and delete the killed nodes */
-    glyph = self->scroller.gap->next;
-    while (glyph != self->scroller.gap) {
-        next = glyph->next;
+    for (lane = self->scroller.lanes;
+         lane < self->scroller.lanes + self->scroller.lane_count;
+         lane++) {
+        glyph = lane->gap->next;
+        while (glyph != lane->gap) {
+            next = glyph->next;
+
+            /* Get the glyph's message */
+            if (glyph_is_killed(glyph)) {
+                delete_glyph(self, glyph);
+            }
 
-        /* Get the glyph's message */
-        if (glyph_is_killed(glyph)) {
-            delete_glyph(self, glyph);
+            glyph = next;
         }
+    }
+}
 
-        glyph = next;
+/* Prints a histogram of the intervals between the receiver's ticks */
+void
+ScReportFrameTimes(Widget widget, FILE *out, const char *prefix)
+{
+    ScrollerWidget self = (ScrollerWidget)widget;
+    unsigned long total = 0;
+    int i;
+
+    for (i = 0; i < FRAME_TIME_BUCKETS; i++) {
+        total += self->scroller.frame_times[i];
+    }
+
+    fprintf(out, "%s: scroller: ticks=%lu, target=%ldms\n",
+            prefix, total, 1000L / self->scroller.frequency);
+    for (i = 0; i < FRAME_TIME_BUCKETS; i++) {
+        if (self->scroller.frame_times[i] == 0) {
+            continue;
+        }
+
+        if (i == FRAME_TIME_BUCKETS - 1) {
+            fprintf(out, "%s:   %3d+    ms: %lu\n", prefix,
+                    i * FRAME_TIME_WIDTH, self->scroller.frame_times[i]);
+        } else {
+            fprintf(out, "%s:   %3d-%-3dms: %lu\n", prefix,
+                    i * FRAME_TIME_WIDTH, (i + 1) * FRAME_TIME_WIDTH - 1,
+                    self->scroller.frame_times[i]);
+        }
     }
 }
 
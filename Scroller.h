@@ -60,7 +60,12 @@
  fadeLevels             FadeLevels                Dimension        5
 
  usePixmap           UsePixmap                Boolean                False
+ useGlyphPixmaps     UseGlyphPixmaps          Boolean                False
+ useSharedMemory     UseSharedMemory          Boolean                False
  dragDelta             DragDelta                Dimension        3
+ overflowFactor      OverflowFactor           Dimension        0
+ lanes               Lanes                    Dimension        1
+ groupLanes          GroupLanes               Boolean          False
  frequency             Frequency                Dimension        24
  stepSize             StepSize                Position        1
 
@@ -127,12 +132,42 @@
 #ifndef XtCUsePixmap
 # define XtCUsePixmap "UsePixmap"
 #endif
+#ifndef XtNuseGlyphPixmaps
+# define XtNuseGlyphPixmaps "useGlyphPixmaps"
+#endif
+#ifndef XtCUseGlyphPixmaps
+# define XtCUseGlyphPixmaps "UseGlyphPixmaps"
+#endif
+#ifndef XtNuseSharedMemory
+# define XtNuseSharedMemory "useSharedMemory"
+#endif
+#ifndef XtCUseSharedMemory
+# define XtCUseSharedMemory "UseSharedMemory"
+#endif
 #ifndef XtNdragDelta
 # define XtNdragDelta "dragDelta"
 #endif
 #ifndef XtCDragDelta
 # define XtCDragDelta "DragDelta"
 #endif
+#ifndef XtNlanes
+# define XtNlanes "lanes"
+#endif
+#ifndef XtCLanes
+# define XtCLanes "Lanes"
+#endif
+#ifndef XtNgroupLanes
+# define XtNgroupLanes "groupLanes"
+#endif
+#ifndef XtCGroupLanes
+# define XtCGroupLanes "GroupLanes"
+#endif
+#ifndef XtNoverflowFactor
+# define XtNoverflowFactor "overflowFactor"
+#endif
+#ifndef XtCOverflowFactor
+# define XtCOverflowFactor "OverflowFactor"
+#endif
 #ifndef XtNfrequency
 # define XtNfrequency "frequency"
 #endif
@@ -156,6 +191,7 @@ extern WidgetClass scrollerWidgetClass;
  *Public methods
  */
 
+#include <stdio.h> /* FILE */
 #include "message.h"
 
 /* Adds a Message to the receiver */
@@ -168,4 +204,9 @@ void
 ScPurgeKilled(Widget self);
 
 
+/* Prints a histogram of the intervals between the receiver's ticks */
+void
+ScReportFrameTimes(Widget self, FILE *out, const char *prefix);
+
+
 #endif /* SCROLLER_H */
@@ -41,6 +41,11 @@
 #define SCROLLERP_H
 
 #include <X11/CoreP.h>
+#if defined(HAVE_LIBXEXT) && defined(HAVE_SYS_SHM_H) && \
+    defined(HAVE_X11_EXTENSIONS_XSHM_H)
+# define USE_SHM 1
+# include <X11/extensions/XShm.h> /* XShmSegmentInfo */
+#endif
 
 #include "Scroller.h"
 
@@ -61,6 +66,54 @@ typedef struct _ScrollerClassRec {
 
 typedef struct glyph *glyph_t;
 typedef struct glyph_holder *glyph_holder_t;
+typedef struct scroller_lane *scroller_lane_t;
+
+/* The number of buckets in the frame time histogram */
+#define FRAME_TIME_BUCKETS 20
+
+/* The width of each frame time bucket in milliseconds */
+#define FRAME_TIME_WIDTH 5
+
+/* The maximum number of CopyArea requests which may be waiting for
+ * their GraphicsExpose or NoExpose events at once */
+#define MAX_PENDING_COPIES 4
+
+/* A CopyArea request whose exposures we haven't seen yet */
+struct pending_copy {
+    /* The request's sequence number */
+    unsigned long request_id;
+
+    /* The distance it moved the window's contents */
+    int delta;
+};
+
+/* A row of scrolling glyphs.  The lanes all scroll together, but
+ * each has its own circular queue of glyphs */
+struct scroller_lane {
+    /* The leftmost glyph holder */
+    glyph_holder_t left_holder;
+
+    /* The rightmost glyph holder */
+    glyph_holder_t right_holder;
+
+    /* The number of pixels of the leftmost glyph beyond the left edge
+     * of the scroller */
+    int left_offset;
+
+    /* The number of pixels of the rightmost glyph beyond the edge of
+     * the scroller */
+    int right_offset;
+
+    /* The gap in the lane's circular queue of glyphs */
+    glyph_t gap;
+
+    /* The y coordinate of the top of the lane */
+    int y;
+
+    /* The total width of the lane's queued glyphs which are yet to be
+     * shown */
+    long backlog_width;
+};
 
 /* New fields for the Scroller widget record */
 typedef struct {
@@ -76,9 +129,14 @@ typedef struct {
     Pixel separator_pixel;
     Dimension fade_levels;
     Boolean use_pixmap;
+    Boolean use_glyph_pixmaps;
+    Boolean use_shared_memory;
     Position drag_delta;
+    Dimension overflow_factor;
     Dimension frequency;
     Position step;
+    Dimension lane_count;
+    Boolean group_lanes;
 
     /* Private state */
 
@@ -88,6 +146,19 @@ typedef struct {
     /* The timer used to do the scrolling */
     XtIntervalId timer;
 
+    /* The time of the last tick in seconds (see get_time) */
+    double last_tick;
+
+    /* The time at which the next tick is due */
+    double next_tick;
+
+    /* The fraction of a pixel which we've yet to scroll */
+    double step_remainder;
+
+    /* The number of ticks which came after each interval, in buckets
+     * of FRAME_TIME_WIDTH milliseconds (the last one holds the rest) */
+    unsigned long frame_times[FRAME_TIME_BUCKETS];
+
     /* True if there are no messages to scroll */
     Bool is_stopped;
 
@@ -97,22 +168,8 @@ typedef struct {
     /* Are we dragging? */
     Bool is_dragging;
 
-    /* The leftmost glyph holder */
-    glyph_holder_t left_holder;
-
-    /* The rightmost glyph holder */
-    glyph_holder_t right_holder;
-
-    /* The number of pixels of the leftmost glyph beyond the left edge
-     * of the scroller */
-    int left_offset;
-
-    /* The number of pixels of the rightmost glyph beyond the edge of
-     * the scroller */
-    int right_offset;
-
-    /* The gap in the scroller's circular queue of glyphs */
-    glyph_t gap;
+    /* The rows of glyphs, from top to bottom */
+    struct scroller_lane *lanes;
 
     /* The minimum width for the gap */
     int min_gap_width;
@@ -121,18 +178,60 @@ typedef struct {
      * last time that a gap was added */
     int last_width;
 
-    /* The height of the scrolling text */
+    /* The height of one lane of scrolling text */
+    int line_height;
+
+    /* The height of all of the lanes */
     int height;
 
+    /* The queued glyphs which have tags, hashed by tag */
+    glyph_t *glyph_tags;
 
-    /* The sequence number of our last CopyArea request */
-    unsigned long request_id;
+    /* The visible glyph_holders whose glyphs have tags, hashed by tag */
+    glyph_holder_t *holder_tags;
+
+    /* The number of buckets in glyph_tags and holder_tags */
+    unsigned int tags_size;
+
+    /* The number of glyphs in glyph_tags */
+    unsigned int tags_count;
+
+    /* The hierarchical timer wheel of glyphs waiting to fade */
+    glyph_t *fade_wheel;
+
+    /* The glyphs whose time to fade has come */
+    glyph_t fade_pending;
+
+    /* The time from which the fade wheel's ticks are counted (see
+     * get_time) */
+    double fade_epoch;
+
+    /* The number of ticks the fade wheel has advanced */
+    unsigned long fade_now;
+
+    /* The number of glyphs in the fade wheel */
+    unsigned int fade_count;
+
+    /* The timer used to turn the fade wheel when we're not scrolling */
+    XtIntervalId fade_timer;
+
+
+    /* A circular array of the CopyArea requests whose exposures we
+     * haven't seen yet, oldest first */
+    struct pending_copy copies[MAX_PENDING_COPIES];
+
+    /* The index of the oldest pending copy */
+    unsigned int copy_first;
+
+    /* The number of pending copies */
+    unsigned int copy_count;
 
     /* The difference in position between the left_offset and
      * right_offset view of our position and our knowledge of the X
-     * server's state.  Positive values indicate the we've performed a
-     * CopyArea to the right that hasn't yet been acknowledged by the
-     * server.  If this is zero then the server should be in sync. */
+     * server's state: the sum of the deltas of the pending copies.
+     * Positive values indicate the we've performed a CopyArea to the
+     * right that hasn't yet been acknowledged by the server.  If this
+     * is zero then the server should be in sync. */
     int local_delta;
 
     /* The difference between the current scroller position and the
@@ -155,12 +254,29 @@ typedef struct {
     /* The off-screen pixmap */
     Pixmap pixmap;
 
+    /* The client-side image we render into instead of the pixmap if
+     * useSharedMemory is set and the X server can share it with us */
+    XImage *image;
+
+#ifdef USE_SHM
+    /* The shared memory segment holding the image's pixels */
+    XShmSegmentInfo shm_info;
+#endif
+
+    /* The sequence number of the last request to copy the image to
+     * the window, or 0 if the X server has finished with it */
+    unsigned long image_request;
+
     /* The GC used to draw the Scroller's background */
     GC backgroundGC;
 
     /* The GC used to draw various glyphs */
     GC gc;
 
+    /* The GC used to render glyphs into and copy them out of their
+     * pixmaps, or NULL if useGlyphPixmaps is False */
+    GC glyph_gc;
+
     /* The array of Pixels used to display the group portion of a
      * message at varying degrees of fading */
     Pixel *group_pixels;
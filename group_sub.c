@@ -55,6 +55,7 @@
 #include "globals.h"
 #include "replace.h"
 #include "key_table.h"
+#include "notify_fields.h"
 #include "group_sub.h"
 #include "utils.h"
 
@@ -101,6 +102,13 @@
 #endif
 
 
+/* The initial number of slots in a group_mux's name table */
+#define MUX_TABLE_SIZE 64
+
+/* A merged elvin subscription shared by the members of a group_mux
+ * with the same key names */
+typedef struct group_bucket *group_bucket_t;
+
 /* The group subscription data type */
 struct group_sub {
     /* The name of the receiver's group */
@@ -159,6 +167,75 @@ struct group_sub {
 
     /* Non-zero if the receiver is waiting on a change to the subscription */
     int is_pending;
+
+    /* The mux which subscribes on the receiver's behalf (or NULL) */
+    group_mux_t mux;
+
+    /* The bucket whose subscription the receiver shares (or NULL) */
+    group_bucket_t bucket;
+
+    /* The next member of the receiver's bucket */
+    group_sub_t bucket_next;
+
+    /* The next group in the receiver's mux name table chain */
+    group_sub_t mux_next;
+};
+
+/* The merged subscription data type */
+struct group_bucket {
+    /* The next bucket in the mux */
+    group_bucket_t next;
+
+    /* The mux to which the bucket belongs (NULL once detached) */
+    group_mux_t mux;
+
+    /* The names of the keys shared by the bucket's members */
+    char **key_names;
+
+    /* The number of key names */
+    int key_count;
+
+    /* The key table used for the subscription on the server */
+    key_table_t key_table;
+
+    /* The key table used by the bucket's members */
+    key_table_t new_key_table;
+
+    /* The bucket's members */
+    group_sub_t members;
+
+    /* The subscription expression on the server (or NULL) */
+    char *expression;
+
+    /* The bucket's elvin connection handle */
+    elvin_handle_t handle;
+
+    /* A convenient error context */
+    elvin_error_t error;
+
+    /* The bucket's subscription */
+    elvin_subscription_t subscription;
+
+    /* Non-zero if the bucket is waiting on a change to the subscription */
+    int is_pending;
+
+    /* Non-zero if the subscription doesn't match the members */
+    int is_dirty;
+};
+
+/* The group_mux data type */
+struct group_mux {
+    /* The merged subscriptions */
+    group_bucket_t buckets;
+
+    /* The member groups, hashed by name */
+    group_sub_t *table;
+
+    /* The number of slots in the table */
+    size_t table_size;
+
+    /* The number of groups in the table */
+    size_t count;
 };
 
 
@@ -428,6 +505,62 @@ notify_cb(elvin_handle_t handle,
     }
 }
 #elif ELVIN_VERSION_AT_LEAST(4, 1, -1)
+/* The indices of the fields extracted from notifications */
+enum {
+    FIELD_VERSION,
+    FIELD_FROM,
+    FIELD_USER,
+    FIELD_MESSAGE,
+    FIELD_TICKERTEXT,
+    FIELD_TIMEOUT,
+    FIELD_OLD_TIMEOUT,
+    FIELD_ATTACHMENT,
+    FIELD_MIME_TYPE,
+    FIELD_MIME_ARGS,
+    FIELD_REPLACEMENT_ID,
+    FIELD_REPLACEMENT,
+    FIELD_MESSAGE_ID,
+    FIELD_IN_REPLY_TO,
+    FIELD_THREAD_ID,
+    FIELD_COUNT
+};
+
+/* The names of the fields extracted from notifications */
+static const char *const field_names[FIELD_COUNT] = {
+    F3_VERSION,
+    F3_FROM,
+    F2_USER,
+    F3_MESSAGE,
+    F2_TICKERTEXT,
+    F3_TIMEOUT,
+    F2_TIMEOUT,
+    F3_ATTACHMENT,
+    F2_MIME_TYPE,
+    F2_MIME_ARGS,
+    F3_REPLACEMENT_ID,
+    F2_REPLACEMENT,
+    F3_MESSAGE_ID,
+    F3_IN_REPLY_TO,
+    F3_THREAD_ID
+};
+
+/* Returns the table used to extract fields from notifications */
+static notify_fields_t
+get_fields(void)
+{
+    static notify_fields_t fields = NULL;
+
+    if (fields == NULL) {
+        fields = notify_fields_alloc(field_names, FIELD_COUNT);
+        if (fields == NULL) {
+            perror("notify_fields_alloc failed");
+            exit(1);
+        }
+    }
+
+    return fields;
+}
+
 /* Delivers a notification which matches the receiver's subscription
  * expression */
 static int
@@ -439,9 +572,9 @@ notify_cb(elvin_handle_t handle,
           elvin_error_t error)
 {
     group_sub_t self = (group_sub_t)rock;
+    notify_value_t values[FIELD_COUNT];
+    notify_value_t *field;
     message_t message;
-    elvin_basetypes_t type;
-    elvin_value_t value;
     char *user;
     char *text;
     int32_t version = -1;
@@ -450,116 +583,89 @@ notify_cb(elvin_handle_t handle,
     uint32_t length = 0;
     char *mime_type;
     size_t header_length;
-    elvin_opaque_t mime_args;
     char *buffer = NULL;
     char *tag;
     char *message_id;
     char *reply_id;
     char *thread_id;
-    int found;
 
     /* If we don't have a callback then just quit now */
     if (self->callback == NULL) {
         return 1;
     }
 
-    /* Get the 'org.tickertape.message' field */
-    if (!elvin_notification_get_int32(notification, F3_VERSION, &found,
-                                      &version, error)) {
-        eeprintf(error, "elvin_notification_get_int32 failed\n");
-        exit(1);
-    }
-
-    /* Get the `From' field from the notification */
-    if (!elvin_notification_get_string(notification, F3_FROM, &found, &user,
-                                       error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
+    /* Pull all of the fields we're interested in out of the
+     * notification in one go */
+    if (!notify_fields_extract(get_fields(), notification, values, error)) {
+        eeprintf(error, "elvin_notification_traverse failed\n");
         exit(1);
     }
 
-    /* If that didn't work then try the old `USER' field */
-    if (!found) {
-        if (!elvin_notification_get_string(notification, F2_USER, &found,
-                                           &user, error)) {
-            eeprintf(error, "elvin_notification_get_string failed");
-            exit(1);
+    /* Get the 'org.tickertape.message' field */
+    if (values[FIELD_VERSION].found &&
+        values[FIELD_VERSION].type == ELVIN_INT32) {
+        version = values[FIELD_VERSION].value.i;
+    }
+
+    /* Get the `From' field from the notification, or failing that the
+     * old `USER' field, or failing that use a default user */
+    user = notify_value_string(&values[FIELD_FROM]);
+    if (user == NULL) {
+        user = notify_value_string(&values[FIELD_USER]);
+        if (user == NULL) {
+            user = "anonymous";
         }
     }
 
-    /* Use a default user if none was provided in the notification */
-    if (!found) {
-        user = "anonymous";
-    }
-
-    /* Get the `Message' field from the notification */
-    if (!elvin_notification_get_string(notification, F3_MESSAGE, &found,
-                                       &text, error)) {
-        eeprintf(error, "elvin_notification_get_string failed");
-        exit(1);
-    }
-
-    /* Try the `TICKERTEXT' field if no `Message' found */
-    if (!found) {
-        if (!elvin_notification_get_string(notification, F2_TICKERTEXT,
-                                           &found, &text, error)) {
-            eeprintf(error, "elvin_notification_get_string failed");
-            exit(1);
+    /* Get the `Message' field from the notification, or failing that
+     * the `TICKERTEXT' field, or failing that use an empty message */
+    text = notify_value_string(&values[FIELD_MESSAGE]);
+    if (text == NULL) {
+        text = notify_value_string(&values[FIELD_TICKERTEXT]);
+        if (text == NULL) {
+            text = "";
         }
     }
 
-    /* Default to an empty message if none provided */
-    if (!found) {
-        text = "";
-    }
-
-    /* Get the `Timeout' field from the notification */
-    if (!elvin_notification_get(notification, F3_TIMEOUT, &found, &type,
-                                &value, error)) {
-        eeprintf(error, "elvin_notification_get failed");
-        exit(1);
-    }
-
-    /* Try the `TIMEOUT' field for backward compatibility */
-    if (!found) {
-        if (!elvin_notification_get(notification, F2_TIMEOUT, &found, &type,
-                                    &value, error)) {
-            eeprintf(error, "elvin_notification_get failed");
-            exit(1);
-        }
+    /* Get the `Timeout' field, or the `TIMEOUT' field for backward
+     * compatibility */
+    field = &values[FIELD_TIMEOUT];
+    if (!field->found) {
+        field = &values[FIELD_OLD_TIMEOUT];
     }
 
     /* Be overly generous with the timeout field's type */
-    if (found) {
-        switch (type) {
+    if (field->found) {
+        switch (field->type) {
         case ELVIN_INT32:
-            if (version < 3001 && value.i <= 60) {
-                timeout = value.i * 60;
+            if (version < 3001 && field->value.i <= 60) {
+                timeout = field->value.i * 60;
             } else {
-                timeout = value.i;
+                timeout = field->value.i;
             }
 
             break;
 
         case ELVIN_INT64:
-            if (version < 3001 && value.h <= 60) {
-                timeout = (int)value.h * 60;
+            if (version < 3001 && field->value.h <= 60) {
+                timeout = (int)field->value.h * 60;
             } else {
-                timeout = (int)value.h;
+                timeout = (int)field->value.h;
             }
 
             break;
 
         case ELVIN_REAL64:
-            if (version < 3001 && value.d <= 60) {
-                timeout = (int)(0.5 + 60 * value.d);
+            if (version < 3001 && field->value.d <= 60) {
+                timeout = (int)(0.5 + 60 * field->value.d);
             } else {
-                timeout = (int)(0.5 + value.d);
+                timeout = (int)(0.5 + field->value.d);
             }
 
             break;
 
         case ELVIN_STRING:
-            timeout = atoi(value.s);
+            timeout = atoi(field->value.s);
             if (version < 3001 && timeout < 60) {
                 timeout *= 60;
             }
@@ -582,31 +688,18 @@ notify_cb(elvin_handle_t handle,
     }
 
     /* Get the `Attachment' field from the notification */
-    if (!elvin_notification_get(notification, F3_ATTACHMENT,
-                                &found, &type, &value,
-                                error))
-    {
-        eeprintf(error, "elvin_notification_get failed\n");
-        exit(1);
-    }
-
-    if (found) {
-        if (type == ELVIN_STRING) {
-            attachment = value.s;
-            length = strlen(value.s);
-        } else if (type == ELVIN_OPAQUE) {
-            attachment = value.o.data;
-            length = value.o.length;
+    field = &values[FIELD_ATTACHMENT];
+    if (field->found) {
+        if (field->type == ELVIN_STRING) {
+            attachment = field->value.s;
+            length = strlen(field->value.s);
+        } else if (field->type == ELVIN_OPAQUE) {
+            attachment = field->value.o.data;
+            length = field->value.o.length;
         }
     } else {
         /* Try the backward compatible `MIME-TYPE' field */
-        if (!elvin_notification_get_string(notification,
-                                           F2_MIME_TYPE,
-                                           NULL, &mime_type,
-                                           error)) {
-            eeprintf(error, "elvin_notification_get_string failed");
-            exit(1);
-        }
+        mime_type = notify_value_string(&values[FIELD_MIME_TYPE]);
 
         /* Look for mime args if we have a mime type */
         if (mime_type != NULL) {
@@ -614,18 +707,11 @@ notify_cb(elvin_handle_t handle,
                 strlen(mime_type);
 
             /* Try the backward compatible `MIME_ARGS' field */
-            if (!elvin_notification_get(
-                    notification,
-                    F2_MIME_ARGS,
-                    &found, &type, &value,
-                    error)) {
-                eeprintf(error, "elvin_notification_get failed");
-                exit(1);
-            }
+            field = &values[FIELD_MIME_ARGS];
 
             /* Accept string attachments */
-            if (mime_type != NULL && found && type == ELVIN_STRING) {
-                length = header_length + strlen(value.s);
+            if (field->found && field->type == ELVIN_STRING) {
+                length = header_length + strlen(field->value.s);
                 buffer = malloc(length + 1);
                 if (buffer == NULL) {
                     length = 0;
@@ -633,12 +719,12 @@ notify_cb(elvin_handle_t handle,
                     attachment = buffer;
                     snprintf(buffer, header_length + 1, ATTACHMENT_HEADER_FMT,
                              mime_type);
-                    strcpy(buffer + header_length, value.s);
+                    strcpy(buffer + header_length, field->value.s);
                 }
             }
             /* And accept opaque attachments */
-            else if (mime_type != NULL && found && type == ELVIN_OPAQUE) {
-                length = header_length + value.o.length;
+            else if (field->found && field->type == ELVIN_OPAQUE) {
+                length = header_length + field->value.o.length;
                 buffer = malloc(length + 1);
                 if (buffer == NULL) {
                     length = 0;
@@ -646,53 +732,24 @@ notify_cb(elvin_handle_t handle,
                     attachment = buffer;
                     snprintf(buffer, header_length + 1, ATTACHMENT_HEADER_FMT,
                              mime_type);
-                    memcpy(buffer + header_length, value.o.data,
-                           value.o.length);
+                    memcpy(buffer + header_length, field->value.o.data,
+                           field->value.o.length);
                 }
-            } else {
-                /* But not other kinds */
-                mime_args.data = NULL;
-                mime_args.length = 0;
             }
         }
     }
 
-    /* Get the `Replaces' field from the notification */
-    if (!elvin_notification_get_string(notification, F3_REPLACEMENT_ID,
-                                       &found, &tag, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
-
-    /* Try the backward compatible `REPLACEMENT' field */
-    if (!found) {
-        if (!elvin_notification_get_string(notification, F2_REPLACEMENT, NULL,
-                                           &tag, error)) {
-            eeprintf(error, "elvin_notification_get_string failed\n");
-            exit(1);
-        }
-    }
-
-    /* Get the `Message-Id' from the notification */
-    if (!elvin_notification_get_string(notification, F3_MESSAGE_ID, NULL,
-                                       &message_id, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
-
-    /* Get the `In-Reply-To' field from the notification */
-    if (!elvin_notification_get_string(notification, F3_IN_REPLY_TO, NULL,
-                                       &reply_id, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
+    /* Get the `Replaces' field from the notification, or the backward
+     * compatible `REPLACEMENT' field */
+    tag = notify_value_string(&values[FIELD_REPLACEMENT_ID]);
+    if (tag == NULL) {
+        tag = notify_value_string(&values[FIELD_REPLACEMENT]);
     }
 
-    /* Get the `Thread-Id' field from the notification */
-    if (!elvin_notification_get_string(notification, F3_THREAD_ID, NULL,
-                                       &thread_id, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
+    /* Get the `Message-Id', `In-Reply-To' and `Thread-Id' fields */
+    message_id = notify_value_string(&values[FIELD_MESSAGE_ID]);
+    reply_id = notify_value_string(&values[FIELD_IN_REPLY_TO]);
+    thread_id = notify_value_string(&values[FIELD_THREAD_ID]);
 
     /* Construct a message */
     message = message_alloc(self->name, self->name, user, text,
@@ -935,6 +992,469 @@ group_sub_update_keys(group_sub_t self,
     self->key_count = key_count;
 }
 
+#if !defined(ELVIN_VERSION_AT_LEAST)
+/* Answers the value of a notification's string field, or NULL if it
+ * doesn't have one */
+static const char *
+get_string(elvin_notification_t notification,
+           const char *name,
+           elvin_error_t error)
+{
+    elvin_basetypes_t type;
+    elvin_value_t value;
+
+    if (elvin_notification_get(notification, name, &type, &value, error) &&
+        type == ELVIN_STRING) {
+        return (const char *)value.s;
+    }
+
+    return NULL;
+}
+#elif ELVIN_VERSION_AT_LEAST(4, 1, -1)
+/* Answers the value of a notification's string field, or NULL if it
+ * doesn't have one */
+static const char *
+get_string(elvin_notification_t notification,
+           const char *name,
+           elvin_error_t error)
+{
+    char *value;
+    int found;
+
+    if (!elvin_notification_get_string(notification, name, &found,
+                                       &value, error)) {
+        eeprintf(error, "elvin_notification_get_string failed\n");
+        exit(1);
+    }
+
+    return found ? value : NULL;
+}
+#endif /* ELVIN_VERSION_AT_LEAST */
+
+/* Answers the slot of the mux's name table in which a name belongs */
+static group_sub_t *
+mux_slot(group_mux_t self, const char *name)
+{
+    return &self->table[string_hash(name) % self->table_size];
+}
+
+/* Doubles the size of the mux's name table */
+static int
+mux_grow(group_mux_t self)
+{
+    group_sub_t *old_table = self->table;
+    size_t old_size = self->table_size;
+    group_sub_t *table;
+    group_sub_t group;
+    group_sub_t *slot;
+    size_t i;
+
+    table = calloc(old_size * 2, sizeof(group_sub_t));
+    if (table == NULL) {
+        return -1;
+    }
+
+    self->table = table;
+    self->table_size = old_size * 2;
+
+    /* Rehash the groups into the new table */
+    for (i = 0; i < old_size; i++) {
+        while ((group = old_table[i]) != NULL) {
+            old_table[i] = group->mux_next;
+            slot = mux_slot(self, group->name);
+            group->mux_next = *slot;
+            *slot = group;
+        }
+    }
+
+    free(old_table);
+    return 0;
+}
+
+/* Answers non-zero if a bucket holds groups with the given key names */
+static int
+bucket_has_keys(group_bucket_t self, char **key_names, int key_count)
+{
+    int i;
+
+    if (self->key_count != key_count) {
+        return 0;
+    }
+
+    for (i = 0; i < key_count; i++) {
+        if (strcmp(self->key_names[i], key_names[i]) != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Allocates a bucket for groups with the given key names */
+static group_bucket_t
+bucket_alloc(group_mux_t mux, char **key_names, int key_count)
+{
+    group_bucket_t self;
+    int i;
+
+    self = malloc(sizeof(struct group_bucket));
+    if (self == NULL) {
+        return NULL;
+    }
+    memset(self, 0, sizeof(struct group_bucket));
+
+    /* Copy the key names */
+    if (key_count != 0) {
+        self->key_names = malloc(key_count * sizeof(char *));
+        if (self->key_names == NULL) {
+            abort();
+        }
+
+        for (i = 0; i < key_count; i++) {
+            self->key_names[i] = strdup(key_names[i]);
+            if (self->key_names[i] == NULL) {
+                abort();
+            }
+        }
+
+        self->key_count = key_count;
+    }
+
+    self->mux = mux;
+    return self;
+}
+
+/* Releases the resources used by a bucket */
+static void
+bucket_free(group_bucket_t self)
+{
+    int i;
+
+    for (i = 0; i < self->key_count; i++) {
+        free(self->key_names[i]);
+    }
+
+    if (self->key_names != NULL) {
+        free(self->key_names);
+    }
+
+    if (self->expression != NULL) {
+        free(self->expression);
+    }
+
+    free(self);
+}
+
+/* Answers the disjunction of the expressions of a bucket's members */
+static char *
+bucket_expression(group_bucket_t self)
+{
+    group_sub_t group;
+    size_t length = 0;
+    char *expression;
+    char *point;
+
+    /* Each expression is wrapped as "(...) || " */
+    for (group = self->members; group != NULL; group = group->bucket_next) {
+        length += strlen(group->expression) + 6;
+    }
+
+    expression = malloc(length + 1);
+    if (expression == NULL) {
+        abort();
+    }
+
+    point = expression;
+    for (group = self->members; group != NULL; group = group->bucket_next) {
+        if (point != expression) {
+            memcpy(point, " || ", 4);
+            point += 4;
+        }
+
+        *point++ = '(';
+        length = strlen(group->expression);
+        memcpy(point, group->expression, length);
+        point += length;
+        *point++ = ')';
+    }
+
+    *point = '\0';
+    return expression;
+}
+
+/* Hands a notification to the members of the bucket whose name
+ * matches its TICKERTAPE or Group field */
+static ELVIN_RETURN_TYPE
+bucket_notify_cb(elvin_handle_t handle,
+                 elvin_subscription_t subscription,
+                 elvin_notification_t notification,
+                 int is_secure,
+                 void *rock,
+                 elvin_error_t error)
+{
+    group_bucket_t self = (group_bucket_t)rock;
+    const char *names[2];
+    group_sub_t group;
+    int i;
+
+    /* Ignore stragglers once the bucket is detached */
+    if (self->mux == NULL) {
+        return ELVIN_RETURN_SUCCESS;
+    }
+
+    /* Look up the notification's group names */
+    names[0] = get_string(notification, F3_GROUP, error);
+    names[1] = get_string(notification, F2_TICKERTAPE, error);
+    if (names[0] != NULL && names[1] != NULL &&
+        strcmp(names[0], names[1]) == 0) {
+        names[1] = NULL;
+    }
+
+    /* Deliver it to each matching member */
+    for (i = 0; i < 2; i++) {
+        if (names[i] == NULL) {
+            continue;
+        }
+
+        group = *mux_slot(self->mux, names[i]);
+        while (group != NULL) {
+            if (group->bucket == self && strcmp(group->name, names[i]) == 0) {
+                notify_cb(handle, subscription, notification, is_secure,
+                          group, error);
+            }
+
+            group = group->mux_next;
+        }
+    }
+
+    return ELVIN_RETURN_SUCCESS;
+}
+
+static void
+bucket_sync(group_bucket_t self);
+
+/* Callback for a bucket's subscribe request */
+static ELVIN_RETURN_TYPE
+bucket_subscribe_cb(elvin_handle_t handle,
+                    int result,
+                    elvin_subscription_t subscription,
+                    void *rock,
+                    elvin_error_t error)
+{
+    group_bucket_t self = (group_bucket_t)rock;
+
+    self->subscription = subscription;
+    self->is_pending = 0;
+
+    /* Catch up with any changes made in the meantime */
+    if (self->is_dirty) {
+        bucket_sync(self);
+    }
+
+    return ELVIN_RETURN_SUCCESS;
+}
+
+/* Callback for a bucket's unsubscribe request */
+static ELVIN_RETURN_TYPE
+bucket_unsubscribe_cb(elvin_handle_t handle,
+                      int result,
+                      elvin_subscription_t subscription,
+                      void *rock,
+                      elvin_error_t error)
+{
+    bucket_free((group_bucket_t)rock);
+    return ELVIN_RETURN_SUCCESS;
+}
+
+/* Detaches an empty bucket from its mux and drops its subscription */
+static void
+bucket_retire(group_bucket_t self)
+{
+    group_bucket_t *pointer;
+
+    if (self->mux != NULL) {
+        pointer = &self->mux->buckets;
+        while (*pointer != self) {
+            pointer = &(*pointer)->next;
+        }
+        *pointer = self->next;
+        self->mux = NULL;
+    }
+
+    /* Free the bucket now if it never subscribed */
+    if (self->subscription == NULL) {
+        bucket_free(self);
+        return;
+    }
+
+    if (elvin_async_delete_subscription(self->handle, self->subscription,
+                                        bucket_unsubscribe_cb, self,
+                                        self->error) == 0) {
+        eeprintf(self->error, "elvin_delete_subscription failed\n");
+        exit(1);
+    }
+
+    self->is_pending = 1;
+}
+
+/* Brings a bucket's subscription up to date with its members */
+static void
+bucket_sync(group_bucket_t self)
+{
+    elvin_keys_t keys_to_add = NULL;
+    elvin_keys_t keys_to_remove = NULL;
+    char *expression;
+    int accept_insecure = (self->key_count == 0);
+
+    /* Wait for the outstanding request to finish */
+    if (self->is_pending) {
+        return;
+    }
+
+    self->is_dirty = 0;
+
+    /* Drop the subscription once the last member is gone */
+    if (self->members == NULL) {
+        bucket_retire(self);
+        return;
+    }
+
+    expression = bucket_expression(self);
+
+    /* Subscribe if we haven't already done so */
+    if (self->subscription == NULL) {
+        key_table_diff(NULL, NULL, 0,
+                       self->new_key_table, self->key_names, self->key_count,
+                       0, &keys_to_add, NULL);
+
+        if (!elvin_async_add_subscription(self->handle, expression,
+                                          keys_to_add, accept_insecure,
+                                          bucket_notify_cb, self,
+                                          bucket_subscribe_cb, self,
+                                          self->error)) {
+            eeprintf(self->error, "elvin_async_add_subscription failed\n");
+        }
+
+        self->is_pending = 1;
+    } else {
+        /* Compute the key changes */
+        if (self->key_table != self->new_key_table) {
+            key_table_diff(self->key_table,
+                           self->key_names, self->key_count,
+                           self->new_key_table,
+                           self->key_names, self->key_count,
+                           0, &keys_to_add, &keys_to_remove);
+        }
+
+        /* Modify the subscription if anything has changed */
+        if (strcmp(expression, self->expression) != 0 ||
+            keys_to_add != NULL || keys_to_remove != NULL) {
+            if (!elvin_async_modify_subscription(
+                    self->handle, self->subscription,
+                    strcmp(expression, self->expression) ? expression : NULL,
+                    keys_to_add, keys_to_remove, &accept_insecure,
+                    NULL, NULL, NULL, NULL, self->error)) {
+                eeprintf(self->error,
+                         "elvin_async_modify_subscription failed\n");
+                abort();
+            }
+        }
+    }
+
+    /* Record what the server now has */
+    if (self->expression != NULL) {
+        free(self->expression);
+    }
+
+    self->expression = expression;
+    self->key_table = self->new_key_table;
+
+    /* Clean up */
+    if (keys_to_add) {
+        elvin_keys_free(keys_to_add, NULL);
+    }
+
+    if (keys_to_remove) {
+        elvin_keys_free(keys_to_remove, NULL);
+    }
+}
+
+/* Adds a group to the bucket of its mux which matches its keys */
+static void
+mux_join(group_sub_t group, elvin_handle_t handle, elvin_error_t error)
+{
+    group_mux_t self = group->mux;
+    group_bucket_t bucket;
+    group_sub_t *slot;
+
+    /* Find a bucket with the same keys */
+    for (bucket = self->buckets; bucket != NULL; bucket = bucket->next) {
+        if (bucket_has_keys(bucket, group->key_names, group->key_count)) {
+            break;
+        }
+    }
+
+    /* Create one if there isn't one */
+    if (bucket == NULL) {
+        bucket = bucket_alloc(self, group->key_names, group->key_count);
+        if (bucket == NULL) {
+            abort();
+        }
+
+        bucket->next = self->buckets;
+        self->buckets = bucket;
+    }
+
+    bucket->handle = handle;
+    bucket->error = error;
+    bucket->new_key_table = group->key_table;
+    bucket->is_dirty = 1;
+
+    group->bucket = bucket;
+    group->bucket_next = bucket->members;
+    bucket->members = group;
+
+    /* Make sure the name table stays lightly loaded */
+    if (self->table_size <= self->count && mux_grow(self) < 0) {
+        abort();
+    }
+
+    /* Index the group by name */
+    slot = mux_slot(self, group->name);
+    group->mux_next = *slot;
+    *slot = group;
+    self->count++;
+}
+
+/* Removes a group from its bucket */
+static void
+mux_leave(group_sub_t group)
+{
+    group_mux_t self = group->mux;
+    group_bucket_t bucket = group->bucket;
+    group_sub_t *pointer;
+
+    /* Remove it from the bucket */
+    pointer = &bucket->members;
+    while (*pointer != group) {
+        pointer = &(*pointer)->bucket_next;
+    }
+    *pointer = group->bucket_next;
+    bucket->is_dirty = 1;
+
+    /* And from the name table */
+    pointer = mux_slot(self, group->name);
+    while (*pointer != group) {
+        pointer = &(*pointer)->mux_next;
+    }
+    *pointer = group->mux_next;
+    self->count--;
+
+    group->bucket = NULL;
+    group->bucket_next = NULL;
+    group->mux_next = NULL;
+}
+
 /*
  *
  * Exported functions
@@ -1015,6 +1535,11 @@ group_sub_free(group_sub_t self)
 {
     int i;
 
+    /* Stop receiving notifications from the mux */
+    if (self->bucket != NULL) {
+        mux_leave(self);
+    }
+
     if (self->name) {
         free(self->name);
         self->name = NULL;
@@ -1103,10 +1628,15 @@ group_sub_update_from_sub(group_sub_t self,
                           &keys_to_add, &keys_to_remove);
     accept_insecure = (self->key_count == 0);
 
-    /* Update the subscription if necessary */
-    if (expression != NULL ||
-        keys_to_add != NULL ||
-        keys_to_remove != NULL) {
+    /* Let the mux pick up the changes at its next sync */
+    if (self->mux != NULL) {
+        if (self->bucket != NULL) {
+            mux_leave(self);
+            mux_join(self, self->handle, self->error);
+        }
+    } else if (expression != NULL ||
+               keys_to_add != NULL ||
+               keys_to_remove != NULL) {
         /* Modify the subscription on the server */
         if (!elvin_async_modify_subscription(self->handle,
                                              self->subscription, expression,
@@ -1178,6 +1708,22 @@ group_sub_set_connection(group_sub_t self,
 {
     elvin_keys_t keys;
 
+    /* Let the mux subscribe on our behalf */
+    if (self->mux != NULL) {
+        if (self->bucket != NULL) {
+            mux_leave(self);
+        }
+
+        self->handle = handle;
+        self->error = error;
+
+        if (handle != NULL) {
+            mux_join(self, handle, error);
+        }
+
+        return;
+    }
+
     if (self->handle != NULL && self->subscription != NULL) {
         if (elvin_async_delete_subscription(self->handle,
                                             self->subscription,
@@ -1219,6 +1765,76 @@ group_sub_set_connection(group_sub_t self,
     }
 }
 
+/* Makes the receiver share an elvin subscription with the other
+ * members of mux which use the same keys */
+void
+group_sub_set_mux(group_sub_t self, group_mux_t mux)
+{
+    ASSERT(self->handle == NULL);
+    self->mux = mux;
+}
+
+/* Allocates and initializes a new group_mux_t */
+group_mux_t
+group_mux_alloc(void)
+{
+    group_mux_t self;
+
+    self = malloc(sizeof(struct group_mux));
+    if (self == NULL) {
+        return NULL;
+    }
+    memset(self, 0, sizeof(struct group_mux));
+
+    self->table = calloc(MUX_TABLE_SIZE, sizeof(group_sub_t));
+    if (self->table == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->table_size = MUX_TABLE_SIZE;
+    return self;
+}
+
+/* Releases the resources used by the receiver */
+void
+group_mux_free(group_mux_t self)
+{
+    group_bucket_t bucket;
+
+    /* Detach the buckets, dropping their subscriptions */
+    while ((bucket = self->buckets) != NULL) {
+        self->buckets = bucket->next;
+        bucket->mux = NULL;
+        bucket->members = NULL;
+
+        if (bucket->is_pending) {
+            bucket->is_dirty = 1;
+        } else {
+            bucket_sync(bucket);
+        }
+    }
+
+    free(self->table);
+    free(self);
+}
+
+/* Brings the receiver's elvin subscriptions up to date with the
+ * connections, keys and expressions of its members */
+void
+group_mux_sync(group_mux_t self)
+{
+    group_bucket_t bucket;
+    group_bucket_t next;
+
+    for (bucket = self->buckets; bucket != NULL; bucket = next) {
+        next = bucket->next;
+        if (bucket->is_dirty) {
+            bucket_sync(bucket);
+        }
+    }
+}
+
 /* Registers the receiver with the control panel */
 void
 group_sub_set_control_panel(group_sub_t self, control_panel_t control_panel)
@@ -48,6 +48,9 @@
 /* The subscription data type */
 typedef struct group_sub *group_sub_t;
 
+/* A set of group subscriptions which share elvin subscriptions */
+typedef struct group_mux *group_mux_t;
+
 #include "message.h"
 #include "panel.h"
 
@@ -97,6 +100,34 @@ group_sub_set_connection(group_sub_t self,
                          elvin_error_t error);
 
 
+/* Makes the receiver share an elvin subscription with the other
+ * members of mux which use the same keys.  Notifications are handed
+ * to the receiver by the value of their TICKERTAPE or Group field, so
+ * this is only suitable for subscriptions whose expression is of the
+ * form `TICKERTAPE == "name" || Group == "name"'.  Must be called
+ * before the receiver's connection is set. */
+void
+group_sub_set_mux(group_sub_t self, group_mux_t mux);
+
+
+/* Allocates and initializes a new group_mux_t */
+group_mux_t
+group_mux_alloc(void);
+
+
+/* Releases the resources used by the receiver.  Its members must
+ * already have been freed or had their connections cleared. */
+void
+group_mux_free(group_mux_t self);
+
+
+/* Brings the receiver's elvin subscriptions up to date with the
+ * connections, keys and expressions of its members.  Changes are
+ * batched until this is called. */
+void
+group_mux_sync(group_mux_t self);
+
+
 /* Registers the receiver with the control panel */
 void
 group_sub_set_control_panel(group_sub_t self, control_panel_t control_panel);
@@ -0,0 +1,227 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   The pool is a chained hash table keyed by string_hash().  Each
+ *   entry holds its string inline, so an interned string can find its
+ *   way back to its entry without a lookup when it is released.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h> /* NULL */
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h> /* calloc, free, malloc */
+#endif
+#include <stddef.h> /* offsetof */
+#ifdef HAVE_STRING_H
+# include <string.h> /* memcpy, strcmp, strlen */
+#endif
+#ifdef HAVE_ASSERT_H
+# include <assert.h> /* assert */
+#endif
+#include "replace.h"
+#include "globals.h"
+#include "utils.h"
+#include "intern.h"
+
+/* The initial number of slots in the table */
+#define INITIAL_SIZE 256
+
+/* A string in the pool */
+typedef struct entry *entry_t;
+
+struct entry {
+    /* The next entry in the same slot */
+    entry_t next;
+
+    /* The string's hash value */
+    unsigned long hash;
+
+    /* The number of references to the string */
+    unsigned long ref_count;
+
+    /* The size of the string, including its NUL terminator */
+    size_t size;
+
+    /* The string itself */
+    char string[1];
+};
+
+/* The hash table of entries */
+static entry_t *table;
+
+/* The number of slots in the table */
+static size_t table_size;
+
+/* The pool's statistics */
+static intern_stats_t stats;
+
+/* Answers the entry which holds an interned string */
+#define STRING_ENTRY(string) \
+    ((entry_t)((char *)(string) - offsetof(struct entry, string)))
+
+/* Doubles the size of the table (or creates it) */
+static int
+grow_table(void)
+{
+    size_t size = (table_size == 0) ? INITIAL_SIZE : table_size * 2;
+    entry_t *new_table;
+    entry_t entry;
+    size_t i;
+
+    new_table = calloc(size, sizeof(entry_t));
+    if (new_table == NULL) {
+        return -1;
+    }
+
+    /* Move the entries across */
+    for (i = 0; i < table_size; i++) {
+        while ((entry = table[i]) != NULL) {
+            table[i] = entry->next;
+            entry->next = new_table[entry->hash % size];
+            new_table[entry->hash % size] = entry;
+        }
+    }
+
+    if (table != NULL) {
+        free(table);
+    }
+
+    table = new_table;
+    table_size = size;
+    return 0;
+}
+
+/* Answers the pooled copy of string, adding a reference to it */
+const char *
+intern_string(const char *string)
+{
+    unsigned long hash;
+    entry_t entry;
+    size_t size;
+
+    if (string == NULL) {
+        return NULL;
+    }
+
+    stats.lookups++;
+
+    /* Look for an existing copy */
+    hash = string_hash(string);
+    if (table_size != 0) {
+        for (entry = table[hash % table_size];
+             entry != NULL;
+             entry = entry->next) {
+            if (entry->hash == hash && strcmp(entry->string, string) == 0) {
+                entry->ref_count++;
+                stats.hits++;
+                stats.bytes_saved += entry->size;
+                return entry->string;
+            }
+        }
+    }
+
+    /* Keep the chains short */
+    if (table_size <= stats.strings && grow_table() < 0) {
+        return NULL;
+    }
+
+    /* Add a new entry */
+    size = strlen(string) + 1;
+    entry = malloc(offsetof(struct entry, string) + size);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->hash = hash;
+    entry->ref_count = 1;
+    entry->size = size;
+    memcpy(entry->string, string, size);
+    entry->next = table[hash % table_size];
+    table[hash % table_size] = entry;
+
+    stats.strings++;
+    stats.bytes += size;
+    return entry->string;
+}
+
+/* Releases a reference to a string returned by intern_string */
+void
+intern_release(const char *string)
+{
+    entry_t entry;
+    entry_t *pointer;
+
+    if (string == NULL) {
+        return;
+    }
+
+    entry = STRING_ENTRY(string);
+    ASSERT(entry->ref_count != 0);
+
+    /* Keep the string while others still refer to it */
+    if (--entry->ref_count != 0) {
+        stats.bytes_saved -= entry->size;
+        return;
+    }
+
+    /* Unlink and free the entry */
+    pointer = &table[entry->hash % table_size];
+    while (*pointer != entry) {
+        pointer = &(*pointer)->next;
+    }
+    *pointer = entry->next;
+
+    stats.strings--;
+    stats.bytes -= entry->size;
+    free(entry);
+}
+
+/* Fills in stats with the current state of the pool */
+void
+intern_get_stats(intern_stats_t *stats_out)
+{
+    *stats_out = stats;
+}
+
+/**********************************************************************/
@@ -0,0 +1,87 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   A reference-counted pool of shared strings.  Strings which recur
+ *   in many messages (groups, users and the like) are kept once, so
+ *   they cost no extra memory per message and two interned strings
+ *   are equal exactly when their pointers are.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+/* Statistics about the string pool */
+typedef struct intern_stats {
+    /* The number of distinct strings in the pool */
+    unsigned long strings;
+
+    /* The number of calls to intern_string */
+    unsigned long lookups;
+
+    /* The number of lookups which found an existing string */
+    unsigned long hits;
+
+    /* The number of bytes used by the strings in the pool */
+    unsigned long bytes;
+
+    /* The number of bytes saved by sharing the strings */
+    unsigned long bytes_saved;
+} intern_stats_t;
+
+
+/* Answers the pooled copy of string, adding a reference to it.
+ * Returns NULL if string is NULL or if memory is exhausted. */
+const char *
+intern_string(const char *string);
+
+
+/* Releases a reference to a string returned by intern_string */
+void
+intern_release(const char *string);
+
+
+/* Fills in stats with the current state of the pool */
+void
+intern_get_stats(intern_stats_t *stats);
+
+
+#endif /* INTERN_H */
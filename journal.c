@@ -0,0 +1,846 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   The journal is a file containing a short header followed by a
+ *   sequence of records, one per message, each of which is written
+ *   with a single write() call.  A record looks like this:
+ *
+ *     magic (4 bytes)
+ *     payload length (4 bytes)
+ *     payload checksum (4 bytes)
+ *     payload:
+ *       creation time: seconds (8 bytes), microseconds (4 bytes)
+ *       timeout (4 bytes)
+ *       info, group, user, string, tag, id, reply_id, thread_id:
+ *         length (4 bytes, or 0xffffffff if NULL), bytes
+ *       attachment: length (4 bytes), bytes
+ *
+ *   All integers are in network byte order.  When the journal is
+ *   opened, its records are scanned to build an index of the most
+ *   recent ones and the file is truncated after the last good record
+ *   so that a record left half-written by a crash doesn't get in the
+ *   way of the ones which follow.  The journal is compacted by
+ *   copying its most recent records into a new file which is then
+ *   renamed over the old one.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h> /* fprintf, perror, rename, snprintf */
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h> /* calloc, free, malloc */
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h> /* memcmp, memcpy, strdup, strlen */
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h> /* close, fsync, ftruncate, read, unlink, write */
+#endif
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h> /* fstat, mmap, open */
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h> /* fstat, open */
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h> /* mmap, munmap */
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h> /* open */
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h> /* errno */
+#endif
+#ifdef HAVE_ASSERT_H
+# include <assert.h> /* assert */
+#endif
+#include "replace.h"
+#include "globals.h"
+#include "utils.h"
+#include "message.h"
+#include "journal.h"
+
+/* The bytes at the start of every journal file */
+#define JOURNAL_MAGIC "xtjrnl1\n"
+#define JOURNAL_MAGIC_SIZE (sizeof(JOURNAL_MAGIC) - 1)
+
+/* The bytes at the start of every record ("xtrc") */
+#define RECORD_MAGIC 0x78747263UL
+
+/* The size of a record's magic, length and checksum */
+#define RECORD_HEADER_SIZE 12
+
+/* The largest payload we're prepared to believe */
+#define RECORD_MAX_SIZE (16 * 1024 * 1024)
+
+/* The length used to record a NULL string */
+#define FIELD_NULL 0xffffffffUL
+
+/* The number of string fields in a record */
+#define FIELD_COUNT 8
+
+/* The suffix of the temporary file used for compaction */
+#define COMPACT_SUFFIX ".new"
+
+#if defined(DEBUG_MESSAGE)
+static const char *ref_journal = "journal";
+#endif /* DEBUG_MESSAGE */
+
+struct journal {
+    /* The name of the journal file */
+    char *filename;
+
+    /* The file descriptor of the journal file */
+    int fd;
+
+    /* The maximum number of messages to keep */
+    unsigned int capacity;
+
+    /* The size beyond which the journal is compacted */
+    size_t size_limit;
+
+    /* The size of the journal file */
+    size_t size;
+
+    /* A circular array of the offsets of the most recent records */
+    size_t *offsets;
+
+    /* The number of offsets in the array */
+    unsigned int count;
+
+    /* The index of the oldest offset in the array */
+    unsigned int index;
+};
+
+
+/* Computes a checksum (32-bit FNV-1a) of the given bytes */
+static unsigned long
+checksum(const unsigned char *data, size_t length)
+{
+    const unsigned char *end = data + length;
+    unsigned long hash = 2166136261UL;
+
+    while (data < end) {
+        hash ^= *data++;
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+
+    return hash;
+}
+
+/* Writes a 32-bit integer in network byte order */
+static void
+put_u32(unsigned char **point, unsigned long value)
+{
+    unsigned char *out = *point;
+
+    out[0] = (value >> 24) & 0xff;
+    out[1] = (value >> 16) & 0xff;
+    out[2] = (value >> 8) & 0xff;
+    out[3] = value & 0xff;
+    *point = out + 4;
+}
+
+/* Reads a 32-bit integer in network byte order */
+static unsigned long
+get_u32(const unsigned char *point)
+{
+    return ((unsigned long)point[0] << 24) |
+        ((unsigned long)point[1] << 16) |
+        ((unsigned long)point[2] << 8) |
+        (unsigned long)point[3];
+}
+
+/* Writes a length-prefixed field */
+static void
+put_field(unsigned char **point, const char *data, size_t length)
+{
+    if (data == NULL) {
+        put_u32(point, FIELD_NULL);
+        return;
+    }
+
+    put_u32(point, length);
+    memcpy(*point, data, length);
+    *point += length;
+}
+
+/* Reads a length-prefixed field, copying it into a NUL-terminated
+ * string in buffer.  Returns -1 if the field runs past end. */
+static int
+get_field(const unsigned char **point,
+          const unsigned char *end,
+          char **buffer,
+          const char **string_out,
+          size_t *length_out)
+{
+    unsigned long length;
+
+    if (end - *point < 4) {
+        return -1;
+    }
+
+    length = get_u32(*point);
+    *point += 4;
+
+    /* Watch for NULL fields */
+    if (length == FIELD_NULL) {
+        *string_out = NULL;
+        *length_out = 0;
+        return 0;
+    }
+
+    if ((unsigned long)(end - *point) < length) {
+        return -1;
+    }
+
+    /* Copy the bytes and NUL-terminate them */
+    memcpy(*buffer, *point, length);
+    (*buffer)[length] = '\0';
+    *string_out = *buffer;
+    *length_out = length;
+    *point += length;
+    *buffer += length + 1;
+    return 0;
+}
+
+/* Returns the size of the valid record starting at data, or 0 if
+ * there isn't one */
+static size_t
+record_check(const unsigned char *data, size_t avail)
+{
+    unsigned long length;
+
+    /* Make sure the header is complete and sane */
+    if (avail < RECORD_HEADER_SIZE || get_u32(data) != RECORD_MAGIC) {
+        return 0;
+    }
+
+    length = get_u32(data + 4);
+    if (RECORD_MAX_SIZE < length || avail - RECORD_HEADER_SIZE < length) {
+        return 0;
+    }
+
+    /* Make sure the payload was completely written */
+    if (checksum(data + RECORD_HEADER_SIZE, length) != get_u32(data + 8)) {
+        return 0;
+    }
+
+    return RECORD_HEADER_SIZE + length;
+}
+
+/* Encodes a message as a record.  The result must be freed. */
+static unsigned char *
+record_encode(message_t message, size_t *size_out)
+{
+    const char *fields[FIELD_COUNT];
+    size_t lengths[FIELD_COUNT];
+    const char *attachment;
+    size_t attachment_length;
+    unsigned long long when;
+    unsigned char *record;
+    unsigned char *point;
+    size_t length;
+    int i;
+
+    /* Collect the message's fields */
+    fields[0] = message_get_info(message);
+    fields[1] = message_get_group(message);
+    fields[2] = message_get_user(message);
+    fields[3] = message_get_string(message);
+    fields[4] = message_get_tag(message);
+    fields[5] = message_get_id(message);
+    fields[6] = message_get_reply_id(message);
+    fields[7] = message_get_thread_id(message);
+    attachment_length = message_get_raw_attachment(message, &attachment);
+
+    /* Measure the payload */
+    length = 8 + 4 + 4 + 4;
+    for (i = 0; i < FIELD_COUNT; i++) {
+        lengths[i] = (fields[i] == NULL) ? 0 : strlen(fields[i]);
+        length += 4 + lengths[i];
+    }
+
+    /* A record bigger than RECORD_MAX_SIZE would be taken for damage
+     * when the journal is next opened, and everything after it thrown
+     * away.  Leave out an attachment which would make it that big,
+     * and refuse the message if it's still too big without one. */
+    if (RECORD_MAX_SIZE - length < attachment_length) {
+        DPRINTF((1, "not journaling a %lu byte attachment\n",
+                 (unsigned long)attachment_length));
+        attachment_length = 0;
+    }
+
+    if (RECORD_MAX_SIZE < length) {
+        errno = EFBIG;
+        return NULL;
+    }
+
+    length += attachment_length;
+
+    /* Allocate room for the record */
+    record = malloc(RECORD_HEADER_SIZE + length);
+    if (record == NULL) {
+        return NULL;
+    }
+
+    /* Write the payload */
+    point = record + RECORD_HEADER_SIZE;
+    when = (unsigned long long)*message_get_creation_time(message);
+    put_u32(&point, (unsigned long)(when >> 32));
+    put_u32(&point, (unsigned long)(when & 0xffffffffUL));
+    put_u32(&point, message_get_creation_usec(message));
+    put_u32(&point, message_get_timeout(message));
+    for (i = 0; i < FIELD_COUNT; i++) {
+        put_field(&point, fields[i], lengths[i]);
+    }
+
+    put_u32(&point, attachment_length);
+    memcpy(point, attachment, attachment_length);
+    point += attachment_length;
+    ASSERT(point == record + RECORD_HEADER_SIZE + length);
+
+    /* And then the header */
+    point = record;
+    put_u32(&point, RECORD_MAGIC);
+    put_u32(&point, length);
+    put_u32(&point, checksum(record + RECORD_HEADER_SIZE, length));
+
+    *size_out = RECORD_HEADER_SIZE + length;
+    return record;
+}
+
+/* Decodes a record which has already been checked with record_check() */
+static message_t
+record_decode(const unsigned char *record)
+{
+    const unsigned char *point = record + RECORD_HEADER_SIZE;
+    const unsigned char *end = point + get_u32(record + 4);
+    const char *fields[FIELD_COUNT];
+    size_t lengths[FIELD_COUNT];
+    unsigned long long when;
+    unsigned long usec, timeout, attachment_length;
+    const unsigned char *attachment;
+    message_t message;
+    char *buffer;
+    char *out;
+    int i;
+
+    /* Read the fixed-size fields */
+    if (end - point < 16) {
+        return NULL;
+    }
+
+    when = ((unsigned long long)get_u32(point) << 32) | get_u32(point + 4);
+    usec = get_u32(point + 8);
+    timeout = get_u32(point + 12);
+    point += 16;
+
+    /* Allocate room for the strings and their terminators */
+    buffer = malloc(end - point + FIELD_COUNT);
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    /* Read the strings */
+    out = buffer;
+    for (i = 0; i < FIELD_COUNT; i++) {
+        if (get_field(&point, end, &out, &fields[i], &lengths[i]) < 0) {
+            free(buffer);
+            return NULL;
+        }
+    }
+
+    /* Read the attachment */
+    if (end - point < 4) {
+        free(buffer);
+        return NULL;
+    }
+
+    attachment_length = get_u32(point);
+    attachment = point + 4;
+    if ((unsigned long)(end - attachment) != attachment_length) {
+        free(buffer);
+        return NULL;
+    }
+
+    /* The group, user and string are mandatory */
+    if (fields[1] == NULL || fields[2] == NULL || fields[3] == NULL) {
+        free(buffer);
+        return NULL;
+    }
+
+    /* Construct the message */
+    message = message_alloc(fields[0], fields[1], fields[2], fields[3],
+                            timeout, (const char *)attachment,
+                            attachment_length, fields[4], fields[5],
+                            fields[6], fields[7]);
+    free(buffer);
+    if (message == NULL) {
+        return NULL;
+    }
+
+    /* It was created when it was originally received */
+    message_set_creation_time(message, (time_t)when, (long)usec);
+    return message;
+}
+
+/* Maps the first length bytes of the file into memory */
+static unsigned char *
+map_file(int fd, size_t length)
+{
+#if defined(HAVE_MMAP)
+    void *data;
+
+    data = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    return data;
+#else /* !HAVE_MMAP */
+    unsigned char *data;
+    size_t offset = 0;
+    ssize_t count;
+
+    /* Read the file into a buffer instead */
+    data = malloc(length);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    if (lseek(fd, 0, SEEK_SET) < 0) {
+        free(data);
+        return NULL;
+    }
+
+    while (offset < length) {
+        count = read(fd, data + offset, length - offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (count <= 0) {
+            free(data);
+            return NULL;
+        }
+
+        offset += count;
+    }
+
+    return data;
+#endif /* HAVE_MMAP */
+}
+
+/* Releases memory obtained with map_file() */
+static void
+unmap_file(unsigned char *data, size_t length)
+{
+#if defined(HAVE_MMAP)
+    munmap(data, length);
+#else /* !HAVE_MMAP */
+    free(data);
+#endif /* HAVE_MMAP */
+}
+
+/* Writes all of the bytes to the file */
+static int
+write_fully(int fd, const unsigned char *data, size_t length)
+{
+    ssize_t count;
+
+    while (length != 0) {
+        count = write(fd, data, length);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        data += count;
+        length -= count;
+    }
+
+    return 0;
+}
+
+/* Records the offset of a record in the index, forgetting the oldest
+ * one if the index is full */
+static void
+journal_index_add(journal_t self, size_t offset)
+{
+    if (self->count < self->capacity) {
+        self->offsets[(self->index + self->count++) % self->capacity] = offset;
+    } else {
+        self->offsets[self->index] = offset;
+        self->index = (self->index + 1) % self->capacity;
+    }
+}
+
+/* Scans the records in the journal, indexing the valid ones.  Answers
+ * the offset just past the last valid record. */
+static size_t
+journal_scan(journal_t self, const unsigned char *data, size_t length)
+{
+    size_t offset = JOURNAL_MAGIC_SIZE;
+    size_t size;
+
+    while (offset < length) {
+        size = record_check(data + offset, length - offset);
+        if (size == 0) {
+            break;
+        }
+
+        journal_index_add(self, offset);
+        offset += size;
+    }
+
+    return offset;
+}
+
+/* Starts a new, empty journal in the journal file */
+static int
+journal_reset(journal_t self)
+{
+    if (ftruncate(self->fd, 0) < 0 ||
+        write_fully(self->fd, (const unsigned char *)JOURNAL_MAGIC,
+                    JOURNAL_MAGIC_SIZE) < 0) {
+        return -1;
+    }
+
+    self->size = JOURNAL_MAGIC_SIZE;
+    self->count = 0;
+    self->index = 0;
+    return 0;
+}
+
+/* Rewrites the journal so that it contains only its most recent
+ * records, using no more than half of its size limit so that we
+ * don't need to compact it again right away.  The newest record is
+ * always kept, even if it's too big on its own. */
+int
+journal_compact(journal_t self)
+{
+    unsigned char *data;
+    char *filename;
+    size_t length;
+    size_t start;
+    int fd;
+
+    DPRINTF((1, "compacting journal %s (%lu bytes)\n",
+             self->filename, (unsigned long)self->size));
+
+    /* Don't bother if it's already as small as it can get */
+    if (self->count == 0 || (self->count == 1 &&
+                             self->offsets[self->index] ==
+                             JOURNAL_MAGIC_SIZE)) {
+        return 0;
+    }
+
+    /* Forget the records which don't fit, but never the newest */
+    while (self->count > 1 &&
+           self->size_limit / 2 <
+           JOURNAL_MAGIC_SIZE + self->size - self->offsets[self->index]) {
+        self->index = (self->index + 1) % self->capacity;
+        self->count--;
+    }
+
+    /* The records we're keeping are all at the end of the file */
+    start = self->offsets[self->index];
+    length = self->size - start;
+
+    /* Construct the name of the new journal file */
+    filename = malloc(strlen(self->filename) + sizeof(COMPACT_SUFFIX));
+    if (filename == NULL) {
+        return -1;
+    }
+
+    strcpy(filename, self->filename);
+    strcat(filename, COMPACT_SUFFIX);
+
+    /* Map in the old one */
+    data = map_file(self->fd, self->size);
+    if (data == NULL) {
+        free(filename);
+        return -1;
+    }
+
+    /* Write the new journal */
+    fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0600);
+    if (fd < 0) {
+        unmap_file(data, self->size);
+        free(filename);
+        return -1;
+    }
+
+    if (write_fully(fd, (const unsigned char *)JOURNAL_MAGIC,
+                    JOURNAL_MAGIC_SIZE) < 0 ||
+        write_fully(fd, data + start, length) < 0 ||
+        fsync(fd) < 0 ||
+        rename(filename, self->filename) < 0) {
+        close(fd);
+        unlink(filename);
+        unmap_file(data, self->size);
+        free(filename);
+        return -1;
+    }
+
+    unmap_file(data, self->size);
+    free(filename);
+
+    /* Switch over to the new file */
+    close(self->fd);
+    self->fd = fd;
+    self->size = JOURNAL_MAGIC_SIZE + length;
+
+    /* Everything has moved */
+    self->count = 0;
+    self->index = 0;
+    data = map_file(self->fd, self->size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    journal_scan(self, data, self->size);
+    unmap_file(data, self->size);
+    return 0;
+}
+
+/* Opens the journal in the named file */
+journal_t
+journal_alloc(const char *filename,
+              unsigned int capacity,
+              size_t size_limit)
+{
+    journal_t self;
+    unsigned char *data;
+    struct stat statbuf;
+    size_t end;
+
+    /* Allocate memory for the journal */
+    self = malloc(sizeof(struct journal));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->capacity = MAX(capacity, 1);
+    self->size_limit = size_limit;
+    self->size = 0;
+    self->count = 0;
+    self->index = 0;
+
+    self->filename = strdup(filename);
+    if (self->filename == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    self->offsets = calloc(self->capacity, sizeof(size_t));
+    if (self->offsets == NULL) {
+        free(self->filename);
+        free(self);
+        return NULL;
+    }
+
+    /* Open the journal file */
+    self->fd = open(filename, O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (self->fd < 0 || fstat(self->fd, &statbuf) < 0) {
+        journal_free(self);
+        return NULL;
+    }
+
+    self->size = statbuf.st_size;
+
+    /* Start a new journal if there's no valid one already */
+    if (self->size < JOURNAL_MAGIC_SIZE) {
+        if (journal_reset(self) < 0) {
+            journal_free(self);
+            return NULL;
+        }
+
+        return self;
+    }
+
+    /* Index its records */
+    data = map_file(self->fd, self->size);
+    if (data == NULL) {
+        journal_free(self);
+        return NULL;
+    }
+
+    if (memcmp(data, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "%s: warning: %s is not a journal file; "
+                "starting a new one\n", progname, filename);
+        unmap_file(data, self->size);
+        if (journal_reset(self) < 0) {
+            journal_free(self);
+            return NULL;
+        }
+
+        return self;
+    }
+
+    end = journal_scan(self, data, self->size);
+    unmap_file(data, self->size);
+
+    /* Discard anything after the last good record */
+    if (end < self->size) {
+        fprintf(stderr, "%s: warning: discarding %lu damaged bytes at "
+                "the end of %s\n", progname,
+                (unsigned long)(self->size - end), filename);
+        if (ftruncate(self->fd, end) < 0) {
+            journal_free(self);
+            return NULL;
+        }
+
+        self->size = end;
+    }
+
+    /* Make sure we start out under the size limit */
+    if (self->size_limit < self->size && journal_compact(self) < 0) {
+        journal_free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+/* Closes the journal and frees its resources */
+void
+journal_free(journal_t self)
+{
+    if (0 <= self->fd) {
+        close(self->fd);
+    }
+
+    free(self->offsets);
+    free(self->filename);
+    free(self);
+}
+
+/* Calls callback for each of the most recent messages in the journal */
+int
+journal_replay(journal_t self, journal_callback_t callback, void *rock)
+{
+    unsigned char *data;
+    message_t message;
+    unsigned int i;
+
+    /* Bail if there's nothing to do */
+    if (self->count == 0) {
+        return 0;
+    }
+
+    /* Map in the journal */
+    data = map_file(self->fd, self->size);
+    if (data == NULL) {
+        return -1;
+    }
+
+    /* Decode each indexed record and pass it along */
+    for (i = 0; i < self->count; i++) {
+        message = record_decode(
+            data + self->offsets[(self->index + i) % self->capacity]);
+        if (message == NULL) {
+            continue;
+        }
+
+        MESSAGE_ALLOC_REF(message, ref_journal, self);
+        callback(rock, message);
+        MESSAGE_FREE_REF(message, ref_journal, self);
+    }
+
+    unmap_file(data, self->size);
+    return 0;
+}
+
+/* Appends a message to the journal */
+int
+journal_append(journal_t self, message_t message)
+{
+    unsigned char *record;
+    size_t size;
+
+    /* Encode the message, quietly skipping it if it's too big */
+    record = record_encode(message, &size);
+    if (record == NULL) {
+        return errno == EFBIG ? 0 : -1;
+    }
+
+    /* Write it out in one go.  If that fails then make sure we don't
+     * leave part of it behind. */
+    if (write_fully(self->fd, record, size) < 0) {
+        free(record);
+        if (ftruncate(self->fd, self->size) < 0) {
+            perror("ftruncate() failed");
+        }
+
+        return -1;
+    }
+
+    free(record);
+
+    /* Index it */
+    journal_index_add(self, self->size);
+    self->size += size;
+    return 0;
+}
+
+/* Answers non-zero if the journal has grown big enough to need
+ * compacting */
+int
+journal_needs_compacting(journal_t self)
+{
+    size_t newest;
+
+    if (self->size <= self->size_limit || self->count == 0) {
+        return 0;
+    }
+
+    /* The newest record is always kept, so compacting only helps if
+     * there's something in front of it */
+    newest = self->offsets[(self->index + self->count - 1) % self->capacity];
+    return JOURNAL_MAGIC_SIZE < newest;
+}
@@ -0,0 +1,100 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   An append-only on-disk journal of received messages, from which
+ *   the most recent messages can be restored when xtickertape is
+ *   restarted.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "message.h"
+
+/* The journal data type */
+typedef struct journal *journal_t;
+
+/* The type of function called for each message restored from the
+ * journal */
+typedef void (*journal_callback_t)(void *rock, message_t message);
+
+
+/* Opens the journal in the named file, creating it if necessary.  Any
+ * incomplete or damaged records at the end of the file (say, from a
+ * crash) are discarded.  The journal remembers the last capacity
+ * messages and should be compacted whenever it grows beyond
+ * size_limit bytes. */
+journal_t
+journal_alloc(const char *filename,
+              unsigned int capacity,
+              size_t size_limit);
+
+
+/* Closes the journal and frees its resources */
+void
+journal_free(journal_t self);
+
+
+/* Calls callback for each of the most recent messages in the journal,
+ * oldest first */
+int
+journal_replay(journal_t self, journal_callback_t callback, void *rock);
+
+
+/* Appends a message to the journal.  This never compacts the journal;
+ * see journal_needs_compacting. */
+int
+journal_append(journal_t self, message_t message);
+
+
+/* Answers non-zero if the journal has grown beyond its size limit and
+ * compacting it would make it smaller */
+int
+journal_needs_compacting(journal_t self);
+
+
+/* Rewrites the journal so that it holds only its most recent records
+ * (always including the newest) */
+int
+journal_compact(journal_t self);
+
+#endif /* JOURNAL_H */
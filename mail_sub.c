@@ -53,6 +53,7 @@
 #include "replace.h"
 #include "message.h"
 #include "mbox_parser.h"
+#include "notify_fields.h"
 #include "mail_sub.h"
 #include "utils.h"
 
@@ -172,6 +173,38 @@ notify_cb(elvin_handle_t handle,
     }
 }
 #elif ELVIN_VERSION_AT_LEAST(4, 1, -1)
+/* The indices of the fields extracted from notifications */
+enum {
+    FIELD_FROM,
+    FIELD_FOLDER,
+    FIELD_SUBJECT,
+    FIELD_COUNT
+};
+
+/* The names of the fields extracted from notifications */
+static const char *const field_names[FIELD_COUNT] = {
+    F_FROM,
+    F_FOLDER,
+    F_SUBJECT
+};
+
+/* Returns the table used to extract fields from notifications */
+static notify_fields_t
+get_fields(void)
+{
+    static notify_fields_t fields = NULL;
+
+    if (fields == NULL) {
+        fields = notify_fields_alloc(field_names, FIELD_COUNT);
+        if (fields == NULL) {
+            perror("notify_fields_alloc failed");
+            exit(1);
+        }
+    }
+
+    return fields;
+}
+
 /* Delivers a notification which matches the receiver's e-mail subscription */
 static int
 notify_cb(elvin_handle_t handle,
@@ -182,6 +215,7 @@ notify_cb(elvin_handle_t handle,
           elvin_error_t error)
 {
     mail_sub_t self = (mail_sub_t)rock;
+    notify_value_t values[FIELD_COUNT];
     message_t message;
     char *value;
     const char *from;
@@ -189,17 +223,18 @@ notify_cb(elvin_handle_t handle,
     const char *subject;
     char *buffer = NULL;
     size_t length;
-    int found;
 
-    /* Get the name from the `From' field */
-    if (!elvin_notification_get_string(notification, F_FROM, &found, &value,
-                                       error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
+    /* Pull all of the fields we're interested in out of the
+     * notification in one go */
+    if (!notify_fields_extract(get_fields(), notification, values, error)) {
+        eeprintf(error, "elvin_notification_traverse failed\n");
         exit(1);
     }
 
+    /* Get the name from the `From' field */
+    value = notify_value_string(&values[FIELD_FROM]);
     from = "anonymous";
-    if (found) {
+    if (value != NULL) {
         /* Split the user name from the address */
         if (mbox_parser_parse(self->parser, value) == 0) {
             from = mbox_parser_get_name(self->parser);
@@ -211,14 +246,9 @@ notify_cb(elvin_handle_t handle,
     }
 
     /* Get the folder field */
-    if (!elvin_notification_get_string(notification, F_FOLDER, NULL, &value,
-                                       error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
-
+    value = notify_value_string(&values[FIELD_FOLDER]);
     folder = "mail";
-    if (found) {
+    if (value != NULL) {
         /* Format the folder name to use as the group */
         length = strlen(FOLDER_FMT) + strlen(value) - 1;
         buffer = malloc(length);
@@ -229,15 +259,11 @@ notify_cb(elvin_handle_t handle,
     }
 
     /* Get the subject field */
-    if (!elvin_notification_get_string(notification, F_SUBJECT, &found,
-                                       &value, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
+    value = notify_value_string(&values[FIELD_SUBJECT]);
 
     /* Have a default subject */
     subject = "[No subject]";
-    if (found) {
+    if (value != NULL) {
         subject = value;
     }
 
@@ -86,6 +86,8 @@
 #include "globals.h"
 #include "replace.h"
 #include "message.h"
+#include "intern.h"
+#include "slab.h"
 #include "tickertape.h"
 #include "utils.h"
 
@@ -203,6 +205,14 @@ usage(int argc, char *argv[])
 #define XtCMetamail "Metamail"
 #define XtNsendHistoryCapacity "sendHistoryCapacity"
 #define XtCSendHistoryCapacity "SendHistoryCapacity"
+#define XtNjournalCapacity "journalCapacity"
+#define XtCJournalCapacity "JournalCapacity"
+#define XtNjournalSize "journalSize"
+#define XtCJournalSize "JournalSize"
+#define XtNmaxViewers "maxViewers"
+#define XtCMaxViewers "MaxViewers"
+#define XtNmergeGroups "mergeGroups"
+#define XtCMergeGroups "MergeGroups"
 
 /* The application shell window also has resources */
 #define offset(field) XtOffsetOf(XTickertapeRec, field)
@@ -224,6 +234,30 @@ static XtResource resources[] =
     {
         XtNsendHistoryCapacity, XtCSendHistoryCapacity, XtRInt, sizeof(int),
         offset(send_history_count), XtRImmediate, (XtPointer)8
+    },
+
+    /* Cardinal journalCapacity */
+    {
+        XtNjournalCapacity, XtCJournalCapacity, XtRInt, sizeof(int),
+        offset(journal_capacity), XtRImmediate, (XtPointer)64
+    },
+
+    /* Cardinal journalSize */
+    {
+        XtNjournalSize, XtCJournalSize, XtRInt, sizeof(int),
+        offset(journal_size), XtRImmediate, (XtPointer)1048576
+    },
+
+    /* Cardinal maxViewers */
+    {
+        XtNmaxViewers, XtCMaxViewers, XtRInt, sizeof(int),
+        offset(max_viewers), XtRImmediate, (XtPointer)4
+    },
+
+    /* Boolean mergeGroups */
+    {
+        XtNmergeGroups, XtCMergeGroups, XtRBoolean, sizeof(Boolean),
+        offset(merge_groups), XtRImmediate, (XtPointer)False
     }
 };
 #undef offset
@@ -231,6 +265,9 @@ static XtResource resources[] =
 /* The Tickertape */
 static tickertape_t tickertape;
 
+/* The id with which SIGUSR1 is passed to the main loop */
+static XtSignalId leaks_signal;
+
 #if defined(ELVIN_VERSION_AT_LEAST)
 # if ELVIN_VERSION_AT_LEAST(4, 1, -1)
 /* The global elvin client information */
@@ -567,16 +604,28 @@ reload_subs(int signum)
     tickertape_reload_all(tickertape);
 }
 
-#ifdef USE_VALGRIND
-/* Signal handler which invokes valgrind magic. */
+/* Signal handler for SIGUSR1.  Printing the report isn't
+ * async-signal-safe, so just ask the main loop to do it. */
 static RETSIGTYPE
-count_leaks(int signum)
+notice_count_leaks(int signum)
 {
-    unsigned long leaked, dubious, reachable, suppressed;
-
     /* Put the signal handler back in place */
-    signal(signum, count_leaks);
+    signal(signum, notice_count_leaks);
 
+    XtNoticeSignal(leaks_signal);
+}
+
+/* Called from the main loop after a SIGUSR1 to report memory usage
+ * and, when running under valgrind, invoke valgrind magic. */
+static void
+count_leaks(XtPointer rock, XtSignalId *id)
+{
+#ifdef USE_VALGRIND
+    unsigned long leaked, dubious, reachable, suppressed;
+#endif /* USE_VALGRIND */
+    intern_stats_t stats;
+
+#ifdef USE_VALGRIND
     /* Run a leak check */
     VALGRIND_DO_LEAK_CHECK;
 
@@ -585,9 +634,25 @@ count_leaks(int signum)
     fprintf(stderr, "%s: valgrind: leaked=%lu, dubious=%lu, reachable=%lu, "
             "suppressed=%lu\n", progname, leaked, dubious, reachable,
             suppressed);
-}
 #endif /* USE_VALGRIND */
 
+    /* Report how well the string pool is doing. */
+    intern_get_stats(&stats);
+    fprintf(stderr, "%s: intern: strings=%lu, bytes=%lu, lookups=%lu, "
+            "hits=%lu (%lu%%), saved=%lu\n", progname, stats.strings,
+            stats.bytes, stats.lookups, stats.hits,
+            (stats.lookups == 0) ? 0 : stats.hits * 100 / stats.lookups,
+            stats.bytes_saved);
+
+    /* And how many objects of each type are in use. */
+    slab_report(stderr, progname);
+
+    /* And how smoothly the scroller is running. */
+    if (tickertape != NULL) {
+        tickertape_debug(tickertape);
+    }
+}
+
 /* Print an error message indicating that the app-defaults file is bogus */
 static void
 app_defaults_version_error(const char *message)
@@ -773,10 +838,9 @@ main(int argc, char *argv[])
     /* Set up SIGHUP to reload the subscriptions */
     signal(SIGHUP, reload_subs);
 
-#ifdef USE_VALGRIND
-    /* Set up SIGUSR1 to invoke valgrind. */
-    signal(SIGUSR1, count_leaks);
-#endif /* USE_VALGRIND */
+    /* Set up SIGUSR1 to report memory usage. */
+    leaks_signal = XtAppAddSignal(context, count_leaks, NULL);
+    signal(SIGUSR1, notice_count_leaks);
 
 #ifdef HAVE_LIBXMU
     /* Enable editres support */
@@ -63,6 +63,8 @@
 #include "globals.h"
 #include "ref.h"
 #include "utils.h"
+#include "intern.h"
+#include "slab.h"
 #include "message.h"
 
 /* The number of bytes required to hold a timestamp string, not
@@ -70,9 +72,12 @@
 #define TIMESTAMP_SIZE (sizeof("YYYY-MM-DDTHH:MM:SS.uuuuuu+HHMM"))
 #define TIMESTAMP_LEN (TIMESTAMP_SIZE - 1)
 
-#ifdef DEBUG
-static long message_count;
+/* The smallest and largest message_t size classes.  Messages with
+ * large attachments are allocated with malloc. */
+#define MESSAGE_MIN_SIZE 128
+#define MESSAGE_MAX_SIZE 4096
 
+#ifdef DEBUG
 # define MESSAGE_DEBUG(level, message) message_debug(level, message)
 
 static void
@@ -92,16 +97,20 @@ struct message {
     int ref_count;
 #endif /* DEBUG_MESSAGE */
 
+    /* The number of bytes allocated for the receiver */
+    size_t size;
+
     /* The time when the message was created */
     struct timeval creation_time;
 
-    /* A string which identifies the subscription info in the control panel */
+    /* A string which identifies the subscription info in the control
+     * panel (interned) */
     const char *info;
 
-    /* The receiver's group */
+    /* The receiver's group (interned) */
     const char *group;
 
-    /* The receiver's user */
+    /* The receiver's user (interned) */
     const char *user;
 
     /* The receiver's string (tickertext) */
@@ -119,7 +128,8 @@ struct message {
     /* The identifier for the message for which this is a reply */
     const char *reply_id;
 
-    /* The identifier for the thread for which this is a reply */
+    /* The identifier for the thread for which this is a reply
+     * (interned) */
     const char *thread_id;
 
     /* Non-zero if the message has been killed */
@@ -131,6 +141,9 @@ struct message {
     /* The length of the receiver's MIME attachment */
     size_t length;
 
+    /* Non-zero once the attachment's header has been cleansed */
+    int is_cleansed;
+
     /* The buffer in which the actual string data is kept. */
     char data[1];
 };
@@ -191,7 +204,12 @@ static const struct escape_seq escapes[32] = {
     DECLARE_ESC("\\037")
 };
 
-/* Copies a MIME attachment, replacing \r or \r\n in the header with \n */
+/* The slab from which messages are allocated */
+static slab_t message_slab;
+
+/* Copies a MIME attachment, replacing \r or \r\n in the header with
+ * \n.  The copy is never longer than the original, so copy may be
+ * the same as attachment. */
 static void
 cleanse_header(const char *attachment,
                size_t length,
@@ -206,7 +224,7 @@ cleanse_header(const char *attachment,
 
     /* Go through one character at a time */
     state = ST_START;
-    for (in = attachment; in < end; in++) {
+    for (in = attachment; in < end && state != ST_BODY; in++) {
         ch = *in;
 
         switch (state) {
@@ -260,15 +278,17 @@ cleanse_header(const char *attachment,
 
             break;
 
-        case ST_BODY:
-            *out++ = ch;
-            break;
-
         default:
             abort();
         }
     }
 
+    /* Copy the body verbatim */
+    if (in < end) {
+        memmove(out, in, end - in);
+        out += end - in;
+    }
+
     *length_out = out - copy;
 }
 
@@ -343,6 +363,33 @@ cook_string(const char *string, char **buffer)
     *buffer = out;
 }
 
+/* Releases the receiver's references to interned strings */
+static void
+release_strings(message_t self)
+{
+    intern_release(self->info);
+    intern_release(self->group);
+    intern_release(self->user);
+    intern_release(self->thread_id);
+}
+
+/* Cleans up the attachment's linefeeds for metamail if we haven't
+ * already done so */
+static void
+cleanse_attachment(message_t self)
+{
+    if (self->is_cleansed) {
+        return;
+    }
+
+    if (self->attachment != NULL) {
+        cleanse_header(self->attachment, self->length,
+                       (char *)self->attachment, &self->length);
+    }
+
+    self->is_cleansed = 1;
+}
+
 static char *
 append_data(char **point, const char *string, size_t size)
 {
@@ -372,8 +419,7 @@ message_alloc(const char *info,
               const char *thread_id)
 {
     message_t self;
-    size_t info_size, group_size, user_size, string_size;
-    size_t tag_size, id_size, reply_size, thread_size, len;
+    size_t string_size, tag_size, id_size, reply_size, len;
     char *point;
 
     /* Make sure the mandatory fields have values. */
@@ -381,28 +427,36 @@ message_alloc(const char *info,
     ASSERT(user != NULL);
     ASSERT(string != NULL);
 
-    /* Measure each of the strings, including the NUL terminator. */
-    info_size = (info == NULL) ? 0 : strlen(info) + 1;
-    group_size = strlen(group) + 1;
-    user_size = strlen(user) + 1;
+    /* Measure each of the strings, including the NUL terminator.
+     * The info, group, user and thread_id strings recur in many
+     * messages, so they are shared through the intern pool rather
+     * than copied. */
     string_size = strlen(string) + 1;
     tag_size = (tag == NULL) ? 0 : strlen(tag) + 1;
     id_size = (id == NULL) ? 0 : strlen(id) + 1;
     reply_size = (reply_id == NULL) ? 0 : strlen(reply_id) + 1;
-    thread_size = (thread_id == NULL) ? 0 : strlen(thread_id) + 1;
 
     /* Compute the total number of bytes needed to hold all of the
      * string data. */
-    len = info_size + group_size + user_size + string_size + tag_size +
-        id_size + reply_size + thread_size + length;
+    len = string_size + tag_size + id_size + reply_size + length;
 
     /* Allocate space for the message_t, including space for all of
      * the strings. */
-    self = malloc(sizeof(struct message) + len - 1);
+    if (message_slab == NULL) {
+        message_slab = slab_alloc("message", MESSAGE_MIN_SIZE,
+                                  MESSAGE_MAX_SIZE);
+        if (message_slab == NULL) {
+            return NULL;
+        }
+    }
+
+    self = slab_get_sized(message_slab, sizeof(struct message) + len - 1);
     if (self == NULL) {
         return NULL;
     }
 
+    self->size = sizeof(struct message) + len - 1;
+
     /* Record the time the message was created. */
     if (gettimeofday(&self->creation_time, NULL) < 0) {
         perror("gettimeofday failed");
@@ -415,35 +469,44 @@ message_alloc(const char *info,
 #else /* !DEBUG_MESSAGE */
     self->ref_count = 0;
 #endif /* DEBUG_MESSAGE */
-    self->info = append_data(&point, info, info_size);
-    self->group = append_data(&point, group, group_size);
-    self->user = append_data(&point, user, user_size);
     self->string = append_data(&point, string, string_size);
     self->timeout = timeout;
     self->tag = append_data(&point, tag, tag_size);
     self->id = append_data(&point, id, id_size);
     self->reply_id = append_data(&point, reply_id, reply_size);
-    self->thread_id = append_data(&point, thread_id, thread_size);
     self->is_killed = 0;
 
+    /* Share the commonly repeated strings. */
+    self->info = intern_string(info);
+    self->group = intern_string(group);
+    self->user = intern_string(user);
+    self->thread_id = intern_string(thread_id);
+    if ((info != NULL && self->info == NULL) || self->group == NULL ||
+        self->user == NULL || (thread_id != NULL && self->thread_id == NULL)) {
+        release_strings(self);
+        slab_put_sized(message_slab, self, self->size);
+        return NULL;
+    }
+
     /* Check our addition. */
     ASSERT(point + length == self->data + len);
 
+    /* Copy the attachment as is.  Most are never looked at, so its
+     * linefeeds are only cleaned up when it's first asked for. */
     if (length == 0) {
         self->attachment = NULL;
         self->length = 0;
     } else {
-        /* Clean up the attachment's linefeeds for metamail. */
-        cleanse_header(attachment, length, point, &self->length);
-        self->attachment = point;
-        point += self->length;
+        self->attachment = append_data(&point, attachment, length);
+        self->length = length;
     }
+    self->is_cleansed = 0;
 
     /* Check our addition again. */
-    ASSERT(point <= self->data + len);
+    ASSERT(point == self->data + len);
 
-    DPRINTF((1, "allocated %zu bytes for message_t %p (%ld)\n",
-             sizeof(struct message) + len - 1, self, ++message_count));
+    DPRINTF((1, "allocated %zu bytes for message_t %p (%lu)\n",
+             self->size, self, slab_get_count(message_slab)));
     MESSAGE_DEBUG(1, self);
 
     return self;
@@ -476,9 +539,11 @@ message_free_ref(message_t self, const char *file, int line,
         return;
     }
 
-    DPRINTF((1, "freeing message_t %p (%ld):\n", self, --message_count));
     MESSAGE_DEBUG(1, self);
-    free(self);
+    release_strings(self);
+    slab_put_sized(message_slab, self, self->size);
+    DPRINTF((1, "freed message_t %p (%lu)\n", self,
+             slab_get_count(message_slab)));
 }
 #else /* !DEBUG_MESSAGE */
 void
@@ -489,9 +554,11 @@ message_free_ref(message_t self)
         return;
     }
 
-    DPRINTF((1, "freeing message_t %p (%ld):\n", self, --message_count));
     MESSAGE_DEBUG(1, self);
-    free(self);
+    release_strings(self);
+    slab_put_sized(message_slab, self, self->size);
+    DPRINTF((1, "freed message_t %p (%lu)\n", self,
+             slab_get_count(message_slab)));
 }
 #endif /* DEBUG_MESSAGE */
 
@@ -509,6 +576,21 @@ message_get_creation_time(message_t self)
     return &self->creation_time.tv_sec;
 }
 
+/* Answers the microseconds part of the receiver's creation time */
+long
+message_get_creation_usec(message_t self)
+{
+    return (long)self->creation_time.tv_usec;
+}
+
+/* Sets the receiver's creation time */
+void
+message_set_creation_time(message_t self, time_t when, long usec)
+{
+    self->creation_time.tv_sec = when;
+    self->creation_time.tv_usec = usec;
+}
+
 /* Answers the receiver's group */
 const char *
 message_get_group(message_t self)
@@ -554,6 +636,17 @@ message_has_attachment(message_t self)
 /* Answers the receiver's MIME arguments */
 size_t
 message_get_attachment(message_t self, const char **attachment_out)
+{
+    cleanse_attachment(self);
+    *attachment_out = self->attachment;
+    return self->length;
+}
+
+/* Answers the receiver's MIME arguments as they arrived, without
+ * cleaning up their linefeeds.  Cleansing is idempotent, so these
+ * may be used to reconstruct the message. */
+size_t
+message_get_raw_attachment(message_t self, const char **attachment_out)
 {
     *attachment_out = self->attachment;
     return self->length;
@@ -563,11 +656,16 @@ message_get_attachment(message_t self, const char **attachment_out)
 int
 message_decode_attachment(message_t self, char **type_out, char **body_out)
 {
-    const char *point = self->attachment;
-    const char *mark = point;
-    const char *end = point + self->length;
+    const char *point;
+    const char *mark;
+    const char *end;
     size_t ct_length = sizeof(CONTENT_TYPE) - 1;
 
+    cleanse_attachment(self);
+    point = self->attachment;
+    mark = point;
+    end = point + self->length;
+
     *type_out = NULL;
     *body_out = NULL;
 
@@ -848,6 +946,8 @@ message_part_to_string(message_part_t part)
 size_t
 message_part_size(message_t self, message_part_t part)
 {
+    cleanse_attachment(self);
+
     switch (part) {
     case MSGPART_NONE:
         return 0;
@@ -880,6 +980,8 @@ char *
 message_get_part(message_t self, message_part_t part,
                  char *buffer, size_t buflen)
 {
+    cleanse_attachment(self);
+
     switch (part) {
     case MSGPART_NONE:
         return NULL;
@@ -107,7 +107,8 @@ void
 message_free_ref(message_t self);
 #endif /* DEBUG_MESSAGE */
 
-/* Answers the Subscription info for the receiver's subscription */
+/* Answers the Subscription info for the receiver's subscription.
+ * The string is interned (see intern.h). */
 const char *
 message_get_info(message_t self);
 
@@ -116,13 +117,22 @@ message_get_info(message_t self);
 time_t *
 message_get_creation_time(message_t self);
 
+/* Answers the microseconds part of the receiver's creation time */
+long
+message_get_creation_usec(message_t self);
 
-/* Answers the receiver's group */
+/* Sets the receiver's creation time.  This is used when restoring
+ * messages which were received in a previous session. */
+void
+message_set_creation_time(message_t self, time_t when, long usec);
+
+
+/* Answers the receiver's group (interned) */
 const char *
 message_get_group(message_t self);
 
 
-/* Answers the receiver's user */
+/* Answers the receiver's user (interned) */
 const char *
 message_get_user(message_t self);
 
@@ -152,6 +162,12 @@ size_t
 message_get_attachment(message_t self, const char **attachment_out);
 
 
+/* Answers the length of the attachment and a pointer to its bytes
+ * without cleaning up their linefeeds */
+size_t
+message_get_raw_attachment(message_t self, const char **attachment_out);
+
+
 /* Decodes the attachment into a content type, character set and body */
 int
 message_decode_attachment(message_t self, char **type_out, char **body_out);
@@ -172,7 +188,8 @@ const char *
 message_get_reply_id(message_t self);
 
 
-/* Answers the thread id of the message for which this is a reply */
+/* Answers the thread id of the message for which this is a reply
+ * (interned) */
 const char *
 message_get_thread_id(message_t self);
 
@@ -63,6 +63,7 @@
 #include "message.h"
 #include "utf8.h"
 #include "utils.h"
+#include "slab.h"
 #include "message_view.h"
 
 #define SEPARATOR ":"
@@ -71,6 +72,9 @@
 #define TIMESTAMP_FORMAT "%2d:%02d%s"
 #define TIMESTAMP_SIZE 8
 
+/* The number of formatted timestamps to remember */
+#define TIMESTAMP_CACHE_SIZE 16
+
 #if !defined(MIN)
 # define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #endif
@@ -99,9 +103,6 @@ struct message_view {
     /* The width of the longest timestamp (12:00pm) */
     long noon_width;
 
-    /* The timestamp as a string */
-    char timestamp[TIMESTAMP_SIZE];
-
     /* Dimensions of the time string */
     struct string_sizes timestamp_sizes;
 
@@ -116,8 +117,41 @@ struct message_view {
 
     /* Dimensions of the separator string */
     struct string_sizes separator_sizes;
+
+    /* The timestamp transcoded into the font's code set (shared) */
+    utf8_text_t timestamp_text;
+
+    /* The group string transcoded into the font's code set */
+    utf8_text_t group_text;
+
+    /* The user string transcoded into the font's code set */
+    utf8_text_t user_text;
+
+    /* The message string transcoded into the font's code set */
+    utf8_text_t message_text;
+
+    /* The separator string transcoded into the font's code set (shared) */
+    utf8_text_t separator_text;
 };
 
+/* A timestamp formatted for a given minute */
+struct timestamp_entry {
+    /* Non-zero if the entry has been filled in */
+    int is_valid;
+
+    /* The minute, counted from the epoch */
+    time_t minute;
+
+    /* The formatted timestamp */
+    char string[TIMESTAMP_SIZE];
+};
+
+/* The most recently formatted timestamps, indexed by minute */
+static struct timestamp_entry timestamp_cache[TIMESTAMP_CACHE_SIZE];
+
+/* The slab from which message_views are allocated */
+static slab_t message_view_slab;
+
 #if defined(DEBUG_MESSAGE)
 static const char *ref_message_view = "message_view";
 #endif /* DEBUG_MESSAGE */
@@ -140,6 +174,58 @@ rect_overlaps(XRectangle *rect, long left, long top, long right, long bottom)
     return 1;
 }
 
+/* Returns the timestamp string for a time.  Messages tend to arrive
+ * in bursts, so the last few minutes' strings are remembered rather
+ * than calling localtime() and snprintf() for every message. */
+static const char *
+format_timestamp(const time_t *when)
+{
+    struct timestamp_entry *entry;
+    struct tm *timestamp;
+    time_t minute;
+
+    /* Look for the minute in the cache */
+    minute = *when / 60;
+    entry = &timestamp_cache[(unsigned long)minute % TIMESTAMP_CACHE_SIZE];
+    if (entry->is_valid && entry->minute == minute) {
+        return entry->string;
+    }
+
+    /* Not there.  Get the time of day */
+    timestamp = localtime(when);
+    if (timestamp == NULL) {
+        perror("localtime(): failed");
+        exit(1);
+    }
+
+    /* Convert that into a string */
+    snprintf(entry->string, TIMESTAMP_SIZE, TIMESTAMP_FORMAT,
+             ((timestamp->tm_hour + 11) % 12) + 1,
+             timestamp->tm_min,
+             timestamp->tm_hour / 12 != 1 ? "am" : "pm");
+    entry->minute = minute;
+    entry->is_valid = 1;
+    return entry->string;
+}
+
+/* Returns the sizes of a string transcoded once and shared by
+ * everyone using the renderer */
+static void
+get_shared_sizes(utf8_renderer_t renderer,
+                 const char *string,
+                 string_sizes_t sizes)
+{
+    utf8_text_t text;
+
+    text = utf8_renderer_transcode_shared(renderer, string);
+    if (text == NULL) {
+        utf8_renderer_measure_string(renderer, string, sizes);
+        return;
+    }
+
+    utf8_text_get_sizes(text, sizes);
+}
+
 /* Draws a string in the appropriate color with optional underline */
 static void
 paint_string(Display *display,
@@ -151,7 +237,7 @@ paint_string(Display *display,
              XRectangle *bbox,
              string_sizes_t sizes,
              utf8_renderer_t renderer,
-             const char *string,
+             utf8_text_t text,
              Bool has_underline)
 {
     XGCValues values;
@@ -170,8 +256,7 @@ paint_string(Display *display,
         XChangeGC(display, gc, GCForeground, &values);
 
         /* Draw the string */
-        utf8_renderer_draw_string(display, drawable, gc, renderer,
-                                  x, y, bbox, string);
+        utf8_text_draw(display, drawable, gc, text, x, y, bbox);
 
         /* Draw the underline */
         if (has_underline) {
@@ -181,19 +266,60 @@ paint_string(Display *display,
     }
 }
 
+/* Renders a string into a client-side image in the appropriate color
+ * with optional underline */
+static void
+render_string(Display *display,
+              Drawable drawable,
+              XImage *image,
+              unsigned long pixel,
+              long x,
+              long y,
+              XRectangle *bbox,
+              string_sizes_t sizes,
+              utf8_renderer_t renderer,
+              utf8_text_t text,
+              Bool has_underline)
+{
+    /* Is the string visible? */
+    if (rect_overlaps(bbox,
+                      x + sizes->lbearing, y - sizes->ascent,
+                      x + sizes->rbearing, y + sizes->descent) ||
+        (has_underline && rect_overlaps(bbox,
+                                        x, y - sizes->ascent,
+                                        x + sizes->width,
+                                        y + sizes->descent))) {
+        /* Draw the string */
+        utf8_text_render(display, drawable, image, text, pixel, x, y, bbox);
+
+        /* Draw the underline */
+        if (has_underline) {
+            utf8_renderer_render_underline(renderer, image, pixel,
+                                           x, y, bbox, sizes->width);
+        }
+    }
+}
+
 /* Allocates and initializes a message_view */
 message_view_t
 message_view_alloc(message_t message, long indent, utf8_renderer_t renderer)
 {
     message_view_t self;
-    struct tm *timestamp;
     struct string_sizes sizes;
 
     /* Make sure there's a message. */
     ASSERT(message != NULL);
 
     /* Allocate enough memory for the new message view */
-    self = malloc(sizeof(struct message_view));
+    if (message_view_slab == NULL) {
+        message_view_slab = slab_alloc("message_view",
+                                       sizeof(struct message_view), 0);
+        if (message_view_slab == NULL) {
+            return NULL;
+        }
+    }
+
+    self = slab_get(message_view_slab);
     if (self == NULL) {
         return NULL;
     }
@@ -212,38 +338,39 @@ message_view_alloc(message_t message, long indent, utf8_renderer_t renderer)
     /* If the message has an attachment then compute the underline info */
     self->has_underline = message_has_attachment(message);
 
-    /* Get the message's timestamp */
-    timestamp = localtime(message_get_creation_time(message));
-    if (timestamp == NULL) {
-        perror("localtime(): failed");
-        exit(1);
-    }
-
-    /* Convert that into a string */
-    snprintf(self->timestamp, TIMESTAMP_SIZE, TIMESTAMP_FORMAT,
-             ((timestamp->tm_hour + 11) % 12) + 1,
-             timestamp->tm_min,
-             timestamp->tm_hour / 12 != 1 ? "am" : "pm");
-
     /* Measure the width of the string to use for noon */
-    utf8_renderer_measure_string(renderer, NOON_TIMESTAMP, &sizes);
+    get_shared_sizes(renderer, NOON_TIMESTAMP, &sizes);
     self->noon_width = sizes.width;
 
     /* Figure out how much to indent the message */
-    utf8_renderer_measure_string(renderer, INDENT, &sizes);
+    get_shared_sizes(renderer, INDENT, &sizes);
     self->indent_width = sizes.width;
 
+    /* Transcode the message's strings once so that painting them
+     * never needs to.  The timestamp and separator are shared with
+     * every other view. */
+    self->timestamp_text = utf8_renderer_transcode_shared(
+        renderer, format_timestamp(message_get_creation_time(message)));
+    self->group_text = utf8_renderer_transcode(renderer,
+                                               message_get_group(message));
+    self->user_text = utf8_renderer_transcode(renderer,
+                                              message_get_user(message));
+    self->message_text = utf8_renderer_transcode(renderer,
+                                                 message_get_string(message));
+    self->separator_text = utf8_renderer_transcode_shared(renderer, SEPARATOR);
+    if (self->timestamp_text == NULL || self->group_text == NULL ||
+        self->user_text == NULL || self->message_text == NULL ||
+        self->separator_text == NULL) {
+        message_view_free(self);
+        return NULL;
+    }
+
     /* Measure the message's strings */
-    utf8_renderer_measure_string(renderer, self->timestamp,
-                                 &self->timestamp_sizes);
-    utf8_renderer_measure_string(renderer, message_get_group(message),
-                                 &self->group_sizes);
-    utf8_renderer_measure_string(renderer, message_get_user(message),
-                                 &self->user_sizes);
-    utf8_renderer_measure_string(renderer, message_get_string(message),
-                                 &self->message_sizes);
-    utf8_renderer_measure_string(renderer, SEPARATOR,
-                                 &self->separator_sizes);
+    utf8_text_get_sizes(self->timestamp_text, &self->timestamp_sizes);
+    utf8_text_get_sizes(self->group_text, &self->group_sizes);
+    utf8_text_get_sizes(self->user_text, &self->user_sizes);
+    utf8_text_get_sizes(self->message_text, &self->message_sizes);
+    utf8_text_get_sizes(self->separator_text, &self->separator_sizes);
     return self;
 }
 
@@ -251,11 +378,25 @@ message_view_alloc(message_t message, long indent, utf8_renderer_t renderer)
 void
 message_view_free(message_view_t self)
 {
+    /* Free the transcoded strings; the timestamp and separator
+     * belong to the renderer */
+    if (self->group_text != NULL) {
+        utf8_text_free(self->group_text);
+    }
+
+    if (self->user_text != NULL) {
+        utf8_text_free(self->user_text);
+    }
+
+    if (self->message_text != NULL) {
+        utf8_text_free(self->message_text);
+    }
+
     /* Free our reference to the message */
     MESSAGE_FREE_REF(self->message, ref_message_view, self);
 
     /* Free the message_view itself */
-    free(self);
+    slab_put(message_view_slab, self);
 }
 
 /* Returns the message view's message */
@@ -322,6 +463,52 @@ message_view_get_sizes(message_view_t self,
     sizes_out->descent = self->separator_sizes.descent;
 }
 
+/* Returns the width of a message_view of the message with neither
+ * indentation nor timestamp, without keeping the transcoded strings
+ * or allocating a message_view */
+long
+message_view_measure(message_t message, utf8_renderer_t renderer)
+{
+    struct string_sizes sizes;
+    long width;
+
+    utf8_renderer_measure_string(renderer, message_get_group(message),
+                                 &sizes);
+    width = sizes.width;
+    utf8_renderer_measure_string(renderer, message_get_user(message),
+                                 &sizes);
+    width += sizes.width;
+    utf8_renderer_measure_string(renderer, message_get_string(message),
+                                 &sizes);
+    width += sizes.width;
+    get_shared_sizes(renderer, SEPARATOR, &sizes);
+    return width + sizes.width * 2;
+}
+
+/* Returns the extra width of a message_view when its timestamp is
+ * shown */
+long
+message_view_get_timestamp_width(utf8_renderer_t renderer)
+{
+    struct string_sizes sizes;
+    long width;
+
+    get_shared_sizes(renderer, NOON_TIMESTAMP, &sizes);
+    width = sizes.width;
+    get_shared_sizes(renderer, INDENT, &sizes);
+    return width + sizes.width;
+}
+
+/* Returns the width of one level of indentation */
+long
+message_view_get_indent_width(utf8_renderer_t renderer)
+{
+    struct string_sizes sizes;
+
+    get_shared_sizes(renderer, INDENT, &sizes);
+    return sizes.width;
+}
+
 /* Draws the message_view */
 void
 message_view_paint(message_view_t self,
@@ -392,7 +579,7 @@ message_view_paint(message_view_t self,
         paint_string(display, drawable, gc, timestamp_pixel,
                      x - self->timestamp_sizes.width, y,
                      bbox, &self->timestamp_sizes,
-                     self->renderer, self->timestamp, False);
+                     self->renderer, self->timestamp_text, False);
 
         /* Indent the next bit */
         x += self->indent_width;
@@ -404,37 +591,89 @@ message_view_paint(message_view_t self,
     /* Paint the group string */
     paint_string(display, drawable, gc, group_pixel,
                  x, y, bbox, &self->group_sizes,
-                 self->renderer, message_get_group(self->message),
+                 self->renderer, self->group_text,
                  self->has_underline);
     x += self->group_sizes.width;
 
     /* Paint the first separator */
     paint_string(display, drawable, gc, separator_pixel,
                  x, y, bbox, &self->separator_sizes,
-                 self->renderer, SEPARATOR,
+                 self->renderer, self->separator_text,
                  self->has_underline);
     x += self->separator_sizes.width;
 
     /* Paint the user string */
     paint_string(display, drawable, gc, user_pixel,
                  x, y, bbox, &self->user_sizes,
-                 self->renderer, message_get_user(self->message),
+                 self->renderer, self->user_text,
                  self->has_underline);
     x += self->user_sizes.width;
 
     /* Paint the second separator */
     paint_string(display, drawable, gc, separator_pixel,
                  x, y, bbox, &self->separator_sizes,
-                 self->renderer, SEPARATOR,
+                 self->renderer, self->separator_text,
                  self->has_underline);
     x += self->separator_sizes.width;
 
     /* Paint the message string */
     paint_string(display, drawable, gc, message_pixel,
                  x, y, bbox, &self->message_sizes,
-                 self->renderer, message_get_string(self->message),
+                 self->renderer, self->message_text,
                  self->has_underline);
     x += self->message_sizes.width;
 }
 
+/* Draws the message_view into a client-side image */
+void
+message_view_render(message_view_t self,
+                    Display *display,
+                    Drawable drawable,
+                    XImage *image,
+                    unsigned long group_pixel,
+                    unsigned long user_pixel,
+                    unsigned long message_pixel,
+                    unsigned long separator_pixel,
+                    long x,
+                    long y,
+                    XRectangle *bbox)
+{
+    /* Indent */
+    x += self->indent * self->indent_width;
+
+    /* Render the group string */
+    render_string(display, drawable, image, group_pixel,
+                  x, y, bbox, &self->group_sizes,
+                  self->renderer, self->group_text,
+                  self->has_underline);
+    x += self->group_sizes.width;
+
+    /* Render the first separator */
+    render_string(display, drawable, image, separator_pixel,
+                  x, y, bbox, &self->separator_sizes,
+                  self->renderer, self->separator_text,
+                  self->has_underline);
+    x += self->separator_sizes.width;
+
+    /* Render the user string */
+    render_string(display, drawable, image, user_pixel,
+                  x, y, bbox, &self->user_sizes,
+                  self->renderer, self->user_text,
+                  self->has_underline);
+    x += self->user_sizes.width;
+
+    /* Render the second separator */
+    render_string(display, drawable, image, separator_pixel,
+                  x, y, bbox, &self->separator_sizes,
+                  self->renderer, self->separator_text,
+                  self->has_underline);
+    x += self->separator_sizes.width;
+
+    /* Render the message string */
+    render_string(display, drawable, image, message_pixel,
+                  x, y, bbox, &self->message_sizes,
+                  self->renderer, self->message_text,
+                  self->has_underline);
+}
+
 /**********************************************************************/
@@ -65,6 +65,24 @@ message_view_get_sizes(message_view_t self,
                        string_sizes_t sizes_out);
 
 
+/* Returns the width of a message_view of the message with neither
+ * indentation nor timestamp, without keeping the transcoded strings
+ * or allocating a message_view */
+long
+message_view_measure(message_t message, utf8_renderer_t renderer);
+
+
+/* Returns the extra width of a message_view when its timestamp is
+ * shown */
+long
+message_view_get_timestamp_width(utf8_renderer_t renderer);
+
+
+/* Returns the width of one level of indentation */
+long
+message_view_get_indent_width(utf8_renderer_t renderer);
+
+
 /* Draws the message_view */
 void
 message_view_paint(message_view_t self,
@@ -82,4 +100,21 @@ message_view_paint(message_view_t self,
                    XRectangle *bbox);
 
 
+/* Draws the message_view into a client-side image without a
+ * timestamp.  The drawable is used to fetch the bitmaps of characters
+ * which haven't been rendered before. */
+void
+message_view_render(message_view_t self,
+                    Display *display,
+                    Drawable drawable,
+                    XImage *image,
+                    unsigned long group_pixel,
+                    unsigned long user_pixel,
+                    unsigned long message_pixel,
+                    unsigned long separator_pixel,
+                    long x,
+                    long y,
+                    XRectangle *bbox);
+
+
 #endif /* MESSAGE_VIEW_H */
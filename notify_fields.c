@@ -0,0 +1,286 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   The attribute names are kept in a small open-addressed hash table
+ *   so that each attribute encountered while traversing the
+ *   notification costs one hash and at most a couple of string
+ *   comparisons, however many attributes we're interested in.
+ *
+ *   A traversal costs time in proportion to the size of the
+ *   notification, so when producers send notifications with many
+ *   more attributes than we want, we look the fields up one at a time
+ *   instead.  notify_fields_bench.c measures both.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h> /* perror */
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h> /* calloc, free, malloc */
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h> /* memset, strcmp */
+#endif
+#ifdef HAVE_ASSERT_H
+# include <assert.h> /* assert */
+#endif
+#include <elvin/elvin.h>
+#include "replace.h"
+#include "globals.h"
+#include "utils.h"
+#include "notify_fields.h"
+
+struct notify_fields {
+    /* The names of the attributes */
+    const char *const *names;
+
+    /* The number of attributes */
+    int count;
+
+    /* The hash table of indices into names (-1 for an empty slot) */
+    int *slots;
+
+    /* The number of slots (a power of two) */
+    unsigned int size;
+
+    /* The number of attributes in the most recently traversed
+     * notification */
+    unsigned int attribute_count;
+
+    /* The number of notifications whose fields have been looked up
+     * directly since the last traversal */
+    unsigned int lookup_count;
+};
+
+/* The state used while traversing a notification */
+struct traversal {
+    /* The table of attribute names */
+    notify_fields_t fields;
+
+    /* Where to put the values */
+    notify_value_t *values;
+
+    /* The number of attributes seen so far */
+    unsigned int attribute_count;
+};
+
+/* Look fields up directly rather than traversing notifications which
+ * have more than this many attributes per field wanted */
+#define LOOKUP_RATIO 2
+
+/* The number of notifications to look up directly before traversing
+ * one again to see whether they've got any smaller */
+#define LOOKUP_INTERVAL 64
+
+/* Hashes an attribute name cheaply.  The attribute names we look
+ * for differ in their lengths and end characters, so there's no need
+ * to hash every character of every attribute we're offered. */
+static unsigned int
+name_hash(const char *name)
+{
+    size_t length = strlen(name);
+
+    if (length == 0) {
+        return 0;
+    }
+
+    return (unsigned int)length * 31 +
+        (unsigned char)name[0] * 7 + (unsigned char)name[length - 1];
+}
+
+/* Allocates a table which can be used to extract the count
+ * attributes named in names from notifications */
+notify_fields_t
+notify_fields_alloc(const char *const *names, int count)
+{
+    notify_fields_t self;
+    unsigned int index;
+    int i;
+
+    /* Allocate memory for the table */
+    self = malloc(sizeof(struct notify_fields));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->names = names;
+    self->count = count;
+    self->attribute_count = 0;
+    self->lookup_count = 0;
+
+    /* Keep the table no more than half full */
+    self->size = 8;
+    while (self->size < 2 * (unsigned int)count) {
+        self->size *= 2;
+    }
+
+    self->slots = malloc(self->size * sizeof(int));
+    if (self->slots == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    for (index = 0; index < self->size; index++) {
+        self->slots[index] = -1;
+    }
+
+    /* Hash the names */
+    for (i = 0; i < count; i++) {
+        index = name_hash(names[i]) & (self->size - 1);
+        while (self->slots[index] != -1) {
+            index = (index + 1) & (self->size - 1);
+        }
+
+        self->slots[index] = i;
+    }
+
+    return self;
+}
+
+/* Releases the resources used by a notify_fields_t */
+void
+notify_fields_free(notify_fields_t self)
+{
+    free(self->slots);
+    free(self);
+}
+
+/* Records an attribute's value if it's one of the ones we want */
+static int
+traverse_cb(void *rock,
+            char *name,
+            elvin_basetypes_t type,
+            elvin_value_t value,
+            elvin_error_t error)
+{
+    struct traversal *traversal = (struct traversal *)rock;
+    notify_fields_t self = traversal->fields;
+    unsigned int index;
+    int i;
+
+    traversal->attribute_count++;
+    index = name_hash(name) & (self->size - 1);
+    while ((i = self->slots[index]) != -1) {
+        if (strcmp(self->names[i], name) == 0) {
+            traversal->values[i].found = 1;
+            traversal->values[i].type = type;
+            traversal->values[i].value = value;
+            break;
+        }
+
+        index = (index + 1) & (self->size - 1);
+    }
+
+    return 1;
+}
+
+/* Looks up each of the named attributes in turn */
+static int
+lookup_fields(notify_fields_t self,
+              elvin_notification_t notification,
+              notify_value_t *values,
+              elvin_error_t error)
+{
+    int i;
+
+    for (i = 0; i < self->count; i++) {
+        if (!elvin_notification_get(notification, self->names[i],
+                                    &values[i].found, &values[i].type,
+                                    &values[i].value, error)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Records the value of each of the named attributes of the
+ * notification in the corresponding element of values, either by
+ * traversing the notification once or, if recent notifications have
+ * been much bigger than the number of fields wanted, by looking the
+ * fields up directly.  Returns 1 on success and 0 on failure. */
+int
+notify_fields_extract(notify_fields_t self,
+                      elvin_notification_t notification,
+                      notify_value_t *values,
+                      elvin_error_t error)
+{
+    struct traversal traversal;
+
+    /* Start with nothing found */
+    memset(values, 0, self->count * sizeof(notify_value_t));
+
+    /* Look up the fields of big notifications, traversing one every
+     * so often in case they've shrunk */
+    if ((unsigned int)self->count * LOOKUP_RATIO < self->attribute_count &&
+        self->lookup_count < LOOKUP_INTERVAL) {
+        self->lookup_count++;
+        return lookup_fields(self, notification, values, error);
+    }
+
+    traversal.fields = self;
+    traversal.values = values;
+    traversal.attribute_count = 0;
+    if (!elvin_notification_traverse(notification, traverse_cb,
+                                     &traversal, error)) {
+        return 0;
+    }
+
+    self->attribute_count = traversal.attribute_count;
+    self->lookup_count = 0;
+    return 1;
+}
+
+/* Returns the string value of an extracted attribute, or NULL if it
+ * was missing or isn't a string */
+char *
+notify_value_string(notify_value_t *value)
+{
+    if (!value->found || value->type != ELVIN_STRING) {
+        return NULL;
+    }
+
+    return value->value.s;
+}
+
+/**********************************************************************/
@@ -0,0 +1,97 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   Extracts the attributes of interest from a notification in a
+ *   single pass over the notification, rather than looking each one
+ *   up in turn.
+ */
+
+#ifndef NOTIFY_FIELDS_H
+#define NOTIFY_FIELDS_H
+
+#include <elvin/elvin.h>
+
+/* The notify_fields data type */
+typedef struct notify_fields *notify_fields_t;
+
+/* The value of an extracted attribute */
+typedef struct notify_value {
+    /* Non-zero if the notification contained the attribute */
+    int found;
+
+    /* The attribute's type */
+    elvin_basetypes_t type;
+
+    /* The attribute's value */
+    elvin_value_t value;
+} notify_value_t;
+
+
+/* Allocates a table which can be used to extract the count
+ * attributes named in names from notifications */
+notify_fields_t
+notify_fields_alloc(const char *const *names, int count);
+
+
+/* Releases the resources used by a notify_fields_t */
+void
+notify_fields_free(notify_fields_t self);
+
+
+/* Records the value of each of the named attributes of the
+ * notification in the corresponding element of values.  The
+ * notification is traversed once unless recent ones have had many
+ * more attributes than we want, in which case the fields are looked
+ * up directly.  Returns 1 on success and 0 on failure. */
+int
+notify_fields_extract(notify_fields_t self,
+                      elvin_notification_t notification,
+                      notify_value_t *values,
+                      elvin_error_t error);
+
+
+/* Returns the string value of an extracted attribute, or NULL if it
+ * was missing or isn't a string */
+char *
+notify_value_string(notify_value_t *value);
+
+#endif /* NOTIFY_FIELDS_H */
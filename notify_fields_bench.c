@@ -0,0 +1,316 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   Measures the cost per notification of extracting group_sub's
+ *   fields with notify_fields_extract() and of looking each of them
+ *   up with elvin_notification_get(), for notifications of a few
+ *   typical shapes.  It isn't built by default; use
+ *   `make notify_fields_bench' and run it with an optional number of
+ *   iterations.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h> /* fprintf, printf, snprintf */
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h> /* atoi, exit */
+#endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h> /* gettimeofday */
+#endif
+#include <X11/Intrinsic.h>
+#include <elvin/elvin.h>
+#include <elvin/xt_mainloop.h>
+#include "replace.h"
+#include "notify_fields.h"
+
+/* The default number of notifications to extract per measurement */
+#define DEFAULT_ITERATIONS 1000000
+
+/* The number of times to repeat each measurement */
+#define REPEAT_COUNT 7
+
+/* The fields group_sub extracts */
+static const char *const field_names[] = {
+    "org.tickertape.message",
+    "From",
+    "USER",
+    "Message",
+    "TICKERTEXT",
+    "Timeout",
+    "TIMEOUT",
+    "Attachment",
+    "MIME_TYPE",
+    "MIME_ARGS",
+    "Replacement-Id",
+    "REPLACEMENT",
+    "Message-Id",
+    "In-Reply-To",
+    "Thread-Id"
+};
+
+#define FIELD_COUNT (sizeof(field_names) / sizeof(field_names[0]))
+
+/* The string attributes of a typical v3 message */
+static const char *const v3_attributes[][2] = {
+    { "Group", "chat" },
+    { "From", "someone@example.com" },
+    { "Message", "hello there, this is a message" },
+    { "Message-Id", "b3a1c9e8-1234-5678-9abc-def012345678" },
+    { "Thread-Id", "0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0" },
+    { "User-Agent", "xtickertape" },
+    { "Distribution", "world" },
+    { "Sender", "someone" },
+    { "Reply-To", "chat" },
+    { "X-Extra", "foo" }
+};
+
+/* The string attributes of a v2 message */
+static const char *const v2_attributes[][2] = {
+    { "TICKERTAPE", "chat" },
+    { "USER", "someone" },
+    { "TICKERTEXT", "hello there" },
+    { "REPLACEMENT", "abc" },
+    { "MIME_TYPE", "x-url" },
+    { "MIME_ARGS", "http://www.example.com/" }
+};
+
+/* The name of the program */
+const char *progname;
+
+/* Returns the time in seconds */
+static double
+get_time(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+/* Prints an error and gives up */
+static void
+fail(const char *function, elvin_error_t error)
+{
+    fprintf(stderr, "%s: %s failed\n", progname, function);
+    elvin_error_fprintf(stderr, error);
+    exit(1);
+}
+
+/* Creates a v3 message with extra_count additional attributes */
+static elvin_notification_t
+make_v3(elvin_client_t client, int extra_count, elvin_error_t error)
+{
+    elvin_notification_t notification;
+    char name[32];
+    int i;
+
+    notification = elvin_notification_alloc(client, error);
+    if (notification == NULL) {
+        fail("elvin_notification_alloc", error);
+    }
+
+    if (!elvin_notification_add_int32(notification,
+                                      "org.tickertape.message", 3001,
+                                      error) ||
+        !elvin_notification_add_int32(notification, "Timeout", 10, error)) {
+        fail("elvin_notification_add_int32", error);
+    }
+
+    for (i = 0; i < XtNumber(v3_attributes); i++) {
+        if (!elvin_notification_add_string(notification,
+                                           v3_attributes[i][0],
+                                           v3_attributes[i][1], error)) {
+            fail("elvin_notification_add_string", error);
+        }
+    }
+
+    for (i = 0; i < extra_count; i++) {
+        snprintf(name, sizeof(name), "X-Custom-Attribute-%d", i);
+        if (!elvin_notification_add_string(notification, name,
+                                           "some value", error)) {
+            fail("elvin_notification_add_string", error);
+        }
+    }
+
+    return notification;
+}
+
+/* Creates a v2 message */
+static elvin_notification_t
+make_v2(elvin_client_t client, elvin_error_t error)
+{
+    elvin_notification_t notification;
+    int i;
+
+    notification = elvin_notification_alloc(client, error);
+    if (notification == NULL) {
+        fail("elvin_notification_alloc", error);
+    }
+
+    if (!elvin_notification_add_int32(notification, "TIMEOUT", 10, error)) {
+        fail("elvin_notification_add_int32", error);
+    }
+
+    for (i = 0; i < XtNumber(v2_attributes); i++) {
+        if (!elvin_notification_add_string(notification,
+                                           v2_attributes[i][0],
+                                           v2_attributes[i][1], error)) {
+            fail("elvin_notification_add_string", error);
+        }
+    }
+
+    return notification;
+}
+
+/* Measures both ways of extracting the fields from a notification and
+ * prints the best time of each in nanoseconds per notification */
+static void
+measure(const char *label,
+        elvin_notification_t notification,
+        int iterations,
+        elvin_error_t error)
+{
+    notify_value_t values[FIELD_COUNT];
+    notify_fields_t fields;
+    double best_lookup = 0.0;
+    double best_extract = 0.0;
+    double start, elapsed;
+    int repeat, i, j;
+
+    fields = notify_fields_alloc(field_names, FIELD_COUNT);
+    if (fields == NULL) {
+        perror("notify_fields_alloc failed");
+        exit(1);
+    }
+
+    for (repeat = 0; repeat < REPEAT_COUNT; repeat++) {
+        /* Look up each field in turn */
+        start = get_time();
+        for (i = 0; i < iterations; i++) {
+            for (j = 0; j < FIELD_COUNT; j++) {
+                if (!elvin_notification_get(notification, field_names[j],
+                                            &values[j].found,
+                                            &values[j].type,
+                                            &values[j].value, error)) {
+                    fail("elvin_notification_get", error);
+                }
+            }
+        }
+
+        elapsed = get_time() - start;
+        if (repeat == 0 || elapsed < best_lookup) {
+            best_lookup = elapsed;
+        }
+
+        /* Extract them all at once */
+        start = get_time();
+        for (i = 0; i < iterations; i++) {
+            if (!notify_fields_extract(fields, notification, values,
+                                       error)) {
+                fail("notify_fields_extract", error);
+            }
+        }
+
+        elapsed = get_time() - start;
+        if (repeat == 0 || elapsed < best_extract) {
+            best_extract = elapsed;
+        }
+    }
+
+    printf("%-28s lookups %6.0f ns  notify_fields_extract %6.0f ns\n",
+           label, best_lookup * 1e9 / iterations,
+           best_extract * 1e9 / iterations);
+    notify_fields_free(fields);
+}
+
+int
+main(int argc, char *argv[])
+{
+    XtAppContext context;
+    elvin_client_t client;
+    elvin_error_t error;
+    elvin_notification_t notification;
+    int iterations = DEFAULT_ITERATIONS;
+
+    progname = argv[0];
+    if (1 < argc) {
+        iterations = atoi(argv[1]);
+        if (iterations <= 0) {
+            fprintf(stderr, "usage: %s [iterations]\n", progname);
+            exit(1);
+        }
+    }
+
+    /* Initialize the elvin client library */
+    XtToolkitInitialize();
+    context = XtCreateApplicationContext();
+    error = elvin_error_alloc(NULL, NULL);
+    if (error == NULL) {
+        fprintf(stderr, "%s: error: elvin_error_alloc failed\n", progname);
+        exit(1);
+    }
+
+    client = elvin_xt_init_default(context, error);
+    if (client == NULL) {
+        fail("elvin_xt_init_default", error);
+    }
+
+    notification = make_v3(client, 0, error);
+    measure("v3 message, 12 attributes", notification, iterations, error);
+    elvin_notification_free(notification, error);
+
+    notification = make_v2(client, error);
+    measure("v2 message, 7 attributes", notification, iterations, error);
+    elvin_notification_free(notification, error);
+
+    notification = make_v3(client, 20, error);
+    measure("v3 message, 32 attributes", notification, iterations, error);
+    elvin_notification_free(notification, error);
+
+    notification = make_v3(client, 60, error);
+    measure("v3 message, 72 attributes", notification, iterations, error);
+    elvin_notification_free(notification, error);
+
+    return 0;
+}
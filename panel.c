@@ -64,6 +64,7 @@
 #include "globals.h"
 #include "utils.h"
 #include "utf8.h"
+#include "intern.h"
 #include "panel.h"
 #include "History.h"
 
@@ -162,8 +163,8 @@ struct menu_item_tuple {
     /* The tuple's push-button widget */
     Widget widget;
 
-    /* The tuple's symbolic tag */
-    char *tag;
+    /* The tuple's symbolic tag (interned) */
+    const char *tag;
 
     /* The title of the tuple's push-button widget */
     char *title;
@@ -1984,7 +1985,11 @@ control_panel_add_subscription(control_panel_t self,
 
     /* Fill in the values of the tuple */
     tuple->control_panel = self;
-    tuple->tag = strdup(tag);
+    tuple->tag = intern_string(tag);
+    if (tuple->tag == NULL) {
+        perror("intern_string failed");
+        exit(1);
+    }
     tuple->title = strdup(title);
     tuple->index = self->group_count++;
     tuple->callback = callback;
@@ -2066,6 +2071,7 @@ control_panel_remove_subscription(control_panel_t self, void *info)
     }
 
     /* Clean up */
+    intern_release(tuple->tag);
     free(tuple->title);
     free(tuple);
 }
@@ -2171,7 +2177,8 @@ control_panel_retitle_subscription(control_panel_t self,
     }
 }
 
-/* Locates the tuple with the given tag */
+/* Locates the tuple with the given tag.  Tags are interned, so they
+ * may be compared by address. */
 static menu_item_tuple_t
 get_tuple_from_tag(control_panel_t self, const char *tag)
 {
@@ -2195,7 +2202,7 @@ get_tuple_from_tag(control_panel_t self, const char *tag)
         menu_item_tuple_t tuple;
 
         XtVaGetValues(*child, XmNuserData, &tuple, NULL);
-        if (tuple != NULL && strcmp(tuple->tag, tag) == 0) {
+        if (tuple != NULL && tuple->tag == tag) {
             return tuple;
         }
     }
@@ -0,0 +1,321 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   Each size class keeps a singly-linked free list threaded through
+ *   the unused objects themselves.  When a free list runs dry we
+ *   allocate a chunk of about CHUNK_SIZE bytes and thread it onto the
+ *   list in one go.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h> /* fprintf */
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h> /* free, malloc */
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h> /* memset */
+#endif
+#ifdef HAVE_ASSERT_H
+# include <assert.h> /* assert */
+#endif
+#include "replace.h"
+#include "globals.h"
+#include "slab.h"
+
+/* The number of bytes to allocate at a time */
+#define CHUNK_SIZE 16384
+
+/* The fewest objects to allocate at a time */
+#define CHUNK_MIN_OBJECTS 8
+
+/* The most size classes a slab may have */
+#define MAX_CLASSES 8
+
+/* Every object is aligned to this many bytes */
+#define ALIGNMENT \
+    (sizeof(void *) > sizeof(double) ? sizeof(void *) : sizeof(double))
+
+/* Rounds a size up to a multiple of ALIGNMENT */
+#define ALIGN(size) (((size) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT)
+
+/* An unused object on a free list */
+typedef struct free_object *free_object_t;
+
+struct free_object {
+    /* The next unused object */
+    free_object_t next;
+};
+
+/* The objects of a single size */
+struct size_class {
+    /* The size of each object */
+    size_t size;
+
+    /* The unused objects */
+    free_object_t free_list;
+};
+
+struct slab {
+    /* The next slab in the list of all slabs */
+    slab_t next;
+
+    /* The name of the objects, for reporting */
+    const char *name;
+
+    /* The size classes, smallest first */
+    struct size_class classes[MAX_CLASSES];
+
+    /* The number of size classes */
+    int class_count;
+
+    /* The number of objects in use */
+    unsigned long count;
+
+    /* The largest number of objects ever in use */
+    unsigned long peak;
+
+    /* The total number of objects handed out */
+    unsigned long total;
+
+    /* The number of objects too large for any size class */
+    unsigned long large_count;
+
+    /* The number of bytes allocated in chunks */
+    unsigned long chunk_bytes;
+};
+
+/* Every slab, for reporting */
+static slab_t slabs;
+
+/* Allocates a new slab for objects of at least size bytes */
+slab_t
+slab_alloc(const char *name, size_t size, size_t max_size)
+{
+    slab_t self;
+
+    self = malloc(sizeof(struct slab));
+    if (self == NULL) {
+        return NULL;
+    }
+    memset(self, 0, sizeof(struct slab));
+
+    self->name = name;
+
+    /* Make sure an unused object can hold a free list link */
+    size = ALIGN(size < sizeof(struct free_object) ?
+                 sizeof(struct free_object) : size);
+
+    /* Create the size classes */
+    do {
+        self->classes[self->class_count++].size = size;
+        size *= 2;
+    } while (size <= max_size && self->class_count < MAX_CLASSES);
+
+    /* Add it to the list */
+    self->next = slabs;
+    slabs = self;
+    return self;
+}
+
+/* Refills a size class's free list */
+static int
+class_grow(slab_t self, struct size_class *class)
+{
+    size_t count;
+    char *chunk;
+    char *point;
+
+    /* Work out how many objects to allocate */
+    count = CHUNK_SIZE / class->size;
+    if (count < CHUNK_MIN_OBJECTS) {
+        count = CHUNK_MIN_OBJECTS;
+    }
+
+    chunk = malloc(count * class->size);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    /* Thread the new objects onto the free list */
+    for (point = chunk + count * class->size; point != chunk; ) {
+        free_object_t object;
+
+        point -= class->size;
+        object = (free_object_t)point;
+        object->next = class->free_list;
+        class->free_list = object;
+    }
+
+    self->chunk_bytes += count * class->size;
+    return 0;
+}
+
+/* Takes an object from a size class */
+static void *
+class_get(slab_t self, struct size_class *class)
+{
+    free_object_t object;
+
+    if (class->free_list == NULL && class_grow(self, class) < 0) {
+        return NULL;
+    }
+
+    object = class->free_list;
+    class->free_list = object->next;
+
+    /* Update the statistics */
+    self->total++;
+    if (++self->count > self->peak) {
+        self->peak = self->count;
+    }
+
+    return object;
+}
+
+/* Answers the smallest size class which can hold size bytes, or NULL
+ * if there is none */
+static struct size_class *
+find_class(slab_t self, size_t size)
+{
+    int i;
+
+    for (i = 0; i < self->class_count; i++) {
+        if (size <= self->classes[i].size) {
+            return &self->classes[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Answers an object from the slab's smallest size class */
+void *
+slab_get(slab_t self)
+{
+    return class_get(self, &self->classes[0]);
+}
+
+/* Returns an object obtained with slab_get to the slab */
+void
+slab_put(slab_t self, void *object)
+{
+    free_object_t free_object = (free_object_t)object;
+
+    ASSERT(self->count != 0);
+    free_object->next = self->classes[0].free_list;
+    self->classes[0].free_list = free_object;
+    self->count--;
+}
+
+/* Answers an object of at least size bytes */
+void *
+slab_get_sized(slab_t self, size_t size)
+{
+    struct size_class *class;
+    void *object;
+
+    class = find_class(self, size);
+    if (class != NULL) {
+        return class_get(self, class);
+    }
+
+    /* Too big for the slab */
+    object = malloc(size);
+    if (object == NULL) {
+        return NULL;
+    }
+
+    self->large_count++;
+    self->total++;
+    if (++self->count > self->peak) {
+        self->peak = self->count;
+    }
+
+    return object;
+}
+
+/* Returns an object obtained with slab_get_sized to the slab */
+void
+slab_put_sized(slab_t self, void *object, size_t size)
+{
+    struct size_class *class;
+    free_object_t free_object;
+
+    ASSERT(self->count != 0);
+    self->count--;
+
+    class = find_class(self, size);
+    if (class == NULL) {
+        self->large_count--;
+        free(object);
+        return;
+    }
+
+    free_object = (free_object_t)object;
+    free_object->next = class->free_list;
+    class->free_list = free_object;
+}
+
+/* Answers the number of the slab's objects currently in use */
+unsigned long
+slab_get_count(slab_t self)
+{
+    return self->count;
+}
+
+/* Prints one line of statistics for each slab to out */
+void
+slab_report(FILE *out, const char *prefix)
+{
+    slab_t slab;
+
+    for (slab = slabs; slab != NULL; slab = slab->next) {
+        fprintf(out, "%s: slab %s: count=%lu, peak=%lu, total=%lu, "
+                "large=%lu, bytes=%lu\n", prefix, slab->name, slab->count,
+                slab->peak, slab->total, slab->large_count,
+                slab->chunk_bytes);
+    }
+}
+
+/**********************************************************************/
@@ -0,0 +1,101 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   Free-list allocators for the small objects which are created and
+ *   destroyed for each notification.  Objects are carved out of
+ *   larger chunks and recycled through a per-size free list, which
+ *   keeps them out of the general heap and so avoids fragmenting it
+ *   over long sessions.  Chunks are never returned to the system.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdio.h> /* FILE */
+
+/* The slab data type */
+typedef struct slab *slab_t;
+
+
+/* Allocates a new slab for objects of at least size bytes.  If
+ * max_size is larger than size then the slab has a size class for
+ * each power-of-two multiple of size up to max_size; larger requests
+ * are passed on to malloc.  Returns NULL on failure. */
+slab_t
+slab_alloc(const char *name, size_t size, size_t max_size);
+
+
+/* Answers an object from the slab's smallest size class, or NULL if
+ * memory is exhausted */
+void *
+slab_get(slab_t self);
+
+
+/* Returns an object obtained with slab_get to the slab */
+void
+slab_put(slab_t self, void *object);
+
+
+/* Answers an object of at least size bytes, or NULL if memory is
+ * exhausted */
+void *
+slab_get_sized(slab_t self, size_t size);
+
+
+/* Returns an object obtained with slab_get_sized to the slab.  The
+ * size must be the one passed to slab_get_sized. */
+void
+slab_put_sized(slab_t self, void *object, size_t size);
+
+
+/* Answers the number of the slab's objects currently in use */
+unsigned long
+slab_get_count(slab_t self);
+
+
+/* Prints one line of statistics for each slab to out, each prefixed
+ * by prefix */
+void
+slab_report(FILE *out, const char *prefix);
+
+
+#endif /* SLAB_H */
@@ -93,6 +93,8 @@
 #include "usenet_parser.h"
 #include "usenet_sub.h"
 #include "mail_sub.h"
+#include "journal.h"
+#include "viewer.h"
 #include "utils.h"
 
 #define DEFAULT_TICKERDIR ".ticker"
@@ -100,6 +102,7 @@
 #define DEFAULT_GROUPS_FILE "groups"
 #define DEFAULT_USENET_FILE "usenet"
 #define DEFAULT_KEYS_FILE "keys"
+#define DEFAULT_JOURNAL_FILE "history"
 
 #define METAMAIL_OPTIONS "-x", "-B", "-q"
 
@@ -175,6 +178,8 @@ struct tickertape {
      * relative paths */
     char *keys_dir;
 
+    /* The journal file in which we record received messages */
+    char *journal_file;
 
     /* The top-level widget */
     Widget top;
@@ -185,6 +190,9 @@ struct tickertape {
     /* The number of groups subscriptions the receiver has */
     int groups_count;
 
+    /* The merged subscriptions for the groups (NULL if not merging) */
+    group_mux_t group_mux;
+
     /* The receiver's usenet subscription (from the usenet file) */
     usenet_sub_t usenet_sub;
 
@@ -194,6 +202,16 @@ struct tickertape {
     /* The receiver's mail subscription */
     mail_sub_t mail_sub;
 
+    /* The journal of received messages (NULL if disabled) */
+    journal_t journal;
+
+    /* The work procedure which will compact the journal, or 0 if none
+     * is pending */
+    XtWorkProcId compact_proc;
+
+    /* The processes displaying attachments */
+    viewer_t viewer;
+
     /* The control panel */
     control_panel_t control_panel;
 
@@ -215,6 +233,8 @@ static const char *
 tickertape_keys_filename(tickertape_t self);
 static const char *
 tickertape_keys_directory(tickertape_t self);
+static const char *
+tickertape_journal_filename(tickertape_t self);
 
 
 /*
@@ -321,6 +341,21 @@ kill_callback(Widget widget, XtPointer closure, XtPointer call_data)
     ScPurgeKilled(self->scroller);
 }
 
+/* Compacts the journal when there's nothing else to do */
+static Boolean
+compact_journal(XtPointer rock)
+{
+    tickertape_t self = (tickertape_t)rock;
+
+    self->compact_proc = 0;
+    if (journal_compact(self->journal) < 0) {
+        perror("unable to compact the journal");
+    }
+
+    /* Don't call us again */
+    return True;
+}
+
 /* Receive a message_t matched by a subscription */
 static void
 receive_callback(void *rock, message_t message, int show_attachment)
@@ -330,6 +365,19 @@ receive_callback(void *rock, message_t message, int show_attachment)
     /* Get a reference to the message. */
     MESSAGE_ALLOC_REF(message, ref_recursion, self);
 
+    /* Record the message in the journal */
+    if (self->journal != NULL && journal_append(self->journal, message) < 0) {
+        perror("unable to write to the journal");
+    }
+
+    /* Compact it once we're idle rather than while a burst of
+     * messages is arriving */
+    if (self->journal != NULL && self->compact_proc == 0 &&
+        journal_needs_compacting(self->journal)) {
+        self->compact_proc = XtAppAddWorkProc(
+            XtWidgetToApplicationContext(self->top), compact_journal, self);
+    }
+
     /* Add the message to the control panel.  This will mark it as
      * killed if it is added to a thread which has been killed */
     control_panel_add_message(self->control_panel, message);
@@ -348,6 +396,56 @@ receive_callback(void *rock, message_t message, int show_attachment)
     MESSAGE_FREE_REF(message, ref_recursion, self);
 }
 
+/* Report the progress of attachment viewers on the status line */
+static void
+viewer_status_callback(void *rock, const char *status)
+{
+    tickertape_t self = (tickertape_t)rock;
+
+    if (self->control_panel != NULL) {
+        control_panel_set_status(self->control_panel, status);
+    }
+}
+
+/* Restore a message from the journal into the history */
+static void
+replay_callback(void *rock, message_t message)
+{
+    tickertape_t self = (tickertape_t)rock;
+
+    control_panel_add_message(self->control_panel, message);
+}
+
+/* Open the journal and restore the history from it */
+static void
+open_journal(tickertape_t self)
+{
+    const char *filename;
+
+    /* Don't bother if the journal is disabled */
+    if (self->resources->journal_capacity <= 0) {
+        return;
+    }
+
+    /* Open the journal file */
+    filename = tickertape_journal_filename(self);
+    self->journal = journal_alloc(filename,
+                                  self->resources->journal_capacity,
+                                  MAX(self->resources->journal_size, 0));
+    if (self->journal == NULL) {
+        fprintf(stderr, "%s: unable to open journal %s: ",
+                progname, filename);
+        perror(NULL);
+        return;
+    }
+
+    /* Restore the history */
+    if (self->control_panel != NULL &&
+        journal_replay(self->journal, replay_callback, self) < 0) {
+        perror("unable to read the journal");
+    }
+}
+
 /* Write the template to the given file, doing some substitutions */
 static int
 write_default_file(tickertape_t self, FILE *out, const char *template)
@@ -472,6 +570,11 @@ parse_groups_callback(void *rock,
         return -1;
     }
 
+    /* Share an elvin subscription with the other groups */
+    if (self->group_mux != NULL) {
+        group_sub_set_mux(subscription, self->group_mux);
+    }
+
     /* Add it to the end of the array */
     self->groups = realloc(self->groups,
                            sizeof(group_sub_t) * (self->groups_count + 1));
@@ -762,6 +865,11 @@ reload_groups(tickertape_t self, key_table_t old_keys, key_table_t new_keys)
     /* Release the old array */
     free(old_groups);
 
+    /* Send the merged subscriptions' changes to the server */
+    if (self->group_mux != NULL) {
+        group_mux_sync(self->group_mux);
+    }
+
     /* Renumber the items in the control panel */
     count = 0;
     for (index = 0; index < self->groups_count; index++) {
@@ -822,6 +930,11 @@ tickertape_reload_keys(tickertape_t self)
                                   old_keys, self->keys);
     }
 
+    /* Send the merged subscriptions' changes to the server */
+    if (self->group_mux != NULL) {
+        group_mux_sync(self->group_mux);
+    }
+
     /* Release the old keys table */
     if (old_keys != NULL) {
         key_table_free(old_keys);
@@ -919,6 +1032,11 @@ connect_cb(elvin_handle_t handle, int result, void *rock, elvin_error_t error)
         group_sub_set_connection(self->groups[index], handle, error);
     }
 
+    /* Subscribe on behalf of the merged groups */
+    if (self->group_mux != NULL) {
+        group_mux_sync(self->group_mux);
+    }
+
     /* Subscribe to usenet */
     if (self->usenet_sub != NULL) {
         usenet_sub_set_connection(self->usenet_sub, handle, error);
@@ -1277,11 +1395,16 @@ tickertape_alloc(XTickertapeRec *resources,
     self->usenet_file = (usenet_file == NULL) ? NULL : strdup(usenet_file);
     self->keys_file = (keys_file == NULL) ? NULL : strdup(keys_file);
     self->keys_dir = (keys_dir == NULL) ? NULL : strdup(keys_dir);
+    self->journal_file = NULL;
     self->top = top;
     self->groups = NULL;
     self->groups_count = 0;
+    self->group_mux = NULL;
     self->usenet_sub = NULL;
     self->mail_sub = NULL;
+    self->journal = NULL;
+    self->compact_proc = 0;
+    self->viewer = NULL;
     self->control_panel = NULL;
     self->scroller = NULL;
 
@@ -1290,6 +1413,15 @@ tickertape_alloc(XTickertapeRec *resources,
         exit(1);
     }
 
+    /* Merge the group subscriptions if requested */
+    if (resources->merge_groups) {
+        self->group_mux = group_mux_alloc();
+        if (self->group_mux == NULL) {
+            perror("group_mux_alloc() failed");
+            exit(1);
+        }
+    }
+
     /* Read the subscriptions from the groups file */
     if (parse_groups_file(self) < 0) {
         exit(1);
@@ -1306,6 +1438,14 @@ tickertape_alloc(XTickertapeRec *resources,
     /* Draw the user interface */
     init_ui(self);
 
+    /* Restore the history from the last session */
+    open_journal(self);
+
+    /* Prepare to launch attachment viewers */
+    self->viewer = viewer_alloc(XtWidgetToApplicationContext(top),
+                                resources->max_viewers,
+                                viewer_status_callback, self);
+
     /* Set the handle's status callback */
     if (!elvin_handle_set_status_cb(handle, status_cb, self, self->error)) {
         eeprintf(error, "elvin_handle_set_status_cb failed\n");
@@ -1353,11 +1493,20 @@ tickertape_free(tickertape_t self)
         free(self->keys_file);
     }
 
+    if (self->journal_file != NULL) {
+        free(self->journal_file);
+    }
+
     for (index = 0; index < self->groups_count; index++) {
         group_sub_set_connection(self->groups[index], NULL, self->error);
         group_sub_free(self->groups[index]);
     }
 
+    if (self->group_mux != NULL) {
+        group_mux_sync(self->group_mux);
+        group_mux_free(self->group_mux);
+    }
+
     if (self->groups != NULL) {
         free(self->groups);
     }
@@ -1375,9 +1524,30 @@ tickertape_free(tickertape_t self)
         control_panel_free(self->control_panel);
     }
 
+    if (self->compact_proc != 0) {
+        XtRemoveWorkProc(self->compact_proc);
+    }
+
+    if (self->journal != NULL) {
+        journal_free(self->journal);
+    }
+
+    if (self->viewer != NULL) {
+        viewer_free(self->viewer);
+    }
+
     free(self);
 }
 
+/* Prints out debugging information about the Tickertape */
+void
+tickertape_debug(tickertape_t self)
+{
+    if (self->scroller != NULL) {
+        ScReportFrameTimes(self->scroller, stderr, progname);
+    }
+}
+
 /* Answers the tickertape's user name */
 const const char *
 tickertape_user_name(tickertape_t self)
@@ -1544,124 +1714,61 @@ tickertape_keys_directory(tickertape_t self)
     return self->keys_dir;
 }
 
+/* Answers the receiver's journal filename */
+static const char *
+tickertape_journal_filename(tickertape_t self)
+{
+    if (self->journal_file == NULL) {
+        const char *dir = tickertape_ticker_dir(self);
+        size_t length = strlen(dir) + sizeof(DEFAULT_JOURNAL_FILE) + 1;
+
+        self->journal_file = malloc(length);
+        if (self->journal_file == NULL) {
+            perror("unable to allocate memory");
+            exit(1);
+        }
+
+        snprintf(self->journal_file, length, "%s/%s",
+                 dir, DEFAULT_JOURNAL_FILE);
+    }
+
+    return self->journal_file;
+}
+
 /* Displays a message's MIME attachment */
 int
 tickertape_show_attachment(tickertape_t self, message_t message)
 {
-#if defined(HAVE_DUP2) && defined(HAVE_FORK)
+    char *argv[] = { NULL, METAMAIL_OPTIONS, NULL };
     const char *attachment;
     size_t count;
-    const char *pointer;
-    const char *end;
-    pid_t pid;
-    int fds_stdin[2];
-    int status;
 
     /* If metamail is not defined then we're done */
     if (self->resources->metamail == NULL ||
         *self->resources->metamail == '\0') {
-# if defined(DEBUG)
+#if defined(DEBUG)
         printf("metamail not defined\n");
-# endif /* DEBUG */
+#endif /* DEBUG */
         return -1;
     }
 
     /* If the message has no attachment then we're done */
     count = message_get_attachment(message, &attachment);
     if (count == 0) {
-# if defined(DEBUG)
+#if defined(DEBUG)
         printf("no attachment\n");
-# endif /* DEBUG */
+#endif /* DEBUG */
         return -1;
     }
 
-    /* Create a pipe to send the file to metamail */
-    if (pipe(fds_stdin) < 0) {
-        perror("pipe(): failed");
+    /* Bail if we couldn't set up the viewer */
+    if (self->viewer == NULL) {
         return -1;
     }
 
-    /* Fork a child process to invoke metamail */
-    pid = fork();
-    if (pid == (pid_t)-1) {
-        perror("fork(): failed");
-        close(fds_stdin[0]);
-        close(fds_stdin[1]);
-        return -1;
-    }
-
-    /* See if we're the child process */
-    if (pid == 0) {
-        /* Use the pipe as stdin */
-        dup2(fds_stdin[0], STDIN_FILENO);
-
-        /* Close off the ends of the pipe */
-        close(fds_stdin[0]);
-        close(fds_stdin[1]);
-
-        /* Invoke metamail */
-        execlp(self->resources->metamail,
-               self->resources->metamail,
-               METAMAIL_OPTIONS,
-               NULL);
-
-        /* We'll only get here if exec fails */
-        perror("execlp(): failed");
-        exit(1);
-    }
-
-    /* We're the parent process. */
-    if (close(fds_stdin[0]) < 0) {
-        perror("close(): failed");
-        return -1;
-    }
-
-    /* Write the mime args into the pipe */
-    end = attachment + count;
-    pointer = attachment;
-    while (pointer < end) {
-        ssize_t length;
-
-        /* Write as much as we can */
-        length = write(fds_stdin[1], pointer, end - pointer);
-        if (length < 0) {
-            perror("unable to write to metamail pipe");
-            return -1;
-        }
-
-        pointer += length;
-    }
-
-    /* Make sure it gets written */
-    if (close(fds_stdin[1]) < 0) {
-        perror("close(): failed");
-        return -1;
-    }
-
-    /* Wait for the child process to exit */
-    if (waitpid(pid, &status, 0) == (pid_t)-1) {
-        perror("waitpid(): failed");
-        return -1;
-    }
-
-    /* Did the child process exit nicely? */
-    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
-        return 0;
-    }
-# if defined(DEBUG)
-    /* Did it exit badly? */
-    if (WIFEXITED(status)) {
-        fprintf(stderr, "%s exit status: %d\n",
-                self->resources->metamail,
-                WEXITSTATUS(status));
-        return -1;
-    }
-
-    fprintf(stderr, "%s died badly\n", self->resources->metamail);
-# endif
-#endif /* METAMAIL & DUP2 & FORK */
-
-    return -1;
+    /* Hand the attachment to metamail without waiting for it */
+    argv[0] = (char *)self->resources->metamail;
+    return viewer_run(self->viewer, argv, attachment, count);
 }
 
 /**********************************************************************/
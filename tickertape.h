@@ -61,6 +61,20 @@ typedef struct {
 
     /* The number of messages to record in the send history */
     int send_history_count;
+
+    /* The number of messages to restore from the journal (0 to
+     * disable the journal) */
+    int journal_capacity;
+
+    /* The size (in bytes) beyond which the journal is compacted */
+    int journal_size;
+
+    /* The number of attachment viewers which may run at once (0 for
+     * no limit) */
+    int max_viewers;
+
+    /* True if the groups should share elvin subscriptions */
+    Boolean merge_groups;
 } XTickertapeRec;
 
 /* Answers a new Tickertape for the given user using the given file as
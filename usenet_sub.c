@@ -52,6 +52,7 @@
 #include <elvin/xt_mainloop.h>
 #include "replace.h"
 #include "globals.h"
+#include "notify_fields.h"
 #include "usenet_sub.h"
 #include "utils.h"
 
@@ -294,6 +295,50 @@ notify_cb(elvin_handle_t handle,
     }
 }
 #elif ELVIN_VERSION_AT_LEAST(4, 1, -1)
+/* The indices of the fields extracted from notifications */
+enum {
+    FIELD_NEWSGROUPS,
+    FIELD_FROM_NAME,
+    FIELD_FROM_EMAIL,
+    FIELD_FROM,
+    FIELD_SUBJECT,
+    FIELD_MIME_ARGS,
+    FIELD_MIME_TYPE,
+    FIELD_MESSAGE_ID,
+    FIELD_X_NNTP_HOST,
+    FIELD_COUNT
+};
+
+/* The names of the fields extracted from notifications */
+static const char *const field_names[FIELD_COUNT] = {
+    NEWSGROUPS,
+    FROM_NAME,
+    FROM_EMAIL,
+    FROM,
+    SUBJECT,
+    MIME_ARGS,
+    MIME_TYPE,
+    MESSAGE_ID,
+    X_NNTP_HOST
+};
+
+/* Returns the table used to extract fields from notifications */
+static notify_fields_t
+get_fields(void)
+{
+    static notify_fields_t fields = NULL;
+
+    if (fields == NULL) {
+        fields = notify_fields_alloc(field_names, FIELD_COUNT);
+        if (fields == NULL) {
+            perror("notify_fields_alloc failed");
+            exit(1);
+        }
+    }
+
+    return fields;
+}
+
 /* Delivers a notification which matches the receiver's subscription
  * expression */
 static int
@@ -305,6 +350,7 @@ notify_cb(elvin_handle_t handle,
           elvin_error_t error)
 {
     usenet_sub_t self = (usenet_sub_t)rock;
+    notify_value_t values[FIELD_COUNT];
     message_t message;
     char *string;
     char *newsgroups;
@@ -315,22 +361,24 @@ notify_cb(elvin_handle_t handle,
     char *buffer = NULL;
     char *attachment = NULL;
     size_t length = 0;
-    int found;
 
     /* If we don't have a callback than bail out now */
     if (self->callback == NULL) {
         return 1;
     }
 
-    /* Get the newsgroups to which the message was posted */
-    if (!elvin_notification_get_string(notification, NEWSGROUPS, &found,
-                                       &string, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
+    /* Pull all of the fields we're interested in out of the
+     * notification in one go */
+    if (!notify_fields_extract(get_fields(), notification, values, error)) {
+        eeprintf(error, "elvin_notification_traverse failed\n");
         exit(1);
     }
 
+    /* Get the newsgroups to which the message was posted */
+    string = notify_value_string(&values[FIELD_NEWSGROUPS]);
+
     /* Use a reasonable default */
-    string = found ? string : "news";
+    string = (string != NULL) ? string : "news";
 
     /* Prepend `usenet:' to the beginning of the group field */
     length = strlen(USENET_PREFIX) + strlen(string) - 1;
@@ -341,30 +389,14 @@ notify_cb(elvin_handle_t handle,
 
     snprintf(newsgroups, length, USENET_PREFIX, string);
 
-    /* Get the name from the FROM_NAME field (if provided) */
-    if (!elvin_notification_get_string(notification, FROM_NAME, &found, &name,
-                                       error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
-
-    if (!found) {
-        /* No FROM_NAME field, so try FROM_EMAIL */
-        if (!elvin_notification_get_string(notification, FROM_EMAIL, &found,
-                                           &name, error)) {
-            eeprintf(error, "elvin_notification_get_string failed\n");
-            exit(1);
-        }
-
-        if (!found) {
-            /* No FROM_EMAIL, so try FROM */
-            if (!elvin_notification_get_string(notification, FROM, &found,
-                                               &name, error)) {
-                eeprintf(error, "elvin_notification_get_string failed\n");
-                exit(1);
-            }
-
-            if (!found) {
+    /* Get the name from the FROM_NAME field (if provided), or failing
+     * that the FROM_EMAIL field, or failing that the From field */
+    name = notify_value_string(&values[FIELD_FROM_NAME]);
+    if (name == NULL) {
+        name = notify_value_string(&values[FIELD_FROM_EMAIL]);
+        if (name == NULL) {
+            name = notify_value_string(&values[FIELD_FROM]);
+            if (name == NULL) {
                 /* Give up */
                 name = "anonymous";
             }
@@ -372,57 +404,32 @@ notify_cb(elvin_handle_t handle,
     }
 
     /* Get the SUBJECT field (if provided) */
-    if (!elvin_notification_get_string(notification, SUBJECT, &found,
-                                       &subject, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
+    subject = notify_value_string(&values[FIELD_SUBJECT]);
 
     /* Use a default if none found */
-    subject = found ? subject : "[no subject]";
+    subject = (subject != NULL) ? subject : "[no subject]";
 
     /* Get the MIME_ARGS field (if provided) */
-    if (!elvin_notification_get_string(notification, MIME_ARGS, &found,
-                                       &mime_args, error)) {
-        eeprintf(error, "elvin_notification_get_string failed\n");
-        exit(1);
-    }
+    mime_args = notify_value_string(&values[FIELD_MIME_ARGS]);
 
     /* Was the MIME_ARGS field provided? */
-    if (found) {
+    if (mime_args != NULL) {
         /* Get the MIME_TYPE field (if provided) */
-        if (!elvin_notification_get_string(notification, MIME_TYPE, &found,
-                                           &mime_type, error)) {
-            eeprintf(error, "elvin_notification_get_string failed\n");
-            exit(1);
-        }
+        mime_type = notify_value_string(&values[FIELD_MIME_TYPE]);
 
         /* Use a default if none found */
-        mime_type = found ? mime_type : URL_MIME_TYPE;
+        mime_type = (mime_type != NULL) ? mime_type : URL_MIME_TYPE;
     } else {
         char *message_id;
 
         /* No MIME_ARGS.  Look for a message-id */
-        if (!elvin_notification_get_string(notification, MESSAGE_ID, &found,
-                                           &message_id, error)) {
-            eeprintf(error, "elvin_notification_get_string failed\n");
-            exit(1);
-        }
-
-        if (found) {
+        message_id = notify_value_string(&values[FIELD_MESSAGE_ID]);
+        if (message_id != NULL) {
             char *news_host;
 
             /* Look up the news host field */
-            if (!elvin_notification_get_string(
-                    notification,
-                    X_NNTP_HOST,
-                    &found, &news_host,
-                    error)) {
-                eeprintf(error, "elvin_notification_get_string failed\n");
-                exit(1);
-            }
-
-            news_host = found ? news_host : "news";
+            news_host = notify_value_string(&values[FIELD_X_NNTP_HOST]);
+            news_host = (news_host != NULL) ? news_host : "news";
 
             length = strlen(NEWS_URL) + strlen(news_host) +
                 strlen(message_id) - 3;
@@ -46,6 +46,12 @@
 #ifdef HAVE_STDLIB_H
 # include <stdlib.h>
 #endif
+#ifdef HAVE_CTYPE_H
+# include <ctype.h> /* isalnum, tolower */
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h> /* memcpy, strcmp, strdup, strlen */
+#endif
 #ifdef HAVE_ICONV_H
 # include <iconv.h>
 #endif
@@ -76,6 +82,21 @@
 /* The maximum number of bytes per character */
 #define MAX_CHAR_SIZE 2
 
+/* The size of the buffer used to normalize code set names */
+#define CODE_SET_SIZE 32
+
+/* An unsigned long with the high bit of each byte set */
+#define HIGH_BITS (((unsigned long)-1 / 0xff) * 0x80)
+
+/* The shortest run of ASCII characters worth leaving iconv() for */
+#define MIN_ASCII_RUN 8
+
+/* The number of characters in a page of a renderer's metrics table */
+#define METRICS_PAGE_SIZE 256
+
+/* The number of buckets in a renderer's table of shared texts */
+#define SHARED_TABLE_SIZE 127
+
 
 /* The format of a guesses table entry */
 struct guess {
@@ -121,6 +142,23 @@ typedef void *iconv_t;
 /* The empty character */
 static const XCharStruct empty_char = { 0, 0, 0, 0, 0, 0 };
 
+/* The pixels of a character as runs along each of its rows, so that
+ * they can be copied into an image a span at a time */
+struct char_bitmap {
+    /* The number of rows */
+    int height;
+
+    /* The index in runs of the first run of each row, followed by
+     * the total number of runs */
+    unsigned short *rows;
+
+    /* The first column and length of each run */
+    unsigned short *runs;
+};
+
+/* Stands in for the bitmap of a character which has no pixels */
+static struct char_bitmap empty_bitmap;
+
 #ifdef HAVE_ICONV
 /* Locates the guess with the given name in the guesses table */
 static const struct guess *
@@ -261,11 +299,46 @@ struct utf8_renderer {
     /* The number of bytes per character in the font's code set */
     int dimension;
 
+    /* The first character which can't be transcoded without iconv()
+     * (0 if everything goes through iconv()) */
+    unsigned long fast_limit;
+
     /* The thickness of an underline */
     long underline_thickness;
 
     /* The position of an underline */
     long underline_position;
+
+    /* Strings which have been transcoded once and shared, hashed by
+     * their contents (NULL until the first one is requested) */
+    struct shared_text **shared;
+
+    /* The metrics of each character, with the default character
+     * already substituted for missing ones, in pages indexed by the
+     * first byte of the character.  Page 0 is filled in up front;
+     * the rest only when a 16-bit font first needs them. */
+    XCharStruct *metrics[METRICS_PAGE_SIZE];
+
+    /* The bitmaps of the characters which have been rendered into
+     * client-side images, in pages like the metrics */
+    struct char_bitmap **bitmaps[METRICS_PAGE_SIZE];
+
+    /* The GC used to draw characters into bitmaps (None until the
+     * first one is needed) */
+    GC bitmap_gc;
+};
+
+/* A string transcoded once and shared by everyone who draws it with
+ * the same renderer */
+struct shared_text {
+    /* The next shared text in the same bucket */
+    struct shared_text *next;
+
+    /* The original UTF-8 string */
+    char *string;
+
+    /* The transcoded string */
+    utf8_text_t text;
 };
 
 /* Answers the statistics to use for a given character in the font */
@@ -342,6 +415,87 @@ cd_dimension(iconv_t cd)
     return point - buffer;
 }
 
+/* Returns the first character which can be transcoded into the code
+ * set without iconv(), or 0 if the code set isn't one we know.  ASCII
+ * characters are the same in every ISO-8859 code set, Latin-1 maps
+ * each character below 0x100 to a single byte, and 16-bit fonts take
+ * the Basic Multilingual Plane as big-endian UCS-2. */
+static unsigned long
+fast_path_limit(const char *code_set, int dimension)
+{
+    char name[CODE_SET_SIZE];
+    size_t length = 0;
+
+    /* Normalize the name so that ISO8859-1, ISO-8859-1 and iso8859_1
+     * all look the same */
+    while (*code_set != '\0' && length < CODE_SET_SIZE - 1) {
+        if (isalnum((unsigned char)*code_set)) {
+            name[length++] = tolower((unsigned char)*code_set);
+        }
+
+        code_set++;
+    }
+    name[length] = '\0';
+
+    if (dimension == 1) {
+        if (strcmp(name, "iso88591") == 0) {
+            return 0x100;
+        }
+
+        if (strncmp(name, "iso8859", 7) == 0 ||
+            strcmp(name, "ascii") == 0 ||
+            strcmp(name, "usascii") == 0) {
+            return 0x80;
+        }
+    } else if (dimension == 2) {
+        if (strcmp(name, "iso106461") == 0 || strcmp(name, "ucs2be") == 0) {
+            return 0x10000;
+        }
+    }
+
+    return 0;
+}
+
+/* Fills in a page of the renderer's metrics table */
+static XCharStruct *
+metrics_page_alloc(utf8_renderer_t self, unsigned char byte1)
+{
+    XCharStruct *page;
+    int i;
+
+    page = malloc(METRICS_PAGE_SIZE * sizeof(XCharStruct));
+    if (page == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < METRICS_PAGE_SIZE; i++) {
+        page[i] = *per_char(self->font, byte1, (unsigned char)i);
+    }
+
+    self->metrics[byte1] = page;
+    return page;
+}
+
+/* Answers the statistics to use for a given character, looking them
+ * up in the renderer's metrics table */
+static const XCharStruct *
+renderer_per_char(utf8_renderer_t self,
+                  unsigned char byte1,
+                  unsigned char byte2)
+{
+    XCharStruct *page = self->metrics[byte1];
+
+    /* Fill in the page if this is the first time we've needed it */
+    if (page == NULL) {
+        page = metrics_page_alloc(self, byte1);
+        if (page == NULL) {
+            return per_char(self->font, byte1, byte2);
+        }
+    }
+
+    return &page[byte2];
+}
+
 /* Returns an iconv conversion descriptor for converting characters to
  * be displayed in a given font from a given code set.  If tocode is
  * non-NULL then it will be used, otherwise an attempt will be made to
@@ -366,6 +520,18 @@ utf8_renderer_alloc(Display *display, XFontStruct *font, const char *tocode)
     self->cd = (iconv_t)-1;
     self->is_skipping = 0;
     self->dimension = 1;
+    self->fast_limit = 0;
+    self->shared = NULL;
+
+    /* Measure the characters of the first page now, since that's
+     * every character of an 8-bit font */
+    memset(self->metrics, 0, sizeof(self->metrics));
+    memset(self->bitmaps, 0, sizeof(self->bitmaps));
+    self->bitmap_gc = None;
+    if (metrics_page_alloc(self, 0) == NULL) {
+        free(self);
+        return NULL;
+    }
 
     /* Is there a font property for underline thickness? */
     if (!XGetFontProperty(font, XA_UNDERLINE_THICKNESS, &value)) {
@@ -404,6 +570,7 @@ utf8_renderer_alloc(Display *display, XFontStruct *font, const char *tocode)
 
         self->cd = cd;
         self->dimension = dimension;
+        self->fast_limit = fast_path_limit(tocode, dimension);
         return self;
     }
 
@@ -422,24 +589,175 @@ utf8_renderer_alloc(Display *display, XFontStruct *font, const char *tocode)
         return self;
     }
 
-    /* Clean up some more */
-    free(string);
-
     /* Try to encode a single character */
     dimension = cd_dimension(cd);
     if (dimension == 0) {
         iconv_close(cd);
+        free(string);
         return self;
     }
 
     /* Successful guess! */
     self->cd = cd;
     self->dimension = dimension;
+    self->fast_limit = fast_path_limit(string, dimension);
+
+    /* Clean up some more */
+    free(string);
 #endif /* HAVE_ICONV */
 
     return self;
 }
 
+/* Returns the number of ASCII characters at the start of a string,
+ * checking a word at a time where possible */
+static size_t
+ascii_run(const unsigned char *string, size_t length)
+{
+    const unsigned char *point = string;
+    const unsigned char *end = string + length;
+    unsigned long word;
+
+    /* Check the bytes up to the first aligned word */
+    while (point < end && ((unsigned long)point % sizeof(word)) != 0) {
+        if (*point & 0x80) {
+            return point - string;
+        }
+
+        point++;
+    }
+
+    /* Check whole words */
+    while ((size_t)(end - point) >= sizeof(word)) {
+        memcpy(&word, point, sizeof(word));
+        if (word & HIGH_BITS) {
+            break;
+        }
+
+        point += sizeof(word);
+    }
+
+    /* Find the first non-ASCII character in what's left */
+    while (point < end && (*point & 0x80) == 0) {
+        point++;
+    }
+
+    return point - string;
+}
+
+/* Returns the length of the run of non-ASCII characters at the start
+ * of a string, including any gaps of fewer than MIN_ASCII_RUN ASCII
+ * characters (such as the spaces between words) which would cost more
+ * to leave the run for than to hand to iconv() along with it */
+static size_t
+non_ascii_run(const unsigned char *string, size_t length)
+{
+    size_t i = 0, n;
+
+    while (i < length) {
+        /* Skip the non-ASCII characters */
+        while (i < length && (string[i] & 0x80) != 0) {
+            i++;
+        }
+
+        /* Stop before a long enough run of ASCII characters */
+        n = ascii_run(string + i, MIN(length - i, MIN_ASCII_RUN));
+        if (n == MIN_ASCII_RUN || i + n == length) {
+            return i;
+        }
+
+        i += n;
+    }
+
+    return i;
+}
+
+/* Transcodes the characters at the start of a UTF-8 string which are
+ * below the renderer's fast_limit without going through iconv().
+ * Stops at the first character it can't handle, or when it runs out
+ * of input or room, and returns the number of characters converted */
+static size_t
+fast_transcode(utf8_renderer_t self,
+               const char **inbuf,
+               size_t *inbytesleft,
+               char **outbuf,
+               size_t *outbytesleft)
+{
+    const unsigned char *in = (const unsigned char *)*inbuf;
+    unsigned char *out = (unsigned char *)*outbuf;
+    size_t in_left = *inbytesleft;
+    size_t out_left = *outbytesleft;
+    size_t count = 0;
+    unsigned long ch;
+    size_t i, n;
+
+    while (in_left != 0 && out_left >= (size_t)self->dimension) {
+        /* Copy a run of ASCII characters */
+        n = ascii_run(in, MIN(in_left, out_left / self->dimension));
+        if (self->dimension == 1) {
+            memcpy(out, in, n);
+            out += n;
+        } else {
+            for (i = 0; i < n; i++) {
+                *out++ = 0;
+                *out++ = in[i];
+            }
+        }
+
+        in += n;
+        in_left -= n;
+        out_left -= n * self->dimension;
+        count += n;
+
+        /* Stop if we're out of input or room */
+        if (in_left == 0 || out_left < (size_t)self->dimension) {
+            break;
+        }
+
+        /* Decode a two- or three-byte sequence */
+        ch = in[0];
+        if ((ch & 0xe0) == 0xc0 && in_left >= 2 &&
+            (in[1] & 0xc0) == 0x80) {
+            ch = ((ch & 0x1f) << 6) | (in[1] & 0x3f);
+            n = 2;
+        } else if ((ch & 0xf0) == 0xe0 && in_left >= 3 &&
+                   (in[1] & 0xc0) == 0x80 && (in[2] & 0xc0) == 0x80) {
+            ch = ((ch & 0x0f) << 12) | ((in[1] & 0x3f) << 6) |
+                (in[2] & 0x3f);
+            n = 3;
+        } else {
+            break;
+        }
+
+        /* Leave overlong sequences, surrogates and characters the code
+         * set can't represent to iconv() */
+        if (ch < 0x80 || (n == 3 && ch < 0x800) ||
+            (0xd800 <= ch && ch < 0xe000) || self->fast_limit <= ch) {
+            break;
+        }
+
+        /* Copy the character */
+        if (self->dimension == 1) {
+            *out++ = ch;
+        } else {
+            *out++ = ch >> 8;
+            *out++ = ch & 0xff;
+        }
+
+        in += n;
+        in_left -= n;
+        out_left -= self->dimension;
+        count++;
+    }
+
+    /* Export our progress */
+    *inbuf = (const char *)in;
+    *inbytesleft = in_left;
+    *outbuf = (char *)out;
+    *outbytesleft = out_left;
+    return count;
+}
+
 /* Wrapper around iconv() to catch most of the nasty gotchas */
 static size_t
 utf8_renderer_iconv(utf8_renderer_t self,
@@ -449,6 +767,7 @@ utf8_renderer_iconv(utf8_renderer_t self,
                     size_t *outbytesleft)
 {
     size_t count;
+    size_t length, left;
 
     /* An unsupported conversion becomse UTF-8 to ASCII */
     if (self->cd == (iconv_t)-1) {
@@ -506,8 +825,32 @@ utf8_renderer_iconv(utf8_renderer_t self,
             self->is_skipping = 0;
         }
 
-        /* Try to convert the sequence */
-        n = iconv(self->cd, (ICONV_CONST char**)inbuf, inbytesleft, outbuf, outbytesleft);
+        /* Convert what we can without iconv() */
+        if (self->fast_limit != 0) {
+            count += fast_transcode(self, inbuf, inbytesleft,
+                                    outbuf, outbytesleft);
+            if (*inbytesleft == 0 || *outbytesleft == 0) {
+                break;
+            }
+
+            /* Hand iconv() the run of non-ASCII characters so that
+             * we can return to the fast path afterwards */
+            length = non_ascii_run((const unsigned char *)*inbuf,
+                                   *inbytesleft);
+            left = length;
+            n = iconv(self->cd, (ICONV_CONST char**)inbuf, &left,
+                      outbuf, outbytesleft);
+            *inbytesleft -= length - left;
+
+            /* A sequence cut short by an ASCII byte is invalid */
+            if (n == (size_t)-1 && errno == EINVAL && left < *inbytesleft) {
+                errno = EILSEQ;
+            }
+        } else {
+            /* Try to convert the sequence */
+            n = iconv(self->cd, (ICONV_CONST char**)inbuf, inbytesleft,
+                      outbuf, outbytesleft);
+        }
         if (n == (size_t)-1) {
             switch (errno) {
             case E2BIG:
@@ -589,7 +932,7 @@ utf8_renderer_measure_string(utf8_renderer_t self,
             /* Set the initial measurements */
             if (is_first) {
                 is_first = False;
-                info = per_char(self->font, 0, *(unsigned char *)point);
+                info = renderer_per_char(self, 0, *(unsigned char *)point);
                 lbearing = info->lbearing;
                 rbearing = info->rbearing;
                 width = info->width;
@@ -598,7 +941,7 @@ utf8_renderer_measure_string(utf8_renderer_t self,
 
             /* Adjust for the rest of the string */
             while (point < out_point) {
-                info = per_char(self->font, 0, *(unsigned char *)point);
+                info = renderer_per_char(self, 0, *(unsigned char *)point);
                 lbearing = MIN(lbearing, width + (long)info->lbearing);
                 rbearing = MAX(rbearing, width + (long)info->rbearing);
                 width += (long)info->width;
@@ -610,7 +953,7 @@ utf8_renderer_measure_string(utf8_renderer_t self,
             /* Set the initial measurements */
             if (is_first) {
                 is_first = False;
-                info = per_char(self->font, point->byte1, point->byte2);
+                info = renderer_per_char(self, point->byte1, point->byte2);
                 lbearing = info->lbearing;
                 rbearing = info->rbearing;
                 width = info->width;
@@ -619,7 +962,7 @@ utf8_renderer_measure_string(utf8_renderer_t self,
 
             /* Adjust for the rest of the string */
             while (point < (XChar2b *)out_point) {
-                info = per_char(self->font, point->byte1, point->byte2);
+                info = renderer_per_char(self, point->byte1, point->byte2);
                 lbearing = MIN(lbearing, width + (long)info->lbearing);
                 rbearing = MAX(rbearing, width + (long)info->rbearing);
                 width += (long)info->width;
@@ -638,138 +981,551 @@ utf8_renderer_measure_string(utf8_renderer_t self,
             self->underline_position + self->underline_thickness);
 }
 
-/* Draw a string within the bounding box, measuring the characters so
- * as to minimize bandwidth requirements */
-void
-utf8_renderer_draw_string(Display *display,
-                          Drawable drawable,
-                          GC gc,
-                          utf8_renderer_t renderer,
-                          int x,
-                          int y,
-                          XRectangle *bbox,
-                          const char *string)
+/* Information about a string which has been transcoded into the code
+ * set of a utf8_renderer's font */
+struct utf8_text {
+    /* The renderer which transcoded the string */
+    utf8_renderer_t renderer;
+
+    /* The font in which the string will be displayed */
+    XFontStruct *font;
+
+    /* The number of bytes per character in the font's code set */
+    int dimension;
+
+    /* The number of characters in the string */
+    size_t count;
+
+    /* The characters in the font's code set */
+    char *chars;
+
+    /* The distance from the string's origin to each character's
+     * origin, followed by the width of the whole string */
+    long *offsets;
+
+    /* The measurements of the whole string */
+    struct string_sizes sizes;
+};
+
+/* Answers the statistics for the index'th character of a text */
+static const XCharStruct *
+text_per_char(utf8_text_t self, size_t index)
 {
-    char buffer[BUFFER_SIZE];
+    if (self->dimension == 1) {
+        return renderer_per_char(self->renderer, 0,
+                                 ((unsigned char *)self->chars)[index]);
+    } else {
+        XChar2b *ch = (XChar2b *)self->chars + index;
+        return renderer_per_char(self->renderer, ch->byte1, ch->byte2);
+    }
+}
+
+/* Transcodes a string into the font's code set once and for all,
+ * recording the offset of each character so that it can be drawn
+ * and measured without further conversion.  Returns NULL if memory
+ * could not be allocated. */
+utf8_text_t
+utf8_renderer_transcode(utf8_renderer_t self, const char *string)
+{
+    utf8_text_t text;
     const XCharStruct *info;
-    long left, right;
     char *out_point;
     size_t in_length;
     size_t out_length;
+    size_t size;
+    size_t i;
+    long lbearing = 0;
+    long rbearing = 0;
+    long width = 0;
 
     /* Count the number of bytes in the string */
     in_length = strlen(string);
 
-    /* Skip over characters outside the bounding box */
-    left = x;
-    while (in_length != 0) {
-        /* Convert the string into the font's code set */
-        out_length = BUFFER_SIZE;
-        out_point = buffer;
-        if (utf8_renderer_iconv(renderer, &string, &in_length,
+    /* Allocate memory for the text */
+    text = malloc(sizeof(struct utf8_text));
+    if (text == NULL) {
+        return NULL;
+    }
+
+    text->renderer = self;
+    text->font = self->font;
+    text->dimension = self->dimension;
+    text->offsets = NULL;
+
+    /* Every UTF-8 byte becomes at most one character in the font's
+     * code set, so this should almost always be enough room */
+    size = in_length * self->dimension + MAX_CHAR_SIZE;
+    text->chars = malloc(size);
+    if (text->chars == NULL) {
+        free(text);
+        return NULL;
+    }
+
+    /* Convert the string into the font's code set */
+    out_point = text->chars;
+    for (;;) {
+        char *chars;
+
+        out_length = size - (out_point - text->chars);
+        if (utf8_renderer_iconv(self, &string, &in_length,
                                 &out_point, &out_length) == (size_t)-1 &&
             errno != E2BIG) {
             /* This shouldn't fail */
             abort();
         }
 
-        /* Are characters in this code set one byte wide? */
-        if (renderer->dimension == 1) {
-            const char *first;
-            const char *last;
-
-            /* Look for visible characters in the buffer */
-            first = buffer;
-            while (first < out_point) {
-                info = per_char(renderer->font, 0,
-                                *(const unsigned char*)first);
-
-                /* Skip anything to the left of the bounding box */
-                if (left + info->rbearing < bbox->x) {
-                    left = left + (long)info->width;
-                    first++;
-                } else {
-                    /* Look for the last visible character */
-                    last = first;
-                    right = left;
-                    while (last < out_point) {
-                        info = per_char(renderer->font, 0,
-					*(const unsigned char*)last);
-
-                        if (right + info->lbearing < bbox->x + bbox->width) {
-                            right = right + (long)info->width;
-                            last++;
-                        } else {
-                            /* Reset the conversion descriptor */
-                            if (utf8_renderer_iconv(
-                                    renderer,
-                                    NULL, NULL,
-                                    NULL, NULL) == (size_t)-1) {
-                                abort();
-                            }
-
-                            XDrawString(display, drawable, gc, left, y,
-                                        first, last - first);
-                            return;
-                        }
-                    }
-
-                    /* Still visible at the end of the buffer */
-                    XDrawString(display, drawable, gc, left, y,
-                                first, last - first);
-                    first = last;
-                    left = right;
-                }
+        /* Stop when we're out of input */
+        if (in_length == 0) {
+            break;
+        }
+
+        /* Otherwise make more room */
+        chars = realloc(text->chars, size * 2);
+        if (chars == NULL) {
+            free(text->chars);
+            free(text);
+            return NULL;
+        }
+
+        out_point = chars + (out_point - text->chars);
+        text->chars = chars;
+        size *= 2;
+    }
+
+    /* Reset the conversion descriptor */
+    if (utf8_renderer_iconv(self, NULL, NULL, NULL, NULL) == (size_t)-1) {
+        abort();
+    }
+
+    /* Record the offset of each character */
+    text->count = (out_point - text->chars) / self->dimension;
+    text->offsets = malloc((text->count + 1) * sizeof(long));
+    if (text->offsets == NULL) {
+        free(text->chars);
+        free(text);
+        return NULL;
+    }
+
+    for (i = 0; i < text->count; i++) {
+        info = text_per_char(text, i);
+        if (i == 0) {
+            lbearing = info->lbearing;
+            rbearing = info->rbearing;
+        } else {
+            lbearing = MIN(lbearing, width + (long)info->lbearing);
+            rbearing = MAX(rbearing, width + (long)info->rbearing);
+        }
+
+        text->offsets[i] = width;
+        width += (long)info->width;
+    }
+
+    text->offsets[text->count] = width;
+
+    /* Record the measurements of the whole string */
+    text->sizes.lbearing = lbearing;
+    text->sizes.rbearing = rbearing;
+    text->sizes.width = width;
+    text->sizes.ascent = self->font->ascent;
+    text->sizes.descent =
+        MAX(self->font->descent,
+            self->underline_position + self->underline_thickness);
+    return text;
+}
+
+/* Returns the string transcoded into the font's code set, sharing the
+ * result with everyone else who asks for the same string */
+utf8_text_t
+utf8_renderer_transcode_shared(utf8_renderer_t self, const char *string)
+{
+    struct shared_text *entry;
+    unsigned long bucket;
+
+    /* Create the table on first use */
+    if (self->shared == NULL) {
+        self->shared = calloc(SHARED_TABLE_SIZE, sizeof(struct shared_text *));
+        if (self->shared == NULL) {
+            return NULL;
+        }
+    }
+
+    /* Look for the string in the table */
+    bucket = string_hash(string) % SHARED_TABLE_SIZE;
+    for (entry = self->shared[bucket]; entry != NULL; entry = entry->next) {
+        if (strcmp(entry->string, string) == 0) {
+            return entry->text;
+        }
+    }
+
+    /* Not there.  Transcode it and add it */
+    entry = malloc(sizeof(struct shared_text));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->string = strdup(string);
+    if (entry->string == NULL) {
+        free(entry);
+        return NULL;
+    }
+
+    entry->text = utf8_renderer_transcode(self, string);
+    if (entry->text == NULL) {
+        free(entry->string);
+        free(entry);
+        return NULL;
+    }
+
+    entry->next = self->shared[bucket];
+    self->shared[bucket] = entry;
+    return entry->text;
+}
+
+/* Releases the resources allocated by a utf8_text_t */
+void
+utf8_text_free(utf8_text_t self)
+{
+    free(self->offsets);
+    free(self->chars);
+    free(self);
+}
+
+/* Returns the measurements of a transcoded string */
+void
+utf8_text_get_sizes(utf8_text_t self, string_sizes_t sizes)
+{
+    *sizes = self->sizes;
+}
+
+/* Draw a transcoded string within the bounding box, skipping the
+ * characters outside of it so as to minimize bandwidth requirements */
+void
+utf8_text_draw(Display *display,
+               Drawable drawable,
+               GC gc,
+               utf8_text_t self,
+               int x,
+               int y,
+               XRectangle *bbox)
+{
+    long right = (long)bbox->x + (long)bbox->width;
+    long rbearing = self->font->max_bounds.rbearing;
+    size_t first, last;
+
+    /* No character extends further right than the font's maximum
+     * rbearing, and the offsets never decrease, so binary search for
+     * the first character which could possibly reach the bounding box */
+    first = 0;
+    last = self->count;
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+
+        if (x + self->offsets[middle] + rbearing < bbox->x) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    /* Then skip any others which still fall to the left of it */
+    while (first < self->count &&
+           x + self->offsets[first] +
+           text_per_char(self, first)->rbearing < bbox->x) {
+        first++;
+    }
+
+    /* Look for the last visible character */
+    last = first;
+    while (last < self->count &&
+           x + self->offsets[last] +
+           text_per_char(self, last)->lbearing < right) {
+        last++;
+    }
+
+    /* Bail if nothing is visible */
+    if (first == last) {
+        return;
+    }
+
+    /* Draw the visible characters */
+    if (self->dimension == 1) {
+        XDrawString(display, drawable, gc, x + self->offsets[first], y,
+                    self->chars + first, last - first);
+    } else {
+        XDrawString16(display, drawable, gc, x + self->offsets[first], y,
+                      (XChar2b *)self->chars + first, last - first);
+    }
+}
+
+/* Converts a character's 1-bit image into runs */
+static struct char_bitmap *
+char_bitmap_alloc(XImage *image)
+{
+    struct char_bitmap *self;
+    unsigned short *run;
+    size_t count = 0;
+    int row, column, start;
+
+    /* Count the runs */
+    for (row = 0; row < image->height; row++) {
+        for (column = 0; column < image->width; column++) {
+            if (XGetPixel(image, column, row) != 0 &&
+                (column == 0 || XGetPixel(image, column - 1, row) == 0)) {
+                count++;
+            }
+        }
+    }
+
+    /* Allocate the bitmap and its tables in one go */
+    self = malloc(sizeof(struct char_bitmap) +
+                  (image->height + 1 + count * 2) * sizeof(unsigned short));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->height = image->height;
+    self->rows = (unsigned short *)(self + 1);
+    self->runs = self->rows + image->height + 1;
+
+    /* And record them */
+    run = self->runs;
+    for (row = 0; row < image->height; row++) {
+        self->rows[row] = (run - self->runs) / 2;
+        column = 0;
+        while (column < image->width) {
+            if (XGetPixel(image, column, row) == 0) {
+                column++;
+                continue;
+            }
+
+            start = column;
+            while (column < image->width &&
+                   XGetPixel(image, column, row) != 0) {
+                column++;
             }
+
+            *run++ = start;
+            *run++ = column - start;
+        }
+    }
+
+    self->rows[image->height] = count;
+    return self;
+}
+
+/* Returns the bitmap of a character, drawing it on the server and
+ * fetching the result the first time it's needed.  The bitmap's
+ * origin is at the character's left bearing and ascent.  Returns
+ * NULL if the character has no pixels. */
+static struct char_bitmap *
+renderer_bitmap(utf8_renderer_t self,
+                Display *display,
+                Drawable drawable,
+                unsigned char byte1,
+                unsigned char byte2)
+{
+    const XCharStruct *info;
+    struct char_bitmap **page = self->bitmaps[byte1];
+    struct char_bitmap *bitmap;
+    XImage *image;
+    XGCValues values;
+    Pixmap pixmap;
+    XChar2b ch;
+    char byte;
+    int width, height;
+
+    /* Make room for the character's page */
+    if (page == NULL) {
+        page = calloc(METRICS_PAGE_SIZE, sizeof(struct char_bitmap *));
+        if (page == NULL) {
+            return NULL;
+        }
+
+        self->bitmaps[byte1] = page;
+    }
+
+    /* Have we already fetched it? */
+    if (page[byte2] != NULL) {
+        return page[byte2] == &empty_bitmap ? NULL : page[byte2];
+    }
+
+    /* Don't bother with characters which have no pixels */
+    info = renderer_per_char(self, byte1, byte2);
+    width = info->rbearing - info->lbearing;
+    height = info->ascent + info->descent;
+    if (width <= 0 || height <= 0) {
+        page[byte2] = &empty_bitmap;
+        return NULL;
+    }
+
+    /* Draw the character into a bitmap on the server */
+    pixmap = XCreatePixmap(display, drawable, width, height, 1);
+    if (self->bitmap_gc == None) {
+        values.font = self->font->fid;
+        self->bitmap_gc = XCreateGC(display, pixmap, GCFont, &values);
+    }
+
+    XSetForeground(display, self->bitmap_gc, 0);
+    XFillRectangle(display, pixmap, self->bitmap_gc, 0, 0, width, height);
+    XSetForeground(display, self->bitmap_gc, 1);
+    if (self->dimension == 1) {
+        byte = (char)byte2;
+        XDrawString(display, pixmap, self->bitmap_gc,
+                    -info->lbearing, info->ascent, &byte, 1);
+    } else {
+        ch.byte1 = byte1;
+        ch.byte2 = byte2;
+        XDrawString16(display, pixmap, self->bitmap_gc,
+                      -info->lbearing, info->ascent, &ch, 1);
+    }
+
+    /* Bring it back and keep it as runs */
+    image = XGetImage(display, pixmap, 0, 0, width, height, 1, XYPixmap);
+    XFreePixmap(display, pixmap);
+    if (image == NULL) {
+        page[byte2] = &empty_bitmap;
+        return NULL;
+    }
+
+    bitmap = char_bitmap_alloc(image);
+    XDestroyImage(image);
+    page[byte2] = bitmap != NULL ? bitmap : &empty_bitmap;
+    return bitmap;
+}
+
+/* Encodes a pixel value the way it's stored in the image.  The
+ * image's pixels must be a whole number of bytes. */
+static void
+image_pixel_bytes(XImage *image, unsigned long pixel, char *bytes)
+{
+    int count = image->bits_per_pixel / 8;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        bytes[image->byte_order == LSBFirst ? i : count - 1 - i] =
+            (char)(pixel >> (8 * i));
+    }
+}
+
+/* Sets count pixels of a row of the image, starting at x, to the
+ * encoded pixel value */
+static void
+image_fill_span(XImage *image, const char *bytes, int x, int y, int count)
+{
+    int size = image->bits_per_pixel / 8;
+    char *out = image->data + y * image->bytes_per_line + x * size;
+    int done;
+
+    /* Copy the first pixel and then keep doubling */
+    memcpy(out, bytes, size);
+    for (done = 1; done < count; done *= 2) {
+        memcpy(out + done * size, out, MIN(done, count - done) * size);
+    }
+}
+
+/* Draw a transcoded string into a client-side image within the
+ * bounding box.  The image's pixels must be a whole number of bytes.
+ * The drawable is only used to fetch the bitmaps of characters which
+ * haven't been rendered before. */
+void
+utf8_text_render(Display *display,
+                 Drawable drawable,
+                 XImage *image,
+                 utf8_text_t self,
+                 unsigned long pixel,
+                 int x,
+                 int y,
+                 XRectangle *bbox)
+{
+    int left = MAX(bbox->x, 0);
+    int right = MIN(bbox->x + (int)bbox->width, image->width);
+    int top = MAX(bbox->y, 0);
+    int bottom = MIN(bbox->y + (int)bbox->height, image->height);
+    const XCharStruct *info;
+    struct char_bitmap *bitmap;
+    unsigned short *run, *end;
+    unsigned char byte1, byte2;
+    char bytes[sizeof(unsigned long)];
+    int cx, cy, row, start, stop;
+    size_t i;
+
+    ASSERT(image->bits_per_pixel % 8 == 0);
+    image_pixel_bytes(image, pixel, bytes);
+
+    for (i = 0; i < self->count; i++) {
+        /* Work out where the character's bitmap goes */
+        info = text_per_char(self, i);
+        cx = x + self->offsets[i] + info->lbearing;
+        cy = y - info->ascent;
+
+        /* Skip characters outside the bounding box */
+        if (right <= cx || cx + info->rbearing - info->lbearing <= left) {
+            continue;
+        }
+
+        /* Look up its bitmap */
+        if (self->dimension == 1) {
+            byte1 = 0;
+            byte2 = ((unsigned char *)self->chars)[i];
         } else {
-            XChar2b *first;
-            XChar2b *last;
+            byte1 = ((XChar2b *)self->chars)[i].byte1;
+            byte2 = ((XChar2b *)self->chars)[i].byte2;
+        }
 
-            /* Look for visible characters in the buffer */
-            first = (XChar2b *)buffer;
-            while (first < (XChar2b *)out_point) {
-                info = per_char(renderer->font, first->byte1, first->byte2);
+        bitmap = renderer_bitmap(self->renderer, display, drawable,
+                                 byte1, byte2);
+        if (bitmap == NULL) {
+            continue;
+        }
 
-                if (left + info->rbearing < bbox->x) {
-                    left = left + (long)info->width;
-                    first++;
-                } else {
-                    /* Look for the last visible character */
-                    last = first;
-                    right = left;
-                    while (last < (XChar2b *)out_point) {
-                        info = per_char(renderer->font, last->byte1,
-                                        last->byte2);
-
-                        if (right + info->lbearing < bbox->x + bbox->width) {
-                            right = right + (long)info->width;
-                            last++;
-                        } else {
-                            /* Reset the conversion descriptor */
-                            if (utf8_renderer_iconv(
-                                    renderer,
-                                    NULL, NULL,
-                                    NULL, NULL) == (size_t)-1) {
-                                abort();
-                            }
-
-                            XDrawString16(display, drawable, gc, left, y,
-                                          first, last - first);
-                            return;
-                        }
-                    }
-
-                    /* Still visible at the end of the buffer */
-                    XDrawString16(display, drawable, gc, left, y,
-                                  first, last - first);
-                    first = last;
-                    left = right;
+        /* Copy its runs into the image, clipped to the bounding box */
+        for (row = MAX(0, top - cy);
+             row < bitmap->height && cy + row < bottom;
+             row++) {
+            run = bitmap->runs + bitmap->rows[row] * 2;
+            end = bitmap->runs + bitmap->rows[row + 1] * 2;
+            for (; run < end; run += 2) {
+                start = MAX(cx + run[0], left);
+                stop = MIN(cx + run[0] + run[1], right);
+                if (start < stop) {
+                    image_fill_span(image, bytes, start, cy + row,
+                                    stop - start);
                 }
             }
         }
     }
 }
 
+/* Underline a string within the bounding box of a client-side
+ * image */
+void
+utf8_renderer_render_underline(utf8_renderer_t self,
+                               XImage *image,
+                               unsigned long pixel,
+                               int x,
+                               int y,
+                               XRectangle *bbox,
+                               long width)
+{
+    long left = MAX(MAX(x, bbox->x), 0);
+    long right = MIN(MIN(x + width, (long)bbox->x + (long)bbox->width),
+                     image->width);
+    long top = MAX(y + self->underline_position, 0);
+    long bottom = MIN(y + self->underline_position +
+                      self->underline_thickness, image->height);
+    char bytes[sizeof(unsigned long)];
+    long row;
+
+    if (right <= left) {
+        return;
+    }
+
+    image_pixel_bytes(image, pixel, bytes);
+    for (row = top; row < bottom; row++) {
+        image_fill_span(image, bytes, left, row, right - left);
+    }
+}
+
 /* Underline a string within the bounding box, measuring the
  * characters so as to minimize bandwidth requirements */
 void
@@ -90,17 +90,69 @@ utf8_renderer_measure_string(utf8_renderer_t self,
                              string_sizes_t sizes);
 
 
-/* Draw a string within the bounding box, measuring the characters so
- * as to minimize bandwidth requirements */
+/* The utf8_text type */
+typedef struct utf8_text *utf8_text_t;
+
+/* Transcodes a string into the font's code set once and for all so
+ * that it can be drawn and measured without further conversion.
+ * Returns NULL if memory could not be allocated. */
+utf8_text_t
+utf8_renderer_transcode(utf8_renderer_t self, const char *string);
+
+
+/* Like utf8_renderer_transcode, but the result is remembered and
+ * shared by everyone who asks for the same string with this renderer.
+ * It belongs to the renderer and must not be freed.  Returns NULL if
+ * memory could not be allocated. */
+utf8_text_t
+utf8_renderer_transcode_shared(utf8_renderer_t self, const char *string);
+
+
+/* Releases the resources allocated by a utf8_text_t */
+void
+utf8_text_free(utf8_text_t self);
+
+
+/* Returns the measurements of a transcoded string */
+void
+utf8_text_get_sizes(utf8_text_t self, string_sizes_t sizes);
+
+
+/* Draw a transcoded string within the bounding box, skipping the
+ * characters outside of it so as to minimize bandwidth requirements */
+void
+utf8_text_draw(Display *display,
+               Drawable drawable,
+               GC gc,
+               utf8_text_t self,
+               int x,
+               int y,
+               XRectangle *bbox);
+
+
+/* Draw a transcoded string into a client-side image within the
+ * bounding box.  The drawable is only used to fetch the bitmaps of
+ * characters which haven't been rendered before. */
+void
+utf8_text_render(Display *display,
+                 Drawable drawable,
+                 XImage *image,
+                 utf8_text_t self,
+                 unsigned long pixel,
+                 int x,
+                 int y,
+                 XRectangle *bbox);
+
+
+/* Draw an underline under a string in a client-side image */
 void
-utf8_renderer_draw_string(Display *display,
-                          Drawable drawable,
-                          GC gc,
-                          utf8_renderer_t renderer,
-                          int x,
-                          int y,
-                          XRectangle *bbox,
-                          const char *string);
+utf8_renderer_render_underline(utf8_renderer_t self,
+                               XImage *image,
+                               unsigned long pixel,
+                               int x,
+                               int y,
+                               XRectangle *bbox,
+                               long width);
 
 
 /* Draw an underline under a string */
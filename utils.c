@@ -190,6 +190,22 @@ xbasename(const char *path)
     return (point == NULL) ? path : point + 1;
 }
 
+/* This is the 32-bit FNV-1a hash, which is cheap to compute and
+ * spreads short, similar strings (like Message-Ids) quite well. */
+unsigned long
+string_hash(const char *string)
+{
+    const unsigned char *point;
+    unsigned long hash = 2166136261UL;
+
+    for (point = (const unsigned char *)string; *point != '\0'; point++) {
+        hash ^= *point;
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+
+    return hash;
+}
+
 static int
 do_convert(Widget widget, XmConvertCallbackStruct *data,
            message_t message, message_part_t part,
@@ -112,4 +112,8 @@ veeprintf(elvin_error_t error, const char *format, va_list args);
 const char *
 xbasename(const char *path);
 
+/* Compute a hash value for a NUL-terminated string. */
+unsigned long
+string_hash(const char *string);
+
 #endif /* UTILS_H */
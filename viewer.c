@@ -0,0 +1,531 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   Each running viewer is a child process with a pipe connected to
+ *   its standard input.  The write end of the pipe is non-blocking
+ *   and is registered with XtAppAddInput so that the attachment is
+ *   written as quickly as the viewer reads it.  A SIGCHLD handler
+ *   writes a byte to a pipe of its own, which wakes the main loop so
+ *   that the viewers which have exited can be reaped outside of the
+ *   signal handler.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdio.h> /* perror, snprintf */
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h> /* exit, free, malloc */
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h> /* memcpy */
+#endif
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h> /* fork, waitpid */
+#endif
+#ifdef HAVE_SYS_WAIT_H
+# include <sys/wait.h> /* waitpid */
+#endif
+#ifndef WEXITSTATUS
+# define WEXITSTATUS(stat_val) ((unsigned int)(stat_val) >> 8)
+#endif
+#ifndef WIFEXITED
+# define WIFEXITED(stat_val) (((stat_val) & 0xFF) == 0)
+#endif
+#ifndef WIFSIGNALED
+# define WIFSIGNALED(stat_val) (((stat_val) & 0x7F) != 0x7F && \
+                                ((stat_val) & 0x7F) != 0)
+#endif
+#ifndef WTERMSIG
+# define WTERMSIG(stat_val) ((stat_val) & 0x7F)
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h> /* fcntl */
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h> /* close, dup2, execvp, fork, pipe, read, write */
+#endif
+#ifdef HAVE_SIGNAL_H
+# include <signal.h> /* sigaction, signal */
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h> /* errno */
+#endif
+#ifdef HAVE_ASSERT_H
+# include <assert.h> /* assert */
+#endif
+#include <X11/Intrinsic.h>
+#include "replace.h"
+#include "globals.h"
+#include "utils.h"
+#include "viewer.h"
+
+/* The size of the buffer used for status messages */
+#define BUFFER_SIZE 1024
+
+#define STARTED_MSG "Started %s (%d running)"
+#define TOO_MANY_MSG "Not starting %s: %d viewers already running"
+#define EXITED_MSG "%s exited with status %d"
+#define KILLED_MSG "%s was killed by signal %d"
+#define FINISHED_MSG "%s finished"
+
+/* The type of a running viewer process */
+typedef struct child *child_t;
+
+struct child {
+    /* The next child in the list */
+    child_t next;
+
+    /* The name of the program */
+    char *name;
+
+    /* The child's process id */
+    pid_t pid;
+
+    /* The write end of the child's stdin, or -1 once it is closed */
+    int fd;
+
+    /* The XtAppAddInput id for fd */
+    XtInputId input;
+
+    /* The data to be written to the child */
+    char *data;
+
+    /* The number of bytes of data */
+    size_t length;
+
+    /* The number of bytes of data already written */
+    size_t offset;
+};
+
+struct viewer {
+    /* The application context in which inputs are registered */
+    XtAppContext app_context;
+
+    /* The maximum number of viewers to run at once */
+    int max_viewers;
+
+    /* The number of viewers running */
+    int count;
+
+    /* The running viewers */
+    child_t children;
+
+    /* The XtAppAddInput id for the read end of the SIGCHLD pipe */
+    XtInputId sigchld_input;
+
+    /* The function to call with status reports */
+    viewer_status_callback_t callback;
+
+    /* The argument for the callback */
+    void *rock;
+};
+
+#if defined(HAVE_DUP2) && defined(HAVE_FORK)
+/* The pipe written by the SIGCHLD handler.  This has to be global
+ * since signal handlers can't be given any context. */
+static int sigchld_fds[2] = { -1, -1 };
+
+/* Signal handler which wakes up the main loop to reap children */
+static RETSIGTYPE
+sigchld_handler(int signum)
+{
+    int saved_errno = errno;
+    char ch = 0;
+
+    /* If the pipe is full then a wake-up is already pending anyway */
+    if (write(sigchld_fds[1], &ch, 1) < 0) {
+        /* There's nothing else we can safely do in here */
+    }
+
+    errno = saved_errno;
+}
+
+/* Formats a status message and passes it to the callback */
+static void
+report(viewer_t self, const char *format, const char *name, int value)
+{
+    char buffer[BUFFER_SIZE];
+
+    if (self->callback == NULL) {
+        return;
+    }
+
+    snprintf(buffer, BUFFER_SIZE, format, name, value);
+    self->callback(self->rock, buffer);
+}
+
+/* Marks a file descriptor as non-blocking and close-on-exec */
+static int
+set_flags(int fd, int is_nonblocking)
+{
+    int flags;
+
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        return -1;
+    }
+
+    if (!is_nonblocking) {
+        return 0;
+    }
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) {
+        return -1;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/* Stops writing to a child */
+static void
+child_close(child_t self)
+{
+    if (self->fd < 0) {
+        return;
+    }
+
+    XtRemoveInput(self->input);
+    close(self->fd);
+    self->fd = -1;
+
+    /* We won't be needing the data any more */
+    free(self->data);
+    self->data = NULL;
+}
+
+/* Frees a child */
+static void
+child_free(child_t self)
+{
+    child_close(self);
+    free(self->name);
+    free(self);
+}
+
+/* Writes as much of the data to the child as its pipe will take */
+static void
+write_cb(XtPointer rock, int *source, XtInputId *id)
+{
+    child_t self = (child_t)rock;
+    ssize_t length;
+
+    /* Write as much as we can */
+    length = write(self->fd, self->data + self->offset,
+                   self->length - self->offset);
+    if (length < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return;
+        }
+
+        /* Most likely the viewer exited without reading everything */
+        perror("unable to write to viewer pipe");
+        child_close(self);
+        return;
+    }
+
+    /* Close the pipe once everything has been written so that the
+     * viewer sees the end of its input */
+    self->offset += length;
+    if (self->offset == self->length) {
+        child_close(self);
+    }
+}
+
+/* Reaps any children which have exited */
+static void
+reap_cb(XtPointer rock, int *source, XtInputId *id)
+{
+    viewer_t self = (viewer_t)rock;
+    child_t *pointer;
+    char buffer[64];
+
+    /* Drain the SIGCHLD pipe */
+    while (read(sigchld_fds[0], buffer, sizeof(buffer)) > 0) {
+        /* Keep going */
+    }
+
+    /* Check on each of our children */
+    pointer = &self->children;
+    while (*pointer != NULL) {
+        child_t child = *pointer;
+        int status;
+        pid_t pid;
+
+        /* Skip children which are still running */
+        pid = waitpid(child->pid, &status, WNOHANG);
+        if (pid == 0 || (pid == (pid_t)-1 && errno == EINTR)) {
+            pointer = &child->next;
+            continue;
+        }
+
+        /* Report how it went */
+        if (pid == (pid_t)-1) {
+            perror("waitpid(): failed");
+        } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            report(self, EXITED_MSG, child->name, WEXITSTATUS(status));
+        } else if (WIFSIGNALED(status)) {
+            report(self, KILLED_MSG, child->name, WTERMSIG(status));
+        } else {
+            report(self, FINISHED_MSG, child->name, 0);
+        }
+
+        /* Forget about it */
+        *pointer = child->next;
+        child_free(child);
+        self->count--;
+    }
+
+#if !defined(HAVE_SIGACTION)
+    /* Put the signal handler back in place now that the children
+     * have been reaped */
+    signal(SIGCHLD, sigchld_handler);
+#endif /* !HAVE_SIGACTION */
+}
+
+#endif /* HAVE_DUP2 && HAVE_FORK */
+
+/* Allocates a viewer which will run at most max_viewers viewer
+ * processes at a time, reporting their status to callback */
+viewer_t
+viewer_alloc(XtAppContext app_context,
+             int max_viewers,
+             viewer_status_callback_t callback,
+             void *rock)
+{
+    viewer_t self;
+#if defined(HAVE_SIGACTION)
+    struct sigaction action;
+#endif /* HAVE_SIGACTION */
+
+    /* Allocate memory for the viewer */
+    self = malloc(sizeof(struct viewer));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->app_context = app_context;
+    self->max_viewers = max_viewers;
+    self->count = 0;
+    self->children = NULL;
+    self->sigchld_input = 0;
+    self->callback = callback;
+    self->rock = rock;
+
+#if defined(HAVE_DUP2) && defined(HAVE_FORK)
+    /* Create the pipe used to wake up the main loop */
+    if (sigchld_fds[0] < 0) {
+        if (pipe(sigchld_fds) < 0) {
+            perror("pipe(): failed");
+            free(self);
+            return NULL;
+        }
+
+        if (set_flags(sigchld_fds[0], True) < 0 ||
+            set_flags(sigchld_fds[1], True) < 0) {
+            perror("fcntl(): failed");
+            free(self);
+            return NULL;
+        }
+    }
+
+    self->sigchld_input = XtAppAddInput(
+        app_context, sigchld_fds[0], (XtPointer)XtInputReadMask,
+        reap_cb, self);
+
+    /* Don't let a viewer which exits early kill us */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Find out when viewers exit */
+# if defined(HAVE_SIGACTION)
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigchld_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    if (sigaction(SIGCHLD, &action, NULL) < 0) {
+        perror("sigaction(): failed");
+    }
+# else /* !HAVE_SIGACTION */
+    signal(SIGCHLD, sigchld_handler);
+# endif /* HAVE_SIGACTION */
+#endif /* HAVE_DUP2 && HAVE_FORK */
+
+    return self;
+}
+
+/* Releases the resources consumed by the viewer.  Viewer processes
+ * which are still running are left to finish on their own. */
+void
+viewer_free(viewer_t self)
+{
+#if defined(HAVE_DUP2) && defined(HAVE_FORK)
+    child_t child;
+
+    /* Stop listening for SIGCHLD */
+    signal(SIGCHLD, SIG_DFL);
+    if (self->sigchld_input != 0) {
+        XtRemoveInput(self->sigchld_input);
+    }
+
+    /* Forget about the children */
+    while (self->children != NULL) {
+        child = self->children;
+        self->children = child->next;
+        child_free(child);
+    }
+#endif /* HAVE_DUP2 && HAVE_FORK */
+
+    free(self);
+}
+
+/* Runs the program named by argv[0] with the given arguments, feeding
+ * it the data on its standard input.  Returns 0 if the program was
+ * started, -1 otherwise. */
+int
+viewer_run(viewer_t self,
+           char *const argv[],
+           const char *data,
+           size_t length)
+{
+#if defined(HAVE_DUP2) && defined(HAVE_FORK)
+    child_t child;
+    int fds[2];
+
+    /* Don't start too many viewers at once */
+    if (self->max_viewers > 0 && self->count >= self->max_viewers) {
+        report(self, TOO_MANY_MSG, argv[0], self->count);
+        return -1;
+    }
+
+    /* Allocate a record of the child, with a copy of the data since
+     * it will be written in the background */
+    child = malloc(sizeof(struct child));
+    if (child == NULL) {
+        perror("malloc(): failed");
+        return -1;
+    }
+
+    child->name = strdup(argv[0]);
+    child->data = malloc(length);
+    if (child->name == NULL || child->data == NULL) {
+        perror("malloc(): failed");
+        free(child->name);
+        free(child->data);
+        free(child);
+        return -1;
+    }
+
+    memcpy(child->data, data, length);
+    child->length = length;
+    child->offset = 0;
+
+    /* Create a pipe to send the data to the viewer */
+    if (pipe(fds) < 0) {
+        perror("pipe(): failed");
+        free(child->name);
+        free(child->data);
+        free(child);
+        return -1;
+    }
+
+    /* Fork a child process to invoke the viewer */
+    child->pid = fork();
+    if (child->pid == (pid_t)-1) {
+        perror("fork(): failed");
+        close(fds[0]);
+        close(fds[1]);
+        free(child->name);
+        free(child->data);
+        free(child);
+        return -1;
+    }
+
+    /* See if we're the child process */
+    if (child->pid == 0) {
+        /* Use the pipe as stdin */
+        dup2(fds[0], STDIN_FILENO);
+
+        /* Close off the ends of the pipe */
+        close(fds[0]);
+        close(fds[1]);
+
+        /* The viewer shouldn't inherit our indifference to SIGPIPE */
+        signal(SIGPIPE, SIG_DFL);
+
+        /* Invoke the viewer */
+        execvp(argv[0], argv);
+
+        /* We'll only get here if exec fails */
+        perror("execvp(): failed");
+        _exit(1);
+    }
+
+    /* We're the parent process. */
+    if (close(fds[0]) < 0) {
+        perror("close(): failed");
+    }
+
+    /* Write the data as the viewer is ready for it.  Keep the pipe
+     * out of any other viewers we start so that this one sees the end
+     * of its input when we close it. */
+    child->fd = fds[1];
+    if (set_flags(child->fd, True) < 0) {
+        perror("fcntl(): failed");
+    }
+
+    child->input = XtAppAddInput(self->app_context, child->fd,
+                                 (XtPointer)XtInputWriteMask,
+                                 write_cb, child);
+
+    /* Remember it so that it can be reaped */
+    child->next = self->children;
+    self->children = child;
+    self->count++;
+
+    report(self, STARTED_MSG, child->name, self->count);
+    return 0;
+#else /* !(HAVE_DUP2 && HAVE_FORK) */
+    return -1;
+#endif /* HAVE_DUP2 && HAVE_FORK */
+}
+
+/**********************************************************************/
@@ -0,0 +1,85 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1997-2009 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * Description:
+ *   Launches viewers for message attachments without blocking the
+ *   main loop.  The attachment is fed to each viewer through a
+ *   non-blocking pipe as the viewer is ready to read it, and viewers
+ *   are reaped when a SIGCHLD arrives.
+ */
+
+#ifndef VIEWER_H
+#define VIEWER_H
+
+#include <X11/Intrinsic.h>
+
+/* The viewer data type */
+typedef struct viewer *viewer_t;
+
+/* The type of function called to report the progress of viewers */
+typedef void (*viewer_status_callback_t)(void *rock, const char *status);
+
+
+/* Allocates a viewer which will run at most max_viewers viewer
+ * processes at a time, reporting their status to callback */
+viewer_t
+viewer_alloc(XtAppContext app_context,
+             int max_viewers,
+             viewer_status_callback_t callback,
+             void *rock);
+
+
+/* Releases the resources consumed by the viewer.  Viewer processes
+ * which are still running are left to finish on their own. */
+void
+viewer_free(viewer_t self);
+
+
+/* Runs the program named by argv[0] with the given arguments, feeding
+ * it the data on its standard input.  Returns 0 if the program was
+ * started, -1 otherwise. */
+int
+viewer_run(viewer_t self,
+           char *const argv[],
+           const char *data,
+           size_t length);
+
+#endif /* VIEWER_H */